@@ -0,0 +1,162 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+/*
+  Finds the k IDs closest by XOR distance to a target, as an alternative to sorting with
+  NodeId::CloserToTarget (which XORs both of its operands with the target on every comparison).
+
+  The first 64 bits of each element's distance from the target are computed once, up front, into a
+  compact key holding that prefix and the element's index.  The k closest keys are then selected
+  with std::nth_element and sorted, falling back to comparing the full IDs only for keys with equal
+  prefixes.  Large inputs can optionally be split across threads, each selecting the k closest in
+  its part before the candidates are merged.
+*/
+
+#ifndef MAIDSAFE_COMMON_CLOSEST_NODES_H_
+#define MAIDSAFE_COMMON_CLOSEST_NODES_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <future>
+#include <iterator>
+#include <vector>
+
+#include "maidsafe/common/error.h"
+#include "maidsafe/common/log.h"
+#include "maidsafe/common/node_id.h"
+
+namespace maidsafe {
+
+// Inputs are only split across threads if each thread would have at least this many IDs.
+const size_t kMinClosestNodesPerThread = 16384;
+
+// Returns the indices of the (at most) 'k' elements of [first, last) whose IDs are closest to
+// 'target', closest first.  'get_id' is called with an element and returns its NodeId (by const
+// reference or value).  If 'thread_count' is greater than 1, large inputs are split across up to
+// that many threads.  Will throw if IsValid() is false for 'target' or any of the IDs.
+template <typename RandomAccessIterator, typename GetId>
+std::vector<size_t> ClosestNodes(RandomAccessIterator first, RandomAccessIterator last,
+                                 const NodeId& target, size_t k, GetId get_id,
+                                 unsigned thread_count = 1);
+
+// Returns the (at most) 'k' IDs in 'ids' closest to 'target', closest first.
+inline std::vector<NodeId> ClosestNodes(const std::vector<NodeId>& ids, const NodeId& target,
+                                        size_t k, unsigned thread_count = 1);
+
+// ==================== Implementation =============================================================
+namespace detail {
+
+struct DistanceKey {
+  // First 64 bits of the XOR distance to the target, so that smaller is closer.
+  uint64_t prefix;
+  size_t index;
+};
+
+inline uint64_t DistancePrefix(const NodeId& id, const NodeId& target) {
+#ifndef USE_DEPRECATED_NODE_ID_BEHAVIOUR
+  if (!id.IsValid())
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::invalid_node_id));
+#endif
+  return ReadBigEndianWord(id.bytes().data()) ^ ReadBigEndianWord(target.bytes().data());
+}
+
+// Moves the (at most) 'k' closest keys in [first, last) to the front in order, closest first.
+template <typename Less>
+void SelectClosest(std::vector<DistanceKey>::iterator first,
+                   std::vector<DistanceKey>::iterator last, size_t k, Less less) {
+  if (static_cast<size_t>(std::distance(first, last)) > k) {
+    std::nth_element(first, first + k, last, less);
+    last = first + k;
+  }
+  std::sort(first, last, less);
+}
+
+}  // namespace detail
+
+template <typename RandomAccessIterator, typename GetId>
+std::vector<size_t> ClosestNodes(RandomAccessIterator first, RandomAccessIterator last,
+                                 const NodeId& target, size_t k, GetId get_id,
+                                 unsigned thread_count) {
+#ifndef USE_DEPRECATED_NODE_ID_BEHAVIOUR
+  if (!target.IsValid())
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::invalid_node_id));
+#endif
+  const size_t count(static_cast<size_t>(std::distance(first, last)));
+  std::vector<detail::DistanceKey> keys(count);
+  auto less([&](const detail::DistanceKey& lhs, const detail::DistanceKey& rhs) {
+    if (lhs.prefix != rhs.prefix)
+      return lhs.prefix < rhs.prefix;
+    return lhs.index != rhs.index &&
+           NodeId::CloserToTarget(get_id(first[lhs.index]), get_id(first[rhs.index]), target);
+  });
+  // Fills and selects from keys[begin, end).
+  auto select_range([&](size_t begin, size_t end) {
+    for (size_t i(begin); i != end; ++i)
+      keys[i] = detail::DistanceKey{detail::DistancePrefix(get_id(first[i]), target), i};
+    detail::SelectClosest(keys.begin() + begin, keys.begin() + end, k, less);
+  });
+
+  size_t part_count(1);
+  if (thread_count > 1 && k < kMinClosestNodesPerThread)
+    part_count = std::min(static_cast<size_t>(thread_count), count / kMinClosestNodesPerThread);
+  if (part_count <= 1) {
+    select_range(0, count);
+    keys.resize(std::min(k, count));
+  } else {
+    std::vector<std::future<void>> parts;
+    for (size_t part(1); part != part_count; ++part) {
+      parts.push_back(std::async(std::launch::async, select_range, count * part / part_count,
+                                 count * (part + 1) / part_count));
+    }
+    select_range(0, count / part_count);
+    for (auto& part : parts)
+      part.get();
+    // Gather each part's closest keys at the front, and select from these.
+    size_t candidate_count(0);
+    for (size_t part(0); part != part_count; ++part) {
+      auto part_begin(keys.begin() + count * part / part_count);
+      auto part_size(std::min(k, count * (part + 1) / part_count - count * part / part_count));
+      candidate_count = static_cast<size_t>(
+          std::copy(part_begin, part_begin + part_size, keys.begin() + candidate_count) -
+          keys.begin());
+    }
+    detail::SelectClosest(keys.begin(), keys.begin() + candidate_count, k, less);
+    keys.resize(std::min(k, candidate_count));
+  }
+
+  std::vector<size_t> indices;
+  indices.reserve(keys.size());
+  for (const auto& key : keys)
+    indices.push_back(key.index);
+  return indices;
+}
+
+inline std::vector<NodeId> ClosestNodes(const std::vector<NodeId>& ids, const NodeId& target,
+                                        size_t k, unsigned thread_count) {
+  auto indices(ClosestNodes(ids.begin(), ids.end(), target, k,
+                            [](const NodeId& id) -> const NodeId& { return id; }, thread_count));
+  std::vector<NodeId> closest;
+  closest.reserve(indices.size());
+  for (auto index : indices)
+    closest.push_back(ids[index]);
+  return closest;
+}
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_COMMON_CLOSEST_NODES_H_
@@ -0,0 +1,397 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+/*
+  A thread-safe counterpart to LruCache with the same Check / Get / Add / Delete interface and the
+  same capacity and time to live semantics.
+
+  Keys are partitioned by hash across a number of shards, each with its own reader-writer lock,
+  hash table and recency list, so that calls for keys in different shards never contend.  The
+  capacity is split evenly across the shards.
+
+  Check and Get only take their shard's lock in shared mode.  Rather than moving an entry to the
+  back of the recency list (which would need exclusive access), a hit just sets the entry's
+  'accessed' flag.  The flags are applied lazily when an entry needs to be evicted: the oldest
+  entry is examined and, if it has been accessed since it was last examined, its flag is cleared
+  and it is moved to the back of the list instead of being evicted (i.e. "second chance" or CLOCK
+  replacement).  This gives a close approximation to LRU order while letting hits proceed in
+  parallel.
+
+  With a time to live, each shard also keeps its entries in the order they were added, which is
+  the order they expire.  Check and Get treat an expired entry as missing, and Add and Delete
+  remove any expired entries from the front of that list.
+
+  GetOrCompute coalesces concurrent misses on the same key: the first caller runs the loader while
+  any others arriving before it finishes wait on a shared future for its result.  If the loader
+  throws, the exception is propagated to every waiting caller and nothing is cached.  A Delete of
+  the key while its load is in progress detaches that load: its callers still receive its result,
+  but the result isn't cached, and later calls start a fresh load.
+
+  All public functions are thread-safe.
+*/
+
+#ifndef MAIDSAFE_COMMON_CONTAINERS_CONCURRENT_LRU_CACHE_H_
+#define MAIDSAFE_COMMON_CONTAINERS_CONCURRENT_LRU_CACHE_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <limits>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "boost/expected/expected.hpp"
+#include "boost/thread/locks.hpp"
+#include "boost/thread/shared_mutex.hpp"
+
+#include "maidsafe/common/error.h"
+#include "maidsafe/common/log.h"
+#include "maidsafe/common/types.h"
+
+namespace maidsafe {
+
+template <typename KeyType, typename ValueType, typename Hash = std::hash<KeyType>>
+class ConcurrentLruCache {
+ public:
+  static const uint32_t kDefaultShardCount = 16;
+
+  // The shard count is reduced to 'capacity' if that is smaller.  Throws if capacity or shard_count
+  // is 0.
+  explicit ConcurrentLruCache(size_t capacity, uint32_t shard_count = kDefaultShardCount);
+  explicit ConcurrentLruCache(std::chrono::steady_clock::duration time_to_live,
+                              uint32_t shard_count = kDefaultShardCount);
+  ConcurrentLruCache(size_t capacity, std::chrono::steady_clock::duration time_to_live,
+                     uint32_t shard_count = kDefaultShardCount);
+  ~ConcurrentLruCache() = default;
+  ConcurrentLruCache(const ConcurrentLruCache&) = delete;
+  ConcurrentLruCache(ConcurrentLruCache&&) = delete;
+  ConcurrentLruCache& operator=(const ConcurrentLruCache&) = delete;
+  ConcurrentLruCache& operator=(ConcurrentLruCache&&) = delete;
+
+  bool Check(const KeyType& key) const;
+  boost::expected<ValueType, maidsafe_error> Get(const KeyType& key) const;
+  // As for LruCache, this is a no-op if 'key' is already held.
+  void Add(KeyType key, ValueType value);
+  // Returns the value for 'key', calling 'loader' (with signature ValueType()) to produce and cache
+  // it on a miss.  If a load of 'key' is already in progress, waits for that instead.  Exceptions
+  // thrown by 'loader' are rethrown to all callers waiting on it.  The value isn't cached if 'key'
+  // is deleted while 'loader' is running.  'loader' must not itself call GetOrCompute for the same
+  // key.
+  template <typename Loader>
+  ValueType GetOrCompute(const KeyType& key, Loader loader);
+  void Delete(const KeyType& key);
+
+  // Sum of the shards' sizes.  Only exact if no other thread is modifying the cache.
+  size_t size() const;
+  size_t shard_count() const { return shards_.size(); }
+
+ private:
+  struct Entry;
+  typedef std::pair<const KeyType, Entry> Element;
+  typedef std::list<Element*> RecencyList;
+
+  struct Entry {
+    Entry(ValueType value_in, std::chrono::steady_clock::time_point added_in)
+        : position(), expiry_position(), added(added_in), accessed(false),
+          value(std::move(value_in)) {}
+    // Position in the shard's 'order' and (if there is a time to live) 'expiry_order'.
+    typename RecencyList::iterator position, expiry_position;
+    std::chrono::steady_clock::time_point added;
+    // Set by readers holding a shared lock; cleared by writers holding the exclusive lock.
+    mutable std::atomic<bool> accessed;
+    ValueType value;
+  };
+
+  // A GetOrCompute load in progress.  Delete sets 'invalidated' (and removes the load from its
+  // shard) so that the loading thread doesn't cache a value which may predate the Delete.
+  struct Load {
+    explicit Load(std::shared_future<ValueType> result_in)
+        : result(std::move(result_in)), invalidated(false) {}
+    std::shared_future<ValueType> result;
+    bool invalidated;
+  };
+
+  struct Shard {
+    explicit Shard(size_t capacity_in)
+        : capacity(capacity_in), mutex(), entries(), order(), expiry_order(), loads() {}
+    const size_t capacity;
+    mutable boost::shared_mutex mutex;
+    std::unordered_map<KeyType, Entry, Hash> entries;
+    // Front is the next candidate for eviction.
+    RecencyList order;
+    // In the order added, so front is the next to expire.  Empty if there is no time to live.
+    RecencyList expiry_order;
+    // GetOrCompute loads in progress.  A Load's 'invalidated' flag is guarded by 'mutex'.
+    std::unordered_map<KeyType, std::shared_ptr<Load>, Hash> loads;
+  };
+
+  static uint32_t CheckShardCount(uint32_t shard_count, size_t capacity);
+  Shard& ShardFor(const KeyType& key) const;
+  std::chrono::steady_clock::time_point Now() const;
+  bool IsExpired(const Entry& entry, std::chrono::steady_clock::time_point now) const;
+  // All the following must be called with the shard's mutex locked exclusively.
+  void Insert(Shard& shard, KeyType key, ValueType value,
+              std::chrono::steady_clock::time_point now);
+  void EvictOne(Shard& shard);
+  void RemoveExpired(Shard& shard, std::chrono::steady_clock::time_point now);
+  void RemoveElement(Shard& shard, Element* element);
+
+  const std::chrono::steady_clock::duration time_to_live_;
+  std::vector<std::unique_ptr<Shard>> shards_;
+};
+
+// ==================== Implementation =============================================================
+template <typename KeyType, typename ValueType, typename Hash>
+const uint32_t ConcurrentLruCache<KeyType, ValueType, Hash>::kDefaultShardCount;
+
+template <typename KeyType, typename ValueType, typename Hash>
+ConcurrentLruCache<KeyType, ValueType, Hash>::ConcurrentLruCache(size_t capacity,
+                                                                 uint32_t shard_count)
+    : ConcurrentLruCache(capacity, std::chrono::steady_clock::duration::zero(), shard_count) {}
+
+template <typename KeyType, typename ValueType, typename Hash>
+ConcurrentLruCache<KeyType, ValueType, Hash>::ConcurrentLruCache(
+    std::chrono::steady_clock::duration time_to_live, uint32_t shard_count)
+    : ConcurrentLruCache(std::numeric_limits<size_t>::max(), time_to_live, shard_count) {}
+
+template <typename KeyType, typename ValueType, typename Hash>
+ConcurrentLruCache<KeyType, ValueType, Hash>::ConcurrentLruCache(
+    size_t capacity, std::chrono::steady_clock::duration time_to_live, uint32_t shard_count)
+    : time_to_live_(time_to_live), shards_() {
+  if (capacity == 0) {
+    LOG(kError) << "Cannot construct a ConcurrentLruCache with capacity 0";
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::cannot_exceed_limit));
+  }
+  shard_count = CheckShardCount(shard_count, capacity);
+  shards_.reserve(shard_count);
+  for (uint32_t i(0); i != shard_count; ++i) {
+    // Any remainder goes to the lowest-indexed shards.
+    shards_.emplace_back(
+        new Shard(capacity / shard_count + (i < capacity % shard_count ? 1 : 0)));
+  }
+}
+
+template <typename KeyType, typename ValueType, typename Hash>
+bool ConcurrentLruCache<KeyType, ValueType, Hash>::Check(const KeyType& key) const {
+  Shard& shard(ShardFor(key));
+  boost::shared_lock<boost::shared_mutex> lock(shard.mutex);
+  auto itr(shard.entries.find(key));
+  return itr != shard.entries.end() && !IsExpired(itr->second, Now());
+}
+
+template <typename KeyType, typename ValueType, typename Hash>
+boost::expected<ValueType, maidsafe_error> ConcurrentLruCache<KeyType, ValueType, Hash>::Get(
+    const KeyType& key) const {
+  Shard& shard(ShardFor(key));
+  boost::shared_lock<boost::shared_mutex> lock(shard.mutex);
+  auto itr(shard.entries.find(key));
+  // An expired entry can't be removed with only a shared lock; it will be removed by the next Add
+  // or Delete in this shard.
+  if (itr == shard.entries.end() || IsExpired(itr->second, Now()))
+    return boost::make_unexpected(MakeError(CommonErrors::no_such_element));
+
+  // Record the access; it is applied to the recency list when this entry is next considered for
+  // eviction.  Avoid the store if already set to save invalidating other cores' cache lines.
+  if (!itr->second.accessed.load(std::memory_order_relaxed))
+    itr->second.accessed.store(true, std::memory_order_relaxed);
+  return itr->second.value;
+}
+
+template <typename KeyType, typename ValueType, typename Hash>
+void ConcurrentLruCache<KeyType, ValueType, Hash>::Add(KeyType key, ValueType value) {
+  Shard& shard(ShardFor(key));
+  auto now(Now());
+  std::lock_guard<boost::shared_mutex> lock(shard.mutex);
+  Insert(shard, std::move(key), std::move(value), now);
+}
+
+template <typename KeyType, typename ValueType, typename Hash>
+template <typename Loader>
+ValueType ConcurrentLruCache<KeyType, ValueType, Hash>::GetOrCompute(const KeyType& key,
+                                                                     Loader loader) {
+  auto cached(Get(key));
+  if (cached.valid())
+    return std::move(cached.value());
+
+  Shard& shard(ShardFor(key));
+  std::promise<ValueType> promise;
+  std::shared_ptr<Load> load;
+  {
+    std::unique_lock<boost::shared_mutex> lock(shard.mutex);
+    // Check again, since the value may have been added or a load started since the Get above.
+    auto itr(shard.entries.find(key));
+    if (itr != shard.entries.end() && !IsExpired(itr->second, Now())) {
+      itr->second.accessed.store(true, std::memory_order_relaxed);
+      return itr->second.value;
+    }
+    auto load_itr(shard.loads.find(key));
+    if (load_itr != shard.loads.end()) {
+      auto result(load_itr->second->result);
+      lock.unlock();
+      return result.get();
+    }
+    load = std::make_shared<Load>(promise.get_future().share());
+    shard.loads.emplace(key, load);
+  }
+
+  try {
+    ValueType value(loader());
+    {
+      auto now(Now());
+      std::lock_guard<boost::shared_mutex> lock(shard.mutex);
+      // If invalidated, a Delete has already removed this load from 'loads', and any load there now
+      // was started after the Delete.
+      if (!load->invalidated) {
+        shard.loads.erase(key);
+        Insert(shard, key, value, now);
+      }
+    }
+    promise.set_value(value);
+    return value;
+  } catch (...) {
+    // Don't cache the failure; the next call for this key will run its own loader.
+    {
+      std::lock_guard<boost::shared_mutex> lock(shard.mutex);
+      if (!load->invalidated)
+        shard.loads.erase(key);
+    }
+    promise.set_exception(std::current_exception());
+    throw;
+  }
+}
+
+template <typename KeyType, typename ValueType, typename Hash>
+void ConcurrentLruCache<KeyType, ValueType, Hash>::Delete(const KeyType& key) {
+  Shard& shard(ShardFor(key));
+  auto now(Now());
+  std::lock_guard<boost::shared_mutex> lock(shard.mutex);
+  RemoveExpired(shard, now);
+  auto itr(shard.entries.find(key));
+  if (itr != shard.entries.end())
+    RemoveElement(shard, &*itr);
+  auto load_itr(shard.loads.find(key));
+  if (load_itr != shard.loads.end()) {
+    load_itr->second->invalidated = true;
+    shard.loads.erase(load_itr);
+  }
+}
+
+template <typename KeyType, typename ValueType, typename Hash>
+size_t ConcurrentLruCache<KeyType, ValueType, Hash>::size() const {
+  size_t total(0);
+  for (const auto& shard : shards_) {
+    boost::shared_lock<boost::shared_mutex> lock(shard->mutex);
+    total += shard->entries.size();
+  }
+  return total;
+}
+
+template <typename KeyType, typename ValueType, typename Hash>
+uint32_t ConcurrentLruCache<KeyType, ValueType, Hash>::CheckShardCount(uint32_t shard_count,
+                                                                       size_t capacity) {
+  if (shard_count == 0) {
+    LOG(kError) << "ConcurrentLruCache needs at least one shard.";
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::invalid_parameter));
+  }
+  if (capacity < shard_count)
+    return static_cast<uint32_t>(capacity);
+  return shard_count;
+}
+
+template <typename KeyType, typename ValueType, typename Hash>
+typename ConcurrentLruCache<KeyType, ValueType, Hash>::Shard&
+    ConcurrentLruCache<KeyType, ValueType, Hash>::ShardFor(const KeyType& key) const {
+  // The shards' own hash tables use the low bits of the same hash, so pick the shard using a
+  // multiplicative mix of it to keep the two choices independent.
+  uint64_t mixed(static_cast<uint64_t>(Hash()(key)) * 0x9E3779B97F4A7C15ULL);
+  return *shards_[static_cast<size_t>(mixed >> 32) % shards_.size()];
+}
+
+template <typename KeyType, typename ValueType, typename Hash>
+std::chrono::steady_clock::time_point ConcurrentLruCache<KeyType, ValueType, Hash>::Now() const {
+  return time_to_live_ == std::chrono::steady_clock::duration::zero()
+             ? std::chrono::steady_clock::time_point()
+             : std::chrono::steady_clock::now();
+}
+
+template <typename KeyType, typename ValueType, typename Hash>
+bool ConcurrentLruCache<KeyType, ValueType, Hash>::IsExpired(
+    const Entry& entry, std::chrono::steady_clock::time_point now) const {
+  return time_to_live_ != std::chrono::steady_clock::duration::zero() &&
+         (entry.added + time_to_live_) < now;
+}
+
+template <typename KeyType, typename ValueType, typename Hash>
+void ConcurrentLruCache<KeyType, ValueType, Hash>::Insert(
+    Shard& shard, KeyType key, ValueType value, std::chrono::steady_clock::time_point now) {
+  // Check if we have entries with time expired
+  RemoveExpired(shard, now);
+  if (shard.entries.count(key) != 0)
+    return;
+  // Check if we should evict any entries because of size
+  if (shard.entries.size() == shard.capacity)
+    EvictOne(shard);
+
+  auto result(shard.entries.emplace(std::piecewise_construct, std::forward_as_tuple(std::move(key)),
+                                    std::forward_as_tuple(std::move(value), now)));
+  Element* element(&*result.first);
+  element->second.position = shard.order.insert(shard.order.end(), element);
+  if (time_to_live_ != std::chrono::steady_clock::duration::zero()) {
+    element->second.expiry_position =
+        shard.expiry_order.insert(shard.expiry_order.end(), element);
+  }
+}
+
+template <typename KeyType, typename ValueType, typename Hash>
+void ConcurrentLruCache<KeyType, ValueType, Hash>::EvictOne(Shard& shard) {
+  // Terminates within one pass of the list, since each entry passed over has its flag cleared.
+  for (;;) {
+    Element* oldest(shard.order.front());
+    if (!oldest->second.accessed.exchange(false, std::memory_order_relaxed))
+      return RemoveElement(shard, oldest);
+    shard.order.splice(shard.order.end(), shard.order, shard.order.begin());
+  }
+}
+
+template <typename KeyType, typename ValueType, typename Hash>
+void ConcurrentLruCache<KeyType, ValueType, Hash>::RemoveExpired(
+    Shard& shard, std::chrono::steady_clock::time_point now) {
+  while (!shard.expiry_order.empty() && IsExpired(shard.expiry_order.front()->second, now))
+    RemoveElement(shard, shard.expiry_order.front());
+}
+
+template <typename KeyType, typename ValueType, typename Hash>
+void ConcurrentLruCache<KeyType, ValueType, Hash>::RemoveElement(Shard& shard, Element* element) {
+  shard.order.erase(element->second.position);
+  if (time_to_live_ != std::chrono::steady_clock::duration::zero())
+    shard.expiry_order.erase(element->second.expiry_position);
+  // Erase by iterator since the key is owned by the element being erased.
+  shard.entries.erase(shard.entries.find(element->first));
+}
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_COMMON_CONTAINERS_CONCURRENT_LRU_CACHE_H_
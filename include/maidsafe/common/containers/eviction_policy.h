@@ -0,0 +1,330 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+/*
+  Replacement policies for a cache holding up to a fixed number of records.  A policy only tracks
+  keys; the cache holding the values tells it about every access, insertion and removal, and the
+  policy replies with the keys which should be evicted.
+
+  kLru - evicts the least recently used entry.  A single scan of many one-off keys flushes the
+  whole cache.
+
+  kWTinyLfu - a small (1%) LRU "window" admits every new entry, and entries leaving the window
+  compete for a place in the main segmented-LRU area (probationary and protected parts) against
+  that area's next victim.  The one with the higher estimated access frequency (from a
+  FrequencySketch) wins, so one-off keys rarely displace popular ones.
+
+  kArc - Adaptive Replacement Cache.  Splits resident entries into those seen once recently (T1)
+  and those seen at least twice (T2), and remembers the keys recently evicted from each (B1 and
+  B2).  Hits on those remembered keys continually adjust the target size of T1, so the cache
+  adapts between favouring recency and frequency.
+
+  These classes are not thread-safe.
+
+  Research links
+  http://arxiv.org/abs/1512.00727 (TinyLFU: A Highly Efficient Cache Admission Policy)
+  Megiddo and Modha, "ARC: A Self-Tuning, Low Overhead Replacement Cache", FAST 2003
+*/
+
+#ifndef MAIDSAFE_COMMON_CONTAINERS_EVICTION_POLICY_H_
+#define MAIDSAFE_COMMON_CONTAINERS_EVICTION_POLICY_H_
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "maidsafe/common/error.h"
+#include "maidsafe/common/log.h"
+#include "maidsafe/common/containers/frequency_sketch.h"
+
+namespace maidsafe {
+
+enum class EvictionPolicy { kLru, kWTinyLfu, kArc };
+
+namespace detail {
+
+// A number of LRU-ordered lists ("segments") of keys, with each key in at most one of them.
+template <typename KeyType, typename Hash, size_t SegmentCount>
+class SegmentedKeyLists {
+ public:
+  static const size_t kNone = SegmentCount;
+
+  SegmentedKeyLists() : segments_(), index_() {}
+
+  size_t SegmentOf(const KeyType& key) const {
+    auto itr(index_.find(key));
+    return itr == index_.end() ? kNone : itr->second.first;
+  }
+
+  // Adds 'key' as the most recently used of 'segment', moving it from any other segment.
+  void MoveToBack(size_t segment, const KeyType& key) {
+    auto itr(index_.find(key));
+    if (itr == index_.end()) {
+      segments_[segment].push_back(key);
+      index_.emplace(key, std::make_pair(segment, std::prev(segments_[segment].end())));
+    } else {
+      segments_[segment].splice(segments_[segment].end(), segments_[itr->second.first],
+                                itr->second.second);
+      itr->second.first = segment;
+    }
+  }
+
+  const KeyType& Front(size_t segment) const { return segments_[segment].front(); }
+
+  KeyType PopFront(size_t segment) {
+    KeyType key(std::move(segments_[segment].front()));
+    segments_[segment].pop_front();
+    index_.erase(key);
+    return key;
+  }
+
+  void Erase(const KeyType& key) {
+    auto itr(index_.find(key));
+    if (itr == index_.end())
+      return;
+    segments_[itr->second.first].erase(itr->second.second);
+    index_.erase(itr);
+  }
+
+  size_t size(size_t segment) const { return segments_[segment].size(); }
+
+ private:
+  typedef std::list<KeyType> Segment;
+  std::array<Segment, SegmentCount> segments_;
+  std::unordered_map<KeyType, std::pair<size_t, typename Segment::iterator>, Hash> index_;
+};
+
+template <typename KeyType, typename Hash, size_t SegmentCount>
+const size_t SegmentedKeyLists<KeyType, Hash, SegmentCount>::kNone;
+
+template <typename KeyType, typename Hash>
+class EvictionPolicyBase {
+ public:
+  explicit EvictionPolicyBase(size_t capacity) : capacity_(capacity) {}
+  virtual ~EvictionPolicyBase() = default;
+  EvictionPolicyBase(const EvictionPolicyBase&) = delete;
+  EvictionPolicyBase& operator=(const EvictionPolicyBase&) = delete;
+
+  // Called for every lookup, with 'hit' indicating whether 'key' is resident.
+  virtual void RecordAccess(const KeyType& key, bool hit) = 0;
+  // Called when a non-resident 'key' is added.  The keys of any resident entries (possibly
+  // including 'key' itself) which must be evicted to keep within capacity are appended to
+  // 'evicted'.
+  virtual void Insert(const KeyType& key, std::vector<KeyType>& evicted) = 0;
+  // Called when a resident 'key' is removed other than by eviction.
+  virtual void Erase(const KeyType& key) = 0;
+
+ protected:
+  const size_t capacity_;
+};
+
+template <typename KeyType, typename Hash>
+class LruPolicy : public EvictionPolicyBase<KeyType, Hash> {
+ public:
+  explicit LruPolicy(size_t capacity) : EvictionPolicyBase<KeyType, Hash>(capacity), keys_() {}
+
+  void RecordAccess(const KeyType& key, bool hit) override {
+    if (hit)
+      keys_.MoveToBack(0, key);
+  }
+
+  void Insert(const KeyType& key, std::vector<KeyType>& evicted) override {
+    keys_.MoveToBack(0, key);
+    while (keys_.size(0) > this->capacity_)
+      evicted.push_back(keys_.PopFront(0));
+  }
+
+  void Erase(const KeyType& key) override { keys_.Erase(key); }
+
+ private:
+  SegmentedKeyLists<KeyType, Hash, 1> keys_;
+};
+
+template <typename KeyType, typename Hash>
+class WTinyLfuPolicy : public EvictionPolicyBase<KeyType, Hash> {
+ public:
+  explicit WTinyLfuPolicy(size_t capacity)
+      : EvictionPolicyBase<KeyType, Hash>(capacity),
+        window_capacity_(std::max<size_t>(1, capacity / 100)),
+        main_capacity_(capacity > window_capacity_ ? capacity - window_capacity_ : 0),
+        protected_capacity_(main_capacity_ * 8 / 10),
+        keys_(),
+        sketch_(std::max<size_t>(capacity, 16)) {}
+
+  void RecordAccess(const KeyType& key, bool hit) override {
+    sketch_.Increment(key);
+    if (!hit)
+      return;
+    switch (keys_.SegmentOf(key)) {
+      case kWindow:
+        keys_.MoveToBack(kWindow, key);
+        break;
+      case kProbation:
+      case kProtected:
+        // Promote, demoting the least recently used protected entry if that part is now too big.
+        keys_.MoveToBack(kProtected, key);
+        if (keys_.size(kProtected) > protected_capacity_)
+          keys_.MoveToBack(kProbation, KeyType(keys_.Front(kProtected)));
+        break;
+      default:
+        break;
+    }
+  }
+
+  void Insert(const KeyType& key, std::vector<KeyType>& evicted) override {
+    sketch_.Increment(key);
+    keys_.MoveToBack(kWindow, key);
+    if (keys_.size(kWindow) <= window_capacity_)
+      return;
+
+    // The window's least recently used entry is a candidate for the main area.
+    KeyType candidate(keys_.Front(kWindow));
+    if (keys_.size(kProbation) + keys_.size(kProtected) < main_capacity_) {
+      keys_.MoveToBack(kProbation, candidate);
+      return;
+    }
+    if (main_capacity_ == 0) {
+      evicted.push_back(keys_.PopFront(kWindow));
+      return;
+    }
+    size_t victim_segment(keys_.size(kProbation) != 0 ? kProbation : kProtected);
+    const KeyType& victim(keys_.Front(victim_segment));
+    if (sketch_.Estimate(candidate) > sketch_.Estimate(victim)) {
+      evicted.push_back(keys_.PopFront(victim_segment));
+      keys_.MoveToBack(kProbation, candidate);
+    } else {
+      evicted.push_back(keys_.PopFront(kWindow));
+    }
+  }
+
+  void Erase(const KeyType& key) override { keys_.Erase(key); }
+
+ private:
+  enum Segment : size_t { kWindow = 0, kProbation = 1, kProtected = 2 };
+
+  const size_t window_capacity_, main_capacity_, protected_capacity_;
+  SegmentedKeyLists<KeyType, Hash, 3> keys_;
+  FrequencySketch<KeyType, Hash> sketch_;
+};
+
+template <typename KeyType, typename Hash>
+class ArcPolicy : public EvictionPolicyBase<KeyType, Hash> {
+ public:
+  explicit ArcPolicy(size_t capacity)
+      : EvictionPolicyBase<KeyType, Hash>(capacity), target_t1_size_(0), keys_() {}
+
+  void RecordAccess(const KeyType& key, bool hit) override {
+    if (hit)
+      keys_.MoveToBack(kT2, key);
+  }
+
+  void Insert(const KeyType& key, std::vector<KeyType>& evicted) override {
+    const size_t capacity(this->capacity_);
+    size_t b1(keys_.size(kB1)), b2(keys_.size(kB2));
+    switch (keys_.SegmentOf(key)) {
+      case kB1:
+        // Recently evicted after a single use, so favour recency by growing T1's target.
+        target_t1_size_ = std::min(capacity, target_t1_size_ + std::max<size_t>(b2 / b1, 1));
+        Replace(false, evicted);
+        keys_.MoveToBack(kT2, key);
+        return;
+      case kB2:
+        // Recently evicted after repeated use, so favour frequency by shrinking T1's target.
+        target_t1_size_ -= std::min(target_t1_size_, std::max<size_t>(b1 / b2, 1));
+        Replace(true, evicted);
+        keys_.MoveToBack(kT2, key);
+        return;
+      default:
+        break;
+    }
+
+    size_t t1(keys_.size(kT1)), t2(keys_.size(kT2));
+    if (t1 + b1 >= capacity) {
+      if (t1 < capacity) {
+        keys_.PopFront(kB1);
+        Replace(false, evicted);
+      } else {
+        evicted.push_back(keys_.PopFront(kT1));
+      }
+    } else if (t1 + t2 + b1 + b2 >= capacity) {
+      if (t1 + t2 + b1 + b2 >= 2 * capacity)
+        keys_.PopFront(kB2);
+      Replace(false, evicted);
+    }
+    keys_.MoveToBack(kT1, key);
+  }
+
+  void Erase(const KeyType& key) override {
+    size_t segment(keys_.SegmentOf(key));
+    if (segment == kT1 || segment == kT2)
+      keys_.Erase(key);
+  }
+
+ private:
+  enum Segment : size_t { kT1 = 0, kT2 = 1, kB1 = 2, kB2 = 3 };
+
+  // Evicts one resident entry if the cache is full, remembering its key in the matching ghost list.
+  void Replace(bool key_in_b2, std::vector<KeyType>& evicted) {
+    size_t t1(keys_.size(kT1)), t2(keys_.size(kT2));
+    if (t1 + t2 < this->capacity_ || t1 + t2 == 0)
+      return;
+    if (t1 != 0 &&
+        (t1 > target_t1_size_ || (key_in_b2 && t1 == target_t1_size_) || t2 == 0)) {
+      evicted.push_back(keys_.Front(kT1));
+      keys_.MoveToBack(kB1, KeyType(keys_.Front(kT1)));
+    } else {
+      evicted.push_back(keys_.Front(kT2));
+      keys_.MoveToBack(kB2, KeyType(keys_.Front(kT2)));
+    }
+  }
+
+  size_t target_t1_size_;
+  SegmentedKeyLists<KeyType, Hash, 4> keys_;
+};
+
+template <typename KeyType, typename Hash>
+std::unique_ptr<EvictionPolicyBase<KeyType, Hash>> MakeEvictionPolicy(EvictionPolicy policy,
+                                                                      size_t capacity) {
+  switch (policy) {
+    case EvictionPolicy::kLru:
+      return std::unique_ptr<EvictionPolicyBase<KeyType, Hash>>(
+          new LruPolicy<KeyType, Hash>(capacity));
+    case EvictionPolicy::kWTinyLfu:
+      return std::unique_ptr<EvictionPolicyBase<KeyType, Hash>>(
+          new WTinyLfuPolicy<KeyType, Hash>(capacity));
+    case EvictionPolicy::kArc:
+      return std::unique_ptr<EvictionPolicyBase<KeyType, Hash>>(
+          new ArcPolicy<KeyType, Hash>(capacity));
+    default:
+      LOG(kError) << "Unknown eviction policy.";
+      BOOST_THROW_EXCEPTION(MakeError(CommonErrors::invalid_parameter));
+  }
+}
+
+}  // namespace detail
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_COMMON_CONTAINERS_EVICTION_POLICY_H_
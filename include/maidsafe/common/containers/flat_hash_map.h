@@ -0,0 +1,387 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+/*
+  Open-addressing hash map and set with a subset of the std::unordered_map / std::unordered_set
+  interface, intended for keys such as NodeId, Identity and DataNameVariant whose std::hash is
+  already uniformly distributed.
+
+  The elements are held contiguously in a vector, in unspecified order.  They are indexed by a
+  separate power-of-two table of 8-byte slots, probed linearly, each holding an element's position
+  and 32 bits of its hash.  Those bits are taken from the top of the hash multiplied by a 64-bit
+  odd constant, so that they depend on all of the hash; otherwise keys whose hashes share their low
+  bits (e.g. the keys of one shard of a ShardedDataBuffer, chosen by hash modulo the shard count)
+  would only use a fraction of the slots.  Keys are only compared when the stored hash bits match.
+  Erasing an element moves the last element into its place and shifts back the following slots of
+  its probe sequence, so there are no tombstones.
+
+  Unlike the std containers:
+    * value_type is std::pair<Key, Value> for FlatHashMap, and keys mustn't be modified through an
+      iterator
+    * any insertion or erasure invalidates all iterators, pointers and references to elements
+    * erase(iterator) returns an iterator to the element moved into the erased one's place, so
+      'it = container.erase(it)' can be used to erase while iterating
+    * the number of elements is limited to kMaxSize
+
+  These classes are not thread-safe.
+*/
+
+#ifndef MAIDSAFE_COMMON_CONTAINERS_FLAT_HASH_MAP_H_
+#define MAIDSAFE_COMMON_CONTAINERS_FLAT_HASH_MAP_H_
+
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "maidsafe/common/error.h"
+#include "maidsafe/common/log.h"
+
+namespace maidsafe {
+
+namespace detail {
+
+template <typename Key>
+struct FlatHashSetKey {
+  const Key& operator()(const Key& value) const { return value; }
+};
+
+template <typename Key, typename Value>
+struct FlatHashMapKey {
+  const Key& operator()(const std::pair<Key, Value>& value) const { return value.first; }
+};
+
+template <typename Key, typename ValueType, typename GetKey, typename Hash, typename KeyEqual>
+class FlatHashTable {
+ public:
+  typedef Key key_type;
+  typedef ValueType value_type;
+  typedef Hash hasher;
+  typedef KeyEqual key_equal;
+  typedef size_t size_type;
+  typedef typename std::vector<ValueType>::iterator iterator;
+  typedef typename std::vector<ValueType>::const_iterator const_iterator;
+
+  static const size_t kMaxSize = 0x7fffffff;
+
+  explicit FlatHashTable(size_t count = 0, const Hash& hash = Hash(),
+                         const KeyEqual& key_equal = KeyEqual())
+      : hash_(hash), key_equal_(key_equal), values_(), slots_(), mask_(0) {
+    reserve(count);
+  }
+
+  iterator begin() { return values_.begin(); }
+  const_iterator begin() const { return values_.begin(); }
+  const_iterator cbegin() const { return values_.begin(); }
+  iterator end() { return values_.end(); }
+  const_iterator end() const { return values_.end(); }
+  const_iterator cend() const { return values_.end(); }
+
+  bool empty() const { return values_.empty(); }
+  size_t size() const { return values_.size(); }
+  size_t max_size() const { return kMaxSize; }
+
+  void clear() {
+    values_.clear();
+    slots_.clear();
+    mask_ = 0;
+  }
+
+  // Ensures 'count' elements can be held without rehashing.
+  void reserve(size_t count);
+
+  iterator find(const Key& key);
+  const_iterator find(const Key& key) const;
+  size_t count(const Key& key) const { return FindSlot(key, hash_(key)) == kNotFound ? 0 : 1; }
+
+  std::pair<iterator, bool> insert(const ValueType& value) { return Insert(value); }
+  std::pair<iterator, bool> insert(ValueType&& value) { return Insert(std::move(value)); }
+  template <typename... Args>
+  std::pair<iterator, bool> emplace(Args&&... args) {
+    return Insert(ValueType(std::forward<Args>(args)...));
+  }
+
+  size_t erase(const Key& key);
+  // Returns an iterator to the element which has been moved into the place of the erased one.
+  iterator erase(const_iterator position);
+
+  void swap(FlatHashTable& other);
+
+  hasher hash_function() const { return hash_; }
+  key_equal key_eq() const { return key_equal_; }
+
+ protected:
+  // Returns the position of the element with 'key', inserting one made by 'make_value' if needed.
+  template <typename MakeValue>
+  std::pair<size_t, bool> FindOrInsert(const Key& key, MakeValue make_value);
+
+ private:
+  struct Slot {
+    uint32_t index;
+    uint32_t hash;
+  };
+  static const uint32_t kEmpty = 0xffffffff;
+  static const size_t kNotFound = static_cast<size_t>(-1);
+
+  // The bits of 'hash' which are stored in its slot and used to place it.
+  static uint32_t SlotHash(size_t hash) {
+    return static_cast<uint32_t>((static_cast<uint64_t>(hash) * 0x9E3779B97F4A7C15ULL) >> 32);
+  }
+
+  // Grows 'slots_' if needed so that 'count' elements can be indexed.
+  void ReserveSlots(size_t count);
+  // Returns the position in 'slots_' of the slot for 'key', or kNotFound.
+  size_t FindSlot(const Key& key, size_t hash) const;
+  // Returns the position in 'slots_' of the slot for the element at 'index' in 'values_'.
+  size_t SlotOf(size_t index) const;
+  // Returns the first empty slot in the probe sequence of 'hash'.
+  size_t FreeSlot(uint32_t hash) const;
+  void Rehash(size_t slot_count);
+  template <typename V>
+  std::pair<iterator, bool> Insert(V&& value);
+  void EraseSlot(size_t slot);
+
+  Hash hash_;
+  KeyEqual key_equal_;
+  std::vector<ValueType> values_;
+  std::vector<Slot> slots_;
+  size_t mask_;
+};
+
+}  // namespace detail
+
+template <typename Key, typename Value, typename Hash = std::hash<Key>,
+          typename KeyEqual = std::equal_to<Key>>
+class FlatHashMap : public detail::FlatHashTable<Key, std::pair<Key, Value>,
+                                                 detail::FlatHashMapKey<Key, Value>, Hash,
+                                                 KeyEqual> {
+ public:
+  typedef Value mapped_type;
+
+  explicit FlatHashMap(size_t count = 0, const Hash& hash = Hash(),
+                       const KeyEqual& key_equal = KeyEqual())
+      : FlatHashMap::FlatHashTable(count, hash, key_equal) {}
+
+  Value& operator[](const Key& key) {
+    auto result(this->FindOrInsert(key, [&key] { return std::make_pair(key, Value()); }));
+    return (this->begin() + result.first)->second;
+  }
+
+  // Throws if 'key' isn't held.
+  Value& at(const Key& key);
+  const Value& at(const Key& key) const;
+};
+
+template <typename Key, typename Hash = std::hash<Key>, typename KeyEqual = std::equal_to<Key>>
+class FlatHashSet
+    : public detail::FlatHashTable<Key, Key, detail::FlatHashSetKey<Key>, Hash, KeyEqual> {
+ public:
+  explicit FlatHashSet(size_t count = 0, const Hash& hash = Hash(),
+                       const KeyEqual& key_equal = KeyEqual())
+      : FlatHashSet::FlatHashTable(count, hash, key_equal) {}
+};
+
+// ==================== Implementation =============================================================
+namespace detail {
+
+template <typename Key, typename ValueType, typename GetKey, typename Hash, typename KeyEqual>
+const size_t FlatHashTable<Key, ValueType, GetKey, Hash, KeyEqual>::kMaxSize;
+
+template <typename Key, typename ValueType, typename GetKey, typename Hash, typename KeyEqual>
+const uint32_t FlatHashTable<Key, ValueType, GetKey, Hash, KeyEqual>::kEmpty;
+
+template <typename Key, typename ValueType, typename GetKey, typename Hash, typename KeyEqual>
+const size_t FlatHashTable<Key, ValueType, GetKey, Hash, KeyEqual>::kNotFound;
+
+template <typename Key, typename ValueType, typename GetKey, typename Hash, typename KeyEqual>
+void FlatHashTable<Key, ValueType, GetKey, Hash, KeyEqual>::reserve(size_t count) {
+  ReserveSlots(count);
+  values_.reserve(count);
+}
+
+template <typename Key, typename ValueType, typename GetKey, typename Hash, typename KeyEqual>
+void FlatHashTable<Key, ValueType, GetKey, Hash, KeyEqual>::ReserveSlots(size_t count) {
+  if (count == 0)
+    return;
+  if (count > kMaxSize) {
+    LOG(kError) << "Can't hold " << count << " elements.";
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::cannot_exceed_limit));
+  }
+  // Keep the load factor at or below 3/4.
+  size_t slot_count(slots_.empty() ? 8 : slots_.size());
+  while (slot_count / 4 * 3 < count)
+    slot_count *= 2;
+  if (slot_count != slots_.size())
+    Rehash(slot_count);
+}
+
+template <typename Key, typename ValueType, typename GetKey, typename Hash, typename KeyEqual>
+typename FlatHashTable<Key, ValueType, GetKey, Hash, KeyEqual>::iterator
+    FlatHashTable<Key, ValueType, GetKey, Hash, KeyEqual>::find(const Key& key) {
+  const size_t slot(FindSlot(key, hash_(key)));
+  return slot == kNotFound ? values_.end() : values_.begin() + slots_[slot].index;
+}
+
+template <typename Key, typename ValueType, typename GetKey, typename Hash, typename KeyEqual>
+typename FlatHashTable<Key, ValueType, GetKey, Hash, KeyEqual>::const_iterator
+    FlatHashTable<Key, ValueType, GetKey, Hash, KeyEqual>::find(const Key& key) const {
+  const size_t slot(FindSlot(key, hash_(key)));
+  return slot == kNotFound ? values_.end() : values_.begin() + slots_[slot].index;
+}
+
+template <typename Key, typename ValueType, typename GetKey, typename Hash, typename KeyEqual>
+size_t FlatHashTable<Key, ValueType, GetKey, Hash, KeyEqual>::erase(const Key& key) {
+  const size_t slot(FindSlot(key, hash_(key)));
+  if (slot == kNotFound)
+    return 0;
+  EraseSlot(slot);
+  return 1;
+}
+
+template <typename Key, typename ValueType, typename GetKey, typename Hash, typename KeyEqual>
+typename FlatHashTable<Key, ValueType, GetKey, Hash, KeyEqual>::iterator
+    FlatHashTable<Key, ValueType, GetKey, Hash, KeyEqual>::erase(const_iterator position) {
+  const size_t index(static_cast<size_t>(position - values_.begin()));
+  EraseSlot(SlotOf(index));
+  return values_.begin() + index;
+}
+
+template <typename Key, typename ValueType, typename GetKey, typename Hash, typename KeyEqual>
+void FlatHashTable<Key, ValueType, GetKey, Hash, KeyEqual>::swap(FlatHashTable& other) {
+  using std::swap;
+  swap(hash_, other.hash_);
+  swap(key_equal_, other.key_equal_);
+  values_.swap(other.values_);
+  slots_.swap(other.slots_);
+  swap(mask_, other.mask_);
+}
+
+template <typename Key, typename ValueType, typename GetKey, typename Hash, typename KeyEqual>
+template <typename MakeValue>
+std::pair<size_t, bool> FlatHashTable<Key, ValueType, GetKey, Hash, KeyEqual>::FindOrInsert(
+    const Key& key, MakeValue make_value) {
+  const size_t hash(hash_(key));
+  const size_t slot(FindSlot(key, hash));
+  if (slot != kNotFound)
+    return std::make_pair(static_cast<size_t>(slots_[slot].index), false);
+  ReserveSlots(values_.size() + 1);
+  values_.push_back(make_value());
+  const Slot new_slot = {static_cast<uint32_t>(values_.size() - 1), SlotHash(hash)};
+  slots_[FreeSlot(new_slot.hash)] = new_slot;
+  return std::make_pair(values_.size() - 1, true);
+}
+
+template <typename Key, typename ValueType, typename GetKey, typename Hash, typename KeyEqual>
+size_t FlatHashTable<Key, ValueType, GetKey, Hash, KeyEqual>::FindSlot(const Key& key,
+                                                                        size_t hash) const {
+  if (slots_.empty())
+    return kNotFound;
+  const uint32_t short_hash(SlotHash(hash));
+  for (size_t slot(short_hash & mask_); slots_[slot].index != kEmpty; slot = (slot + 1) & mask_) {
+    if (slots_[slot].hash == short_hash &&
+        key_equal_(GetKey()(values_[slots_[slot].index]), key)) {
+      return slot;
+    }
+  }
+  return kNotFound;
+}
+
+template <typename Key, typename ValueType, typename GetKey, typename Hash, typename KeyEqual>
+size_t FlatHashTable<Key, ValueType, GetKey, Hash, KeyEqual>::SlotOf(size_t index) const {
+  size_t slot(SlotHash(hash_(GetKey()(values_[index]))) & mask_);
+  while (slots_[slot].index != index)
+    slot = (slot + 1) & mask_;
+  return slot;
+}
+
+template <typename Key, typename ValueType, typename GetKey, typename Hash, typename KeyEqual>
+size_t FlatHashTable<Key, ValueType, GetKey, Hash, KeyEqual>::FreeSlot(uint32_t hash) const {
+  size_t slot(hash & mask_);
+  while (slots_[slot].index != kEmpty)
+    slot = (slot + 1) & mask_;
+  return slot;
+}
+
+template <typename Key, typename ValueType, typename GetKey, typename Hash, typename KeyEqual>
+void FlatHashTable<Key, ValueType, GetKey, Hash, KeyEqual>::Rehash(size_t slot_count) {
+  // The stored 32 bits of each hash are enough to place it, since there are at most 2^32 slots.
+  const Slot empty_slot = {kEmpty, 0};
+  std::vector<Slot> old_slots(slot_count, empty_slot);
+  old_slots.swap(slots_);
+  mask_ = slot_count - 1;
+  for (const auto& slot : old_slots) {
+    if (slot.index != kEmpty)
+      slots_[FreeSlot(slot.hash)] = slot;
+  }
+}
+
+template <typename Key, typename ValueType, typename GetKey, typename Hash, typename KeyEqual>
+template <typename V>
+std::pair<typename FlatHashTable<Key, ValueType, GetKey, Hash, KeyEqual>::iterator, bool>
+    FlatHashTable<Key, ValueType, GetKey, Hash, KeyEqual>::Insert(V&& value) {
+  auto result(FindOrInsert(GetKey()(value), [&value] { return std::forward<V>(value); }));
+  return std::make_pair(values_.begin() + result.first, result.second);
+}
+
+template <typename Key, typename ValueType, typename GetKey, typename Hash, typename KeyEqual>
+void FlatHashTable<Key, ValueType, GetKey, Hash, KeyEqual>::EraseSlot(size_t slot) {
+  const size_t index(slots_[slot].index);
+  // Shift back any following slots in the probe sequence which can move into the gap.
+  size_t gap(slot);
+  for (size_t next((gap + 1) & mask_); slots_[next].index != kEmpty; next = (next + 1) & mask_) {
+    const size_t ideal(slots_[next].hash & mask_);
+    if (((next - ideal) & mask_) >= ((next - gap) & mask_)) {
+      slots_[gap] = slots_[next];
+      gap = next;
+    }
+  }
+  slots_[gap].index = kEmpty;
+
+  const size_t last(values_.size() - 1);
+  if (index != last) {
+    slots_[SlotOf(last)].index = static_cast<uint32_t>(index);
+    values_[index] = std::move(values_[last]);
+  }
+  values_.pop_back();
+}
+
+}  // namespace detail
+
+template <typename Key, typename Value, typename Hash, typename KeyEqual>
+Value& FlatHashMap<Key, Value, Hash, KeyEqual>::at(const Key& key) {
+  auto itr(this->find(key));
+  if (itr == this->end()) {
+    LOG(kError) << "No such element.";
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::no_such_element));
+  }
+  return itr->second;
+}
+
+template <typename Key, typename Value, typename Hash, typename KeyEqual>
+const Value& FlatHashMap<Key, Value, Hash, KeyEqual>::at(const Key& key) const {
+  auto itr(this->find(key));
+  if (itr == this->end()) {
+    LOG(kError) << "No such element.";
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::no_such_element));
+  }
+  return itr->second;
+}
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_COMMON_CONTAINERS_FLAT_HASH_MAP_H_
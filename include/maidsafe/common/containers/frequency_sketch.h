@@ -0,0 +1,118 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+/*
+  A count-min sketch giving an approximate, recent access frequency for each key, as used by the
+  TinyLFU admission policy.  Each key maps to one small saturating counter in each of four rows;
+  its estimated frequency is the minimum of those counters.  Once the number of increments reaches
+  ten times the row width, every counter is halved so that old accesses gradually decay.
+
+  This class is not thread-safe.
+
+  Research links
+  http://arxiv.org/abs/1512.00727 (TinyLFU: A Highly Efficient Cache Admission Policy)
+*/
+
+#ifndef MAIDSAFE_COMMON_CONTAINERS_FREQUENCY_SKETCH_H_
+#define MAIDSAFE_COMMON_CONTAINERS_FREQUENCY_SKETCH_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace maidsafe {
+
+template <typename KeyType, typename Hash = std::hash<KeyType>>
+class FrequencySketch {
+ public:
+  static const uint8_t kMaxFrequency = 15;
+
+  // 'width' is rounded up to a power of two.
+  explicit FrequencySketch(size_t width = 1 << 14)
+      : width_(RoundUpToPowerOfTwo(width)),
+        counters_(kDepth * width_, 0),
+        additions_(0),
+        hash_() {}
+
+  void Increment(const KeyType& key) {
+    uint64_t hash(hash_(key));
+    for (size_t row(0); row != kDepth; ++row) {
+      uint8_t& counter(counters_[Index(hash, row)]);
+      if (counter < kMaxFrequency)
+        ++counter;
+    }
+    if (++additions_ == 10 * width_)
+      Age();
+  }
+
+  uint8_t Estimate(const KeyType& key) const {
+    uint64_t hash(hash_(key));
+    uint8_t frequency(kMaxFrequency);
+    for (size_t row(0); row != kDepth; ++row)
+      frequency = std::min(frequency, counters_[Index(hash, row)]);
+    return frequency;
+  }
+
+  void Clear() {
+    std::fill(counters_.begin(), counters_.end(), 0);
+    additions_ = 0;
+  }
+
+  size_t width() const { return width_; }
+
+ private:
+  static const size_t kDepth = 4;
+
+  static size_t RoundUpToPowerOfTwo(size_t value) {
+    size_t result(1);
+    while (result < value)
+      result <<= 1;
+    return result;
+  }
+
+  // Each row uses a different multiplicative mix of the key's hash to pick its counter.
+  size_t Index(uint64_t hash, size_t row) const {
+    static const uint64_t kSeeds[kDepth] = {0x9E3779B97F4A7C15ULL, 0xC2B2AE3D27D4EB4FULL,
+                                            0x165667B19E3779F9ULL, 0xD6E8FEB86659FD93ULL};
+    hash = (hash + row) * kSeeds[row];
+    hash ^= hash >> 32;
+    return row * width_ + static_cast<size_t>(hash & (width_ - 1));
+  }
+
+  void Age() {
+    for (auto& counter : counters_)
+      counter >>= 1;
+    additions_ /= 2;
+  }
+
+  size_t width_;
+  std::vector<uint8_t> counters_;
+  size_t additions_;
+  Hash hash_;
+};
+
+template <typename KeyType, typename Hash>
+const uint8_t FrequencySketch<KeyType, Hash>::kMaxFrequency;
+
+template <typename KeyType, typename Hash>
+const size_t FrequencySketch<KeyType, Hash>::kDepth;
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_COMMON_CONTAINERS_FREQUENCY_SKETCH_H_
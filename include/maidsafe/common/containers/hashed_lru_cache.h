@@ -0,0 +1,424 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+/*
+  A hashed variant of LruCache with the same Check / Get / Add / Delete interface and the same
+  capacity and time to live semantics.  Each record is a single node holding the key (once), the
+  value, the time it was added and the links for an intrusive doubly-linked recency list, an
+  intrusive chained hash table and (if there is a time to live) an intrusive list in the order
+  added, which is also the order of expiry.  Every operation therefore does a single hash lookup,
+  and eviction or expiry unlinks the node directly rather than looking its key up again.  Nodes are
+  allocated in blocks and recycled through a free list, so a full cache which is continually
+  adding and evicting does no heap allocation.
+
+  As for LruCache, adding an entry to a cache with a capacity of zero throws.
+
+  KeyType must be hashable by Hash (std::hash by default) and comparable with ==.  This class is
+  not thread-safe.
+*/
+
+#ifndef MAIDSAFE_COMMON_CONTAINERS_HASHED_LRU_CACHE_H_
+#define MAIDSAFE_COMMON_CONTAINERS_HASHED_LRU_CACHE_H_
+
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "boost/expected/expected.hpp"
+
+#include "maidsafe/common/error.h"
+#include "maidsafe/common/log.h"
+#include "maidsafe/common/types.h"
+
+namespace maidsafe {
+
+namespace detail {
+
+template <typename KeyType, typename ValueType>
+struct HashedLruNode {
+  template <typename... Args>
+  HashedLruNode(KeyType key_in, size_t hash_in, std::chrono::steady_clock::time_point added_in,
+                Args&&... value_args)
+      : previous(nullptr),
+        next(nullptr),
+        bucket_next(nullptr),
+        expiry_previous(nullptr),
+        expiry_next(nullptr),
+        hash(hash_in),
+        added(added_in),
+        key(std::move(key_in)),
+        value(std::forward<Args>(value_args)...) {}
+  HashedLruNode *previous, *next, *bucket_next, *expiry_previous, *expiry_next;
+  size_t hash;
+  std::chrono::steady_clock::time_point added;
+  KeyType key;
+  ValueType value;
+};
+
+template <typename KeyType>
+struct HashedLruNode<KeyType, void> {
+  HashedLruNode(KeyType key_in, size_t hash_in, std::chrono::steady_clock::time_point added_in)
+      : previous(nullptr),
+        next(nullptr),
+        bucket_next(nullptr),
+        expiry_previous(nullptr),
+        expiry_next(nullptr),
+        hash(hash_in),
+        added(added_in),
+        key(std::move(key_in)) {}
+  HashedLruNode *previous, *next, *bucket_next, *expiry_previous, *expiry_next;
+  size_t hash;
+  std::chrono::steady_clock::time_point added;
+  KeyType key;
+};
+
+// Hands out uninitialised storage for nodes from blocks which are only freed on destruction.
+// Released nodes are kept on a free list (threaded through their first bytes) for reuse.
+template <typename Node>
+class NodePool {
+ public:
+  NodePool() : blocks_(), free_list_(nullptr), next_block_size_(kMinBlockSize) {}
+  NodePool(const NodePool&) = delete;
+  NodePool& operator=(const NodePool&) = delete;
+
+  template <typename... Args>
+  Node* Construct(Args&&... args) {
+    if (!free_list_)
+      AddBlock();
+    FreeSlot* slot(free_list_);
+    free_list_ = slot->next;
+    try {
+      return new (static_cast<void*>(slot)) Node(std::forward<Args>(args)...);
+    } catch (...) {
+      Release(static_cast<void*>(slot));
+      throw;
+    }
+  }
+
+  void Destroy(Node* node) {
+    node->~Node();
+    Release(static_cast<void*>(node));
+  }
+
+ private:
+  static const size_t kMinBlockSize = 16, kMaxBlockSize = 4096;
+  struct FreeSlot {
+    FreeSlot* next;
+  };
+  typedef typename std::aligned_storage<(sizeof(Node) > sizeof(FreeSlot) ? sizeof(Node)
+                                                                          : sizeof(FreeSlot)),
+                                        std::alignment_of<Node>::value>::type Slot;
+
+  void AddBlock() {
+    std::unique_ptr<Slot[]> block(new Slot[next_block_size_]);
+    for (size_t i(0); i != next_block_size_; ++i)
+      Release(static_cast<void*>(&block[i]));
+    blocks_.push_back(std::move(block));
+    if (next_block_size_ < kMaxBlockSize)
+      next_block_size_ *= 2;
+  }
+
+  void Release(void* storage) {
+    FreeSlot* slot(new (storage) FreeSlot);
+    slot->next = free_list_;
+    free_list_ = slot;
+  }
+
+  std::vector<std::unique_ptr<Slot[]>> blocks_;
+  FreeSlot* free_list_;
+  size_t next_block_size_;
+};
+
+template <typename Node>
+const size_t NodePool<Node>::kMinBlockSize;
+
+template <typename Node>
+const size_t NodePool<Node>::kMaxBlockSize;
+
+// Base class providing fixed-size (by number of records) and / or time_to_live LRU-replacement
+// cache, indexed by a hash table
+template <typename KeyType, typename ValueType, typename Hash>
+class HashedLruCacheBase {
+ public:
+  explicit HashedLruCacheBase(size_t capacity)
+      : HashedLruCacheBase(capacity, std::chrono::steady_clock::duration::zero()) {}
+
+  explicit HashedLruCacheBase(std::chrono::steady_clock::duration time_to_live)
+      : HashedLruCacheBase(std::numeric_limits<size_t>::max(), time_to_live) {}
+
+  HashedLruCacheBase(size_t capacity, std::chrono::steady_clock::duration time_to_live)
+      : capacity_(capacity),
+        time_to_live_(time_to_live),
+        hash_(),
+        buckets_(kInitialBucketCount, nullptr),
+        oldest_(nullptr),
+        newest_(nullptr),
+        expiry_oldest_(nullptr),
+        expiry_newest_(nullptr),
+        size_(0),
+        pool_() {}
+
+  virtual ~HashedLruCacheBase() {
+    while (oldest_) {
+      Node* next(oldest_->next);
+      pool_.Destroy(oldest_);
+      oldest_ = next;
+    }
+  }
+  HashedLruCacheBase(const HashedLruCacheBase&) = delete;
+  HashedLruCacheBase(HashedLruCacheBase&&) = delete;
+  HashedLruCacheBase& operator=(const HashedLruCacheBase&) = delete;
+  HashedLruCacheBase& operator=(HashedLruCacheBase&&) = delete;
+
+  bool Check(const KeyType& key) const {
+    Node* node(Find(key, HashOf(key)));
+    return node && !IsExpired(node, Now());
+  }
+
+  // Removes all entries whose time_to_live has passed.  This is done as part of every Add, Get and
+  // Delete, but can be called periodically to release expired entries sooner.
+  void RemoveExpired() { RemoveExpired(Now()); }
+
+  // Includes any expired entries not yet removed.
+  size_t size() const { return size_; }
+
+ protected:
+  typedef HashedLruNode<KeyType, ValueType> Node;
+
+  size_t HashOf(const KeyType& key) const { return hash_(key); }
+
+  Node* Find(const KeyType& key, size_t hash) const {
+    for (Node* node(buckets_[hash & (buckets_.size() - 1)]); node; node = node->bucket_next) {
+      if (node->hash == hash && node->key == key)
+        return node;
+    }
+    return nullptr;
+  }
+
+  // Returns the current time if there is a time_to_live, else a default-constructed time_point.
+  std::chrono::steady_clock::time_point Now() const {
+    return HasTimeToLive() ? std::chrono::steady_clock::now()
+                           : std::chrono::steady_clock::time_point();
+  }
+
+  // Returns the new node, or nullptr if 'key' is already held (in which case nothing changes).
+  // Throws if the capacity is zero.
+  template <typename... Args>
+  Node* PrepareToAddAndInsert(KeyType&& key, Args&&... value_args) {
+    auto now(Now());
+    // Check if we have entries with time expired
+    RemoveExpired(now);
+    size_t hash(HashOf(key));
+    if (Find(key, hash))
+      return nullptr;
+    if (capacity_ == 0) {
+      LOG(kError) << "Cannot add an entry to a HashedLruCache with capacity 0";
+      BOOST_THROW_EXCEPTION(MakeError(CommonErrors::cannot_exceed_limit));
+    }
+    // Check if we should evict any entries because of size
+    if (size_ == capacity_)
+      RemoveNode(oldest_);
+
+    if (size_ == buckets_.size())
+      Rehash(buckets_.size() * 2);
+    Node* node(pool_.Construct(std::move(key), hash, now, std::forward<Args>(value_args)...));
+    Node*& bucket(buckets_[hash & (buckets_.size() - 1)]);
+    node->bucket_next = bucket;
+    bucket = node;
+    // Record node as most-recently-used
+    node->previous = newest_;
+    (newest_ ? newest_->next : oldest_) = node;
+    newest_ = node;
+    if (HasTimeToLive()) {
+      node->expiry_previous = expiry_newest_;
+      (expiry_newest_ ? expiry_newest_->expiry_next : expiry_oldest_) = node;
+      expiry_newest_ = node;
+    }
+    ++size_;
+    return node;
+  }
+
+  void MoveToNewest(Node* node) {
+    if (node == newest_)
+      return;
+    Unlink(node);
+    node->previous = newest_;
+    node->next = nullptr;
+    newest_->next = node;
+    newest_ = node;
+  }
+
+  // Removes 'key' if held, returning true if it was.
+  bool Remove(const KeyType& key) {
+    RemoveExpired(Now());
+    size_t hash(HashOf(key));
+    for (Node** link(&buckets_[hash & (buckets_.size() - 1)]); *link;
+         link = &(*link)->bucket_next) {
+      Node* node(*link);
+      if (node->hash == hash && node->key == key) {
+        *link = node->bucket_next;
+        Destroy(node);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void RemoveNode(Node* node) {
+    assert(node);
+    Node** link(&buckets_[node->hash & (buckets_.size() - 1)]);
+    while (*link != node)
+      link = &(*link)->bucket_next;
+    *link = node->bucket_next;
+    Destroy(node);
+  }
+
+  // Entries expire in the order they were added, so only the front of the expiry list need be
+  // examined.
+  void RemoveExpired(std::chrono::steady_clock::time_point now) {
+    while (expiry_oldest_ && IsExpired(expiry_oldest_, now))
+      RemoveNode(expiry_oldest_);
+  }
+
+  bool IsExpired(const Node* node, std::chrono::steady_clock::time_point now) const {
+    return HasTimeToLive() && (node->added + time_to_live_) < now;
+  }
+
+  bool HasTimeToLive() const {
+    return time_to_live_ != std::chrono::steady_clock::duration::zero();
+  }
+
+  const size_t capacity_;
+  const std::chrono::steady_clock::duration time_to_live_;
+
+ private:
+  static const size_t kInitialBucketCount = 16;
+
+  void Unlink(Node* node) {
+    (node->previous ? node->previous->next : oldest_) = node->next;
+    (node->next ? node->next->previous : newest_) = node->previous;
+  }
+
+  // Unlinks 'node' from the recency and expiry lists and releases it.  The caller must already
+  // have unlinked it from its bucket.
+  void Destroy(Node* node) {
+    Unlink(node);
+    if (HasTimeToLive()) {
+      (node->expiry_previous ? node->expiry_previous->expiry_next : expiry_oldest_) =
+          node->expiry_next;
+      (node->expiry_next ? node->expiry_next->expiry_previous : expiry_newest_) =
+          node->expiry_previous;
+    }
+    pool_.Destroy(node);
+    --size_;
+  }
+
+  void Rehash(size_t bucket_count) {
+    std::vector<Node*> buckets(bucket_count, nullptr);
+    for (Node* node(oldest_); node; node = node->next) {
+      Node*& bucket(buckets[node->hash & (bucket_count - 1)]);
+      node->bucket_next = bucket;
+      bucket = node;
+    }
+    buckets_.swap(buckets);
+  }
+
+  Hash hash_;
+  // Always a power of two in size.
+  std::vector<Node*> buckets_;
+  Node *oldest_, *newest_, *expiry_oldest_, *expiry_newest_;
+  size_t size_;
+  NodePool<Node> pool_;
+};
+
+template <typename KeyType, typename ValueType, typename Hash>
+const size_t HashedLruCacheBase<KeyType, ValueType, Hash>::kInitialBucketCount;
+
+}  // namespace detail
+
+// Class providing fixed-size (by number of records) and / or time_to_live LRU-replacement cache
+template <typename KeyType, typename ValueType, typename Hash = std::hash<KeyType>>
+class HashedLruCache : public detail::HashedLruCacheBase<KeyType, ValueType, Hash> {
+ public:
+  explicit HashedLruCache(size_t capacity)
+      : detail::HashedLruCacheBase<KeyType, ValueType, Hash>(capacity) {}
+
+  explicit HashedLruCache(std::chrono::steady_clock::duration time_to_live)
+      : detail::HashedLruCacheBase<KeyType, ValueType, Hash>(time_to_live) {}
+
+  HashedLruCache(size_t capacity, std::chrono::steady_clock::duration time_to_live)
+      : detail::HashedLruCacheBase<KeyType, ValueType, Hash>(capacity, time_to_live) {}
+
+  virtual ~HashedLruCache() = default;
+  HashedLruCache(const HashedLruCache&) = delete;
+  HashedLruCache(HashedLruCache&&) = delete;
+  HashedLruCache& operator=(const HashedLruCache&) = delete;
+  HashedLruCache& operator=(HashedLruCache&&) = delete;
+
+  boost::expected<ValueType, maidsafe_error> Get(const KeyType& key) {
+    this->RemoveExpired(this->Now());
+    auto node = this->Find(key, this->HashOf(key));
+    if (!node)
+      return boost::make_unexpected(MakeError(CommonErrors::no_such_element));
+
+    // Update access record by moving accessed node to back of list
+    this->MoveToNewest(node);
+    return node->value;
+  }
+
+  void Add(KeyType key, ValueType value) {
+    this->PrepareToAddAndInsert(std::move(key), std::move(value));
+  }
+
+  void Delete(const KeyType& key) { this->Remove(key); }
+};
+
+// Class providing fixed-size (by number of records) and / or time_to_live LRU-replacement filter
+template <typename KeyType, typename Hash>
+class HashedLruCache<KeyType, void, Hash> : public detail::HashedLruCacheBase<KeyType, void, Hash> {
+ public:
+  explicit HashedLruCache(size_t capacity)
+      : detail::HashedLruCacheBase<KeyType, void, Hash>(capacity) {}
+
+  explicit HashedLruCache(std::chrono::steady_clock::duration time_to_live)
+      : detail::HashedLruCacheBase<KeyType, void, Hash>(time_to_live) {}
+
+  HashedLruCache(size_t capacity, std::chrono::steady_clock::duration time_to_live)
+      : detail::HashedLruCacheBase<KeyType, void, Hash>(capacity, time_to_live) {}
+
+  virtual ~HashedLruCache() = default;
+  HashedLruCache(const HashedLruCache&) = delete;
+  HashedLruCache(HashedLruCache&&) = delete;
+  HashedLruCache& operator=(const HashedLruCache&) = delete;
+  HashedLruCache& operator=(HashedLruCache&&) = delete;
+
+  void Add(KeyType key) { this->PrepareToAddAndInsert(std::move(key)); }
+
+  void Delete(const KeyType& key) { this->Remove(key); }
+};
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_COMMON_CONTAINERS_HASHED_LRU_CACHE_H_
@@ -20,9 +20,34 @@
   A least recently used cache that has a capacity and time to live setting. Passing a void ValueType
   allows this object to be used as a firewall / filter type device that can hold and check
   for keys already seen. Users can set the capacity, time_to_live or both allowing a cache that will
-  not hold data too long or stay full if it's not being accessed frequently. This should allow the
-  cache to not hold stale information at the cost of a check every time we add that looks
-  at the timestamp of the last entry in the list and compares this to the maps timestamp.
+  not hold data too long or stay full if it's not being accessed frequently.
+
+  Since every entry has the same time_to_live, entries expire in the order they were added.  As
+  well as the recency list, a cache with a time_to_live keeps a list of its records in the order
+  they were added; each Add, Get and Delete (or an explicit call to RemoveExpired) pops the expired
+  entries from the front of that list, so expiry costs O(1) amortised per entry and an expired
+  entry is never returned.  The clock is read at most once per call, and not at all without a
+  time_to_live.  A coarse cached clock was deliberately not used: reading the steady clock is cheap
+  next to a map lookup, whereas a cached one would need a ticking thread or would let entries
+  outlive their time_to_live by its granularity.
+
+  By default the capacity is a number of records.  Alternatively, an LruCache with a ValueType can
+  be given a Weigher, in which case the capacity is the maximum total weight (e.g. bytes) of the
+  held values, and adding an entry evicts as many of the least recently used entries as required
+  to make room for it.  Adding an entry which on its own is heavier than the capacity throws
+  without modifying the cache.
+
+  Get returns a copy of the value, or an error on a miss.  Where that is too costly (e.g. for large
+  values, or where misses are common), Find and the visitor overload of Get give access to the held
+  value without copying it, and report a miss without constructing an error.  Check is the
+  equivalent for a membership test which shouldn't affect recency.
+
+  An LruCache with a ValueType can be saved to and restored from a file (e.g. across a restart) via
+  SaveSnapshot and LoadSnapshot, as long as KeyType and ValueType are serialisable with Cereal.
+  Entries are written least recently used first, each with its age, and are streamed straight to
+  the file rather than being collected in memory first.  Loading adds the entries in that order, so
+  their relative recency is preserved, and counts the time since the snapshot was written towards
+  their ages, so their remaining time_to_live is too.
 
   Research links
   http://en.wikipedia.org/wiki/Cache_algorithms
@@ -34,8 +59,12 @@
 #ifndef MAIDSAFE_COMMON_CONTAINERS_LRU_CACHE_H_
 #define MAIDSAFE_COMMON_CONTAINERS_LRU_CACHE_H_
 
+#include <algorithm>
 #include <cassert>
 #include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <functional>
 #include <limits>
 #include <list>
 #include <map>
@@ -43,7 +72,12 @@
 #include <utility>
 
 #include "boost/expected/expected.hpp"
+#include "boost/filesystem/operations.hpp"
+#include "boost/filesystem/path.hpp"
+#include "cereal/archives/binary.hpp"
 
+#include "maidsafe/common/error.h"
+#include "maidsafe/common/log.h"
 #include "maidsafe/common/types.h"
 
 namespace maidsafe {
@@ -54,34 +88,76 @@ namespace detail {
 template <typename KeyType>
 using KeyOrder = std::list<KeyType>;
 
+// Points to the records held in the storage map, in the order they were added.  The storage and
+// expiry list types refer to each other, so ExpiryEntry is only defined after StorageType; the
+// list's element type may be incomplete until then.
+template <typename KeyType, typename T>
+struct ExpiryEntry;
+
+template <typename KeyType, typename T>
+using ExpiryOrder = std::list<ExpiryEntry<KeyType, T>>;
+
+// Written at the start of every LruCache snapshot file.
+const uint32_t kLruCacheSnapshotVersion = 1;
+
 template <typename T>
 struct TypeHelper {
   using type = T;
 };
 
+// A record holding a value also holds the value's weight.  The final element of every record is
+// its position in the ExpiryOrder (only valid if the cache has a time_to_live).
 template <typename KeyType, typename T>
 struct StorageType
-    : TypeHelper<std::map<KeyType, std::tuple<typename KeyOrder<KeyType>::iterator,
-                                              std::chrono::steady_clock::time_point, T>>> {};
+    : TypeHelper<std::map<KeyType,
+                          std::tuple<typename KeyOrder<KeyType>::iterator,
+                                     std::chrono::steady_clock::time_point, T, size_t,
+                                     typename ExpiryOrder<KeyType, T>::iterator>>> {};
 
 template <typename KeyType>
 struct StorageType<KeyType, void>
     : TypeHelper<std::map<KeyType, std::tuple<typename KeyOrder<KeyType>::iterator,
-                                              std::chrono::steady_clock::time_point>>> {};
+                                              std::chrono::steady_clock::time_point,
+                                              typename ExpiryOrder<KeyType, void>::iterator>>> {};
+
+template <typename KeyType, typename T>
+struct ExpiryEntry {
+  typename StorageType<KeyType, T>::type::iterator record;
+};
 
-// Base class providing fixed-size (by number of records) and / or time_to_live LRU-replacement
-// cache
+template <typename Iterator, typename ExpiryIterator>
+size_t RecordWeight(
+    const std::tuple<Iterator, std::chrono::steady_clock::time_point, ExpiryIterator>&) {
+  return 1;
+}
+
+template <typename Iterator, typename T, typename ExpiryIterator>
+size_t RecordWeight(const std::tuple<Iterator, std::chrono::steady_clock::time_point, T, size_t,
+                                     ExpiryIterator>& record) {
+  return std::get<3>(record);
+}
+
+template <typename Record>
+auto ExpiryPosition(Record& record)
+    -> decltype(std::get<std::tuple_size<Record>::value - 1>(record)) {
+  return std::get<std::tuple_size<Record>::value - 1>(record);
+}
+
+// Base class providing fixed-size (by number of records or by total weight) and / or time_to_live
+// LRU-replacement cache
 template <typename KeyType, typename ValueType>
 class LruCacheBase {
  public:
   explicit LruCacheBase(size_t capacity)
-      : capacity_(capacity), time_to_live_(std::chrono::steady_clock::duration::zero()) {}
+      : capacity_(capacity), time_to_live_(std::chrono::steady_clock::duration::zero()),
+        total_weight_(0) {}
 
   explicit LruCacheBase(std::chrono::steady_clock::duration time_to_live)
-      : capacity_(std::numeric_limits<size_t>::max()), time_to_live_(time_to_live) {}
+      : capacity_(std::numeric_limits<size_t>::max()), time_to_live_(time_to_live),
+        total_weight_(0) {}
 
   LruCacheBase(size_t capacity, std::chrono::steady_clock::duration time_to_live)
-      : capacity_(capacity), time_to_live_(time_to_live) {}
+      : capacity_(capacity), time_to_live_(time_to_live), total_weight_(0) {}
 
   virtual ~LruCacheBase() = default;
   LruCacheBase(const LruCacheBase&) = delete;
@@ -89,65 +165,136 @@ class LruCacheBase {
   LruCacheBase& operator=(const LruCacheBase&) = delete;
   LruCacheBase& operator=(LruCacheBase&&) = delete;
 
-  bool Check(const KeyType& key) const { return storage_.find(key) != storage_.end(); }
+  bool Check(const KeyType& key) const {
+    const auto it = storage_.find(key);
+    return it != storage_.end() && !IsExpired(it->second, Now());
+  }
+
+  // Removes all entries whose time_to_live has passed.  This is done as part of every Add, Get and
+  // Delete, but can be called periodically to release expired entries sooner.
+  void RemoveExpired() { RemoveExpired(Now()); }
 
+  // Includes any expired entries not yet removed.
   size_t size() const { return storage_.size(); }
 
+  // Sum of the weights of all held entries.  Equal to size() unless a Weigher is being used.
+  size_t total_weight() const { return total_weight_; }
+
  protected:
   template <typename T>
   using Storage = typename StorageType<KeyType, T>::type;
+  typedef ExpiryEntry<KeyType, ValueType> Expiry;
+
+  // Returns the current time if there is a time_to_live, else a default-constructed time_point.
+  std::chrono::steady_clock::time_point Now() const {
+    return HasTimeToLive() ? std::chrono::steady_clock::now()
+                           : std::chrono::steady_clock::time_point();
+  }
 
-  typename KeyOrder<KeyType>::iterator PrepareToAdd(const KeyType& key) {
+  // Throws if 'weight' exceeds the capacity.  Otherwise, evicts expired entries and as many other
+  // entries as required to make room for 'weight' and records the new usage of 'weight'.  The
+  // caller must then insert the new record and pass it to ScheduleExpiry.
+  typename KeyOrder<KeyType>::iterator PrepareToAdd(const KeyType& key,
+                                                    std::chrono::steady_clock::time_point now,
+                                                    size_t weight = 1) {
+    // Check if we have entries with time expired
+    RemoveExpired(now);
     if (storage_.find(key) != storage_.end())
       return std::end(key_order_);
+    if (weight > capacity_) {
+      LOG(kError) << "Cannot add an entry of weight " << weight << " to an LruCache with capacity "
+                  << capacity_;
+      BOOST_THROW_EXCEPTION(MakeError(CommonErrors::cannot_exceed_limit));
+    }
     // Check if we should evict any entries because of size
-    if (storage_.size() == capacity_)
-      RemoveOldestElement();
-    // Check if we have entries with time expired
-    while (CheckTimeExpired())  // Any old entries at beginning of the list
+    while (weight > capacity_ - total_weight_)
       RemoveOldestElement();
 
     // Record key as most-recently-used key
+    total_weight_ += weight;
     return key_order_.insert(std::end(key_order_), key);
   }
 
+  void ScheduleExpiry(typename Storage<ValueType>::iterator it) {
+    if (HasTimeToLive())
+      ExpiryPosition(it->second) = expiry_order_.insert(expiry_order_.end(), Expiry{it});
+  }
+
+  void RemoveElement(typename Storage<ValueType>::iterator it) {
+    total_weight_ -= RecordWeight(it->second);
+    key_order_.erase(std::get<0>(it->second));
+    if (HasTimeToLive())
+      expiry_order_.erase(ExpiryPosition(it->second));
+    storage_.erase(it);
+  }
+
   void RemoveOldestElement() {
     assert(!key_order_.empty());
     // Identify least recently used key
     const auto it = storage_.find(key_order_.front());
     assert(it != storage_.end());
-    // Erase both elements in both containers
-    storage_.erase(it);
-    key_order_.pop_front();
+    RemoveElement(it);
   }
 
-  bool CheckTimeExpired() const {
-    if (time_to_live_ == std::chrono::steady_clock::duration::zero() || storage_.empty())
-      return false;
-    auto key = storage_.find(key_order_.front());
-    assert(key != std::end(storage_) && "cannot find element");
-    return (std::get<1>(key->second) + time_to_live_) < std::chrono::steady_clock::now();
+  void RemoveExpired(std::chrono::steady_clock::time_point now) {
+    while (!expiry_order_.empty()) {
+      const auto it = expiry_order_.front().record;
+      if (!IsExpired(it->second, now))
+        return;
+      RemoveElement(it);
+    }
+  }
+
+  // Restores the order of expiry_order_ by time added, after records have been added out of order.
+  void SortExpiryOrder() {
+    expiry_order_.sort([](const Expiry& lhs, const Expiry& rhs) {
+      return std::get<1>(lhs.record->second) < std::get<1>(rhs.record->second);
+    });
+  }
+
+  template <typename Record>
+  bool IsExpired(const Record& record, std::chrono::steady_clock::time_point now) const {
+    return HasTimeToLive() && (std::get<1>(record) + time_to_live_) < now;
+  }
+
+  bool HasTimeToLive() const {
+    return time_to_live_ != std::chrono::steady_clock::duration::zero();
   }
 
   const size_t capacity_;
   const std::chrono::steady_clock::duration time_to_live_;
   KeyOrder<KeyType> key_order_;
+  ExpiryOrder<KeyType, ValueType> expiry_order_;
   Storage<ValueType> storage_;
+  size_t total_weight_;
 };
 
 }  // namespace detail
 
-// Class providing fixed-size (by number of records) and / or time_to_live LRU-replacement cache
+// Class providing fixed-size (by number of records or by total weight) and / or time_to_live
+// LRU-replacement cache
 template <typename KeyType, typename ValueType>
 class LruCache : public detail::LruCacheBase<KeyType, ValueType> {
  public:
-  explicit LruCache(size_t capacity) : detail::LruCacheBase<KeyType, ValueType>(capacity) {}
+  // Returns the cost of holding the given entry, e.g. its size in bytes.
+  typedef std::function<size_t(const KeyType&, const ValueType&)> Weigher;
+
+  explicit LruCache(size_t capacity)
+      : detail::LruCacheBase<KeyType, ValueType>(capacity), weigher_() {}
 
   explicit LruCache(std::chrono::steady_clock::duration time_to_live)
-      : detail::LruCacheBase<KeyType, ValueType>(time_to_live) {}
+      : detail::LruCacheBase<KeyType, ValueType>(time_to_live), weigher_() {}
 
   LruCache(size_t capacity, std::chrono::steady_clock::duration time_to_live)
-      : detail::LruCacheBase<KeyType, ValueType>(capacity, time_to_live) {}
+      : detail::LruCacheBase<KeyType, ValueType>(capacity, time_to_live), weigher_() {}
+
+  // 'capacity' is the maximum total weight of all entries as given by 'weigher'.
+  LruCache(size_t capacity, Weigher weigher)
+      : detail::LruCacheBase<KeyType, ValueType>(capacity), weigher_(std::move(weigher)) {}
+
+  LruCache(size_t capacity, std::chrono::steady_clock::duration time_to_live, Weigher weigher)
+      : detail::LruCacheBase<KeyType, ValueType>(capacity, time_to_live),
+        weigher_(std::move(weigher)) {}
 
   virtual ~LruCache() = default;
   LruCache(const LruCache&) = delete;
@@ -158,33 +305,184 @@ class LruCache : public detail::LruCacheBase<KeyType, ValueType> {
   // We do not return an iterator here and use a pair instead as we are keeping two containers in
   // sync and cannot allow access to these containers from the public interface
   boost::expected<ValueType, maidsafe_error> Get(const KeyType& key) {
-    const auto it = this->storage_.find(key);
+    const ValueType* value(Find(key));
+    if (!value)
+      return boost::make_unexpected(MakeError(CommonErrors::no_such_element));
+    return *value;
+  }
 
+  // As for Get, but calls 'visitor' with a const reference to the held value rather than returning
+  // a copy.  Returns false without calling 'visitor' if 'key' isn't held.
+  template <typename Visitor>
+  bool Get(const KeyType& key, Visitor visitor) {
+    const ValueType* value(Find(key));
+    if (!value)
+      return false;
+    visitor(*value);
+    return true;
+  }
+
+  // As for Get, but returns a pointer to the held value, or nullptr if 'key' isn't held.  The
+  // pointer is invalidated by the next call to any non-const member function.
+  const ValueType* Find(const KeyType& key) {
+    this->RemoveExpired(this->Now());
+    const auto it = this->storage_.find(key);
     if (it == this->storage_.end())
-      return boost::make_unexpected(MakeError(CommonErrors::no_such_element));
+      return nullptr;
 
     // Update access record by moving accessed key to back of list
     this->key_order_.splice(this->key_order_.end(), this->key_order_, std::get<0>(it->second));
-    return std::get<2>(it->second);
+    return &std::get<2>(it->second);
   }
 
+  // Throws if a Weigher is being used and it gives 'value' a weight greater than the capacity.
   void Add(KeyType key, ValueType value) {
-    auto it = this->PrepareToAdd(key);
+    size_t weight(weigher_ ? weigher_(key, value) : 1);
+    auto now(this->Now());
+    auto it = this->PrepareToAdd(key, now, weight);
     if (it == std::end(this->key_order_))
       return;
     // Create the key-value entry, linked to the usage record.
-    this->storage_.insert(std::make_pair(
-        std::move(key), std::make_tuple(it, std::chrono::steady_clock::now(), std::move(value))));
+    typedef typename detail::ExpiryOrder<KeyType, ValueType>::iterator ExpiryIterator;
+    auto record = this->storage_.insert(std::make_pair(
+        std::move(key), std::make_tuple(it, now, std::move(value), weight, ExpiryIterator())));
+    this->ScheduleExpiry(record.first);
   }
 
   void Delete(const KeyType& key) {
+    this->RemoveExpired(this->Now());
     const auto it = this->storage_.find(key);
-    if (it != this->storage_.end()) {
-      std::get<1>(it->second) = std::chrono::steady_clock::now() - this->time_to_live_;
-      this->key_order_.splice(this->key_order_.begin(), this->key_order_, std::get<0>(it->second));
-      this->RemoveOldestElement();
+    if (it != this->storage_.end())
+      this->RemoveElement(it);
+  }
+
+  // Writes all unexpired entries to 'path'.  The snapshot is written to a temporary file which then
+  // replaces any existing one at 'path', so a failure never leaves a partial snapshot there.
+  void SaveSnapshot(const boost::filesystem::path& path) {
+    auto now(this->Now());
+    this->RemoveExpired(now);
+    const boost::filesystem::path temp_path(path.string() + ".tmp");
+    boost::system::error_code error_code;
+    {
+      std::ofstream file(temp_path.string(), std::ios::binary | std::ios::trunc);
+      try {
+        if (!file)
+          BOOST_THROW_EXCEPTION(MakeError(CommonErrors::filesystem_io_error));
+        WriteSnapshot(file, now);
+        file.close();
+        if (!file)
+          BOOST_THROW_EXCEPTION(MakeError(CommonErrors::filesystem_io_error));
+      } catch (const cereal::Exception& e) {
+        LOG(kError) << "Failed to serialise LruCache snapshot: " << e.what();
+        boost::filesystem::remove(temp_path, error_code);
+        BOOST_THROW_EXCEPTION(MakeError(CommonErrors::serialisation_error));
+      } catch (const maidsafe_error&) {
+        LOG(kError) << "Failed to write LruCache snapshot to " << temp_path;
+        boost::filesystem::remove(temp_path, error_code);
+        throw;
+      }
+    }
+    boost::filesystem::rename(temp_path, path, error_code);
+    if (error_code) {
+      LOG(kError) << "Failed to rename " << temp_path << " to " << path << ": "
+                  << error_code.message();
+      boost::filesystem::remove(temp_path, error_code);
+      BOOST_THROW_EXCEPTION(MakeError(CommonErrors::filesystem_io_error));
+    }
+  }
+
+  // Adds the entries from a snapshot written by SaveSnapshot, as if by calling Add for each in
+  // turn, so entries already held are left unchanged and the loaded ones become the most recently
+  // used.  Entries which have expired, or which are heavier than the capacity, are skipped.  KeyType
+  // and ValueType must be default-constructible.  If this throws, entries read before the failure
+  // are kept.
+  void LoadSnapshot(const boost::filesystem::path& path) {
+    std::ifstream file(path.string(), std::ios::binary);
+    if (!file) {
+      LOG(kError) << "Failed to open LruCache snapshot " << path;
+      BOOST_THROW_EXCEPTION(MakeError(CommonErrors::filesystem_io_error));
     }
+    try {
+      ReadSnapshot(file);
+    } catch (const cereal::Exception& e) {
+      this->SortExpiryOrder();
+      LOG(kError) << "Failed to parse LruCache snapshot " << path << ": " << e.what();
+      BOOST_THROW_EXCEPTION(MakeError(CommonErrors::parsing_error));
+    } catch (...) {
+      this->SortExpiryOrder();
+      throw;
+    }
+    this->SortExpiryOrder();
   }
+
+ private:
+  void WriteSnapshot(std::ostream& stream, std::chrono::steady_clock::time_point now) const {
+    cereal::BinaryOutputArchive archive(stream);
+    int64_t saved_at(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         std::chrono::system_clock::now().time_since_epoch()).count());
+    archive(detail::kLruCacheSnapshotVersion, saved_at,
+            static_cast<uint64_t>(this->storage_.size()));
+    // Least recently used first, so that loading the entries in order restores their recency.
+    for (const auto& key : this->key_order_) {
+      const auto& record(this->storage_.find(key)->second);
+      int64_t age(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      now - std::get<1>(record)).count());
+      archive(key, std::get<2>(record), age);
+    }
+  }
+
+  // Records are added out of expiry order, so the caller must call SortExpiryOrder afterwards.
+  void ReadSnapshot(std::istream& stream) {
+    cereal::BinaryInputArchive archive(stream);
+    uint32_t version(0);
+    int64_t saved_at(0);
+    uint64_t count(0);
+    archive(version, saved_at, count);
+    if (version != detail::kLruCacheSnapshotVersion) {
+      LOG(kError) << "Unsupported LruCache snapshot version " << version;
+      BOOST_THROW_EXCEPTION(MakeError(CommonErrors::parsing_error));
+    }
+    auto now(this->Now());
+    // The steady clock doesn't persist across restarts, so use the system clock to find how long
+    // the snapshot has been waiting to be loaded.
+    std::chrono::nanoseconds downtime(std::max(
+        std::chrono::nanoseconds(0),
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()) -
+            std::chrono::nanoseconds(saved_at)));
+    for (uint64_t i(0); i != count; ++i) {
+      KeyType key;
+      ValueType value;
+      int64_t age(0);
+      archive(key, value, age);
+      if (!this->HasTimeToLive()) {
+        AddLoaded(std::move(key), std::move(value), now, now);
+        continue;
+      }
+      auto total_age(std::chrono::nanoseconds(age) + downtime);
+      if (total_age > this->time_to_live_)
+        continue;
+      AddLoaded(std::move(key), std::move(value),
+                now - std::chrono::duration_cast<std::chrono::steady_clock::duration>(total_age),
+                now);
+    }
+  }
+
+  void AddLoaded(KeyType key, ValueType value, std::chrono::steady_clock::time_point added,
+                 std::chrono::steady_clock::time_point now) {
+    size_t weight(weigher_ ? weigher_(key, value) : 1);
+    if (weight > this->capacity_)
+      return;
+    auto it = this->PrepareToAdd(key, now, weight);
+    if (it == std::end(this->key_order_))
+      return;
+    typedef typename detail::ExpiryOrder<KeyType, ValueType>::iterator ExpiryIterator;
+    auto record = this->storage_.insert(std::make_pair(
+        std::move(key), std::make_tuple(it, added, std::move(value), weight, ExpiryIterator())));
+    this->ScheduleExpiry(record.first);
+  }
+
+  const Weigher weigher_;
 };
 
 // Class providing fixed-size (by number of records) and / or time_to_live LRU-replacement filter
@@ -206,12 +504,22 @@ class LruCache<KeyType, void> : public detail::LruCacheBase<KeyType, void> {
   LruCache& operator=(LruCache&&) = delete;
 
   void Add(KeyType key) {
-    auto it = this->PrepareToAdd(key);
+    auto now(this->Now());
+    auto it = this->PrepareToAdd(key, now);
     if (it == std::end(this->key_order_))
       return;
     // Create the key entry, linked to the usage record.
-    this->storage_.insert(
-        std::make_pair(std::move(key), std::make_tuple(it, std::chrono::steady_clock::now())));
+    typedef typename detail::ExpiryOrder<KeyType, void>::iterator ExpiryIterator;
+    auto record = this->storage_.insert(
+        std::make_pair(std::move(key), std::make_tuple(it, now, ExpiryIterator())));
+    this->ScheduleExpiry(record.first);
+  }
+
+  void Delete(const KeyType& key) {
+    this->RemoveExpired(this->Now());
+    const auto it = this->storage_.find(key);
+    if (it != this->storage_.end())
+      this->RemoveElement(it);
   }
 };
 
@@ -0,0 +1,118 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+/*
+  A fixed-size (by number of records) cache with the same Check / Get / Add / Delete interface as
+  LruCache, but where the replacement policy is chosen per instance.  See eviction_policy.h for
+  the available policies.  With EvictionPolicy::kLru this behaves like an LruCache without a time
+  to live; kWTinyLfu and kArc are resistant to scans of one-off keys.
+
+  Unlike LruCache, Add can evict the entry being added straight away if the policy judges it less
+  valuable than everything already held (kWTinyLfu does this).
+
+  This class is not thread-safe.
+*/
+
+#ifndef MAIDSAFE_COMMON_CONTAINERS_POLICY_CACHE_H_
+#define MAIDSAFE_COMMON_CONTAINERS_POLICY_CACHE_H_
+
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "boost/expected/expected.hpp"
+
+#include "maidsafe/common/error.h"
+#include "maidsafe/common/log.h"
+#include "maidsafe/common/types.h"
+#include "maidsafe/common/containers/eviction_policy.h"
+
+namespace maidsafe {
+
+template <typename KeyType, typename ValueType, typename Hash = std::hash<KeyType>>
+class PolicyCache {
+ public:
+  // Throws if capacity is 0.
+  PolicyCache(size_t capacity, EvictionPolicy policy)
+      : capacity_(CheckCapacity(capacity)),
+        policy_type_(policy),
+        policy_(detail::MakeEvictionPolicy<KeyType, Hash>(policy, capacity)),
+        storage_(),
+        evicted_() {}
+
+  ~PolicyCache() = default;
+  PolicyCache(const PolicyCache&) = delete;
+  PolicyCache(PolicyCache&&) = delete;
+  PolicyCache& operator=(const PolicyCache&) = delete;
+  PolicyCache& operator=(PolicyCache&&) = delete;
+
+  bool Check(const KeyType& key) const { return storage_.find(key) != storage_.end(); }
+
+  boost::expected<ValueType, maidsafe_error> Get(const KeyType& key) {
+    const auto it = storage_.find(key);
+    policy_->RecordAccess(key, it != storage_.end());
+    if (it == storage_.end())
+      return boost::make_unexpected(MakeError(CommonErrors::no_such_element));
+    return it->second;
+  }
+
+  // This is a no-op if 'key' is already held.
+  void Add(KeyType key, ValueType value) {
+    if (storage_.find(key) != storage_.end())
+      return;
+    auto it = storage_.emplace(std::move(key), std::move(value)).first;
+    evicted_.clear();
+    policy_->Insert(it->first, evicted_);
+    for (const auto& evicted_key : evicted_)
+      storage_.erase(evicted_key);
+  }
+
+  void Delete(const KeyType& key) {
+    const auto it = storage_.find(key);
+    if (it == storage_.end())
+      return;
+    policy_->Erase(key);
+    storage_.erase(it);
+  }
+
+  size_t size() const { return storage_.size(); }
+  size_t capacity() const { return capacity_; }
+  EvictionPolicy policy() const { return policy_type_; }
+
+ private:
+  static size_t CheckCapacity(size_t capacity) {
+    if (capacity == 0) {
+      LOG(kError) << "PolicyCache needs a non-zero capacity.";
+      BOOST_THROW_EXCEPTION(MakeError(CommonErrors::invalid_parameter));
+    }
+    return capacity;
+  }
+
+  const size_t capacity_;
+  const EvictionPolicy policy_type_;
+  std::unique_ptr<detail::EvictionPolicyBase<KeyType, Hash>> policy_;
+  std::unordered_map<KeyType, ValueType, Hash> storage_;
+  // Reused across calls to Add to avoid an allocation per eviction.
+  std::vector<KeyType> evicted_;
+};
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_COMMON_CONTAINERS_POLICY_CACHE_H_
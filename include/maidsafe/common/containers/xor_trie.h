@@ -0,0 +1,335 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+/*
+  A map from NodeId to value, indexed for queries in XOR space: the k entries closest to a target,
+  and the number of entries sharing at least a given number of leading bits with a target (i.e. the
+  population of the corresponding range of Kademlia k-buckets).
+
+  The keys are held in a binary trie with single-child paths collapsed (a crit-bit tree), so for
+  uniformly-distributed IDs the depth is O(log n) rather than the number of bits in an ID.  Each
+  internal node holds the first bit position at which the keys below it differ, and how many keys
+  are below it.  Visiting the child which matches the target's bit first yields entries in order of
+  increasing XOR distance, so Closest is O(log n + k) and CountWithinCommonLeadingBits is O(log n).
+
+  Internal nodes are 16-byte records held contiguously in one vector and linked by 32-bit index,
+  and entries are held contiguously in another.  Both are kept compact on Delete by moving the last
+  record into the vacated slot.  The number of entries is limited to kMaxSize.
+
+  This class is not thread-safe.
+*/
+
+#ifndef MAIDSAFE_COMMON_CONTAINERS_XOR_TRIE_H_
+#define MAIDSAFE_COMMON_CONTAINERS_XOR_TRIE_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "maidsafe/common/error.h"
+#include "maidsafe/common/log.h"
+#include "maidsafe/common/node_id.h"
+
+namespace maidsafe {
+
+template <typename ValueType>
+class XorTrie {
+ public:
+  typedef std::pair<NodeId, ValueType> value_type;
+  typedef typename std::vector<value_type>::const_iterator const_iterator;
+
+  static const size_t kMaxSize = 0x7fffffff;
+
+  XorTrie() : nodes_(), entries_(), root_(kEmpty) {}
+  ~XorTrie() = default;
+  XorTrie(const XorTrie&) = delete;
+  XorTrie(XorTrie&&) = delete;
+  XorTrie& operator=(const XorTrie&) = delete;
+  XorTrie& operator=(XorTrie&&) = delete;
+
+  // Returns false and leaves the trie unchanged if 'key' is already held.  Will throw if IsValid()
+  // is false for 'key' or if the trie already holds kMaxSize entries.
+  bool Add(const NodeId& key, ValueType value);
+
+  // Returns false if 'key' isn't held.
+  bool Delete(const NodeId& key);
+
+  bool Check(const NodeId& key) const { return Find(key) != nullptr; }
+
+  // Returns the value held for 'key', or nullptr.  The pointer is invalidated by Add or Delete.
+  const ValueType* Find(const NodeId& key) const;
+
+  // Returns the (at most) 'k' entries closest to 'target', closest first.  The pointers are
+  // invalidated by Add or Delete.  Will throw if IsValid() is false for 'target'.
+  std::vector<const value_type*> Closest(const NodeId& target, size_t k) const;
+
+  // Returns the number of keys with at least 'common_leading_bits' leading bits in common with
+  // 'target'.  Will throw if IsValid() is false for 'target' or if 'common_leading_bits' is not in
+  // the range [0, 8 * NodeId::kSize].
+  size_t CountWithinCommonLeadingBits(const NodeId& target, int common_leading_bits) const;
+
+  // Iterates over the entries in unspecified order.
+  const_iterator begin() const { return entries_.begin(); }
+  const_iterator end() const { return entries_.end(); }
+
+  size_t size() const { return entries_.size(); }
+  bool empty() const { return entries_.empty(); }
+  void clear();
+
+ private:
+  // Either the index of an internal node, or the index of an entry with kLeaf set.
+  typedef uint32_t Link;
+  static const Link kLeaf = 0x80000000;
+  static const Link kEmpty = 0xffffffff;
+
+  struct Node {
+    Link children[2];
+    // Number of entries below this node.
+    uint32_t count;
+    // The keys below this node have all bits before 'bit' in common, and are split between the
+    // children by the value of 'bit'.
+    uint32_t bit;
+  };
+
+  static bool IsLeaf(Link link) { return (link & kLeaf) != 0; }
+  static Link LeafLink(size_t entry_index) { return static_cast<Link>(entry_index) | kLeaf; }
+  static size_t EntryIndex(Link link) { return link & ~kLeaf; }
+  static int Bit(const NodeId& id, uint32_t bit) {
+    return (id.bytes()[bit / 8] >> (7 - bit % 8)) & 1;
+  }
+  static void CheckValid(const NodeId& id);
+
+  uint32_t Count(Link link) const { return IsLeaf(link) ? 1 : nodes_[link].count; }
+  // Returns the key of an arbitrary entry below 'link'.
+  const NodeId& AnyKey(Link link) const;
+  // Returns the leaf reached by following the bits of 'key' from the root.  The trie must not be
+  // empty.
+  Link Descend(const NodeId& key) const;
+  // Returns the link which currently points to 'target', found by following the bits of 'key'
+  // (which must be held below 'target').
+  Link& LinkTo(Link target, const NodeId& key);
+  void RemoveNode(Link node);
+  void RemoveEntry(size_t entry_index);
+
+  std::vector<Node> nodes_;
+  std::vector<value_type> entries_;
+  Link root_;
+};
+
+// ==================== Implementation =============================================================
+template <typename ValueType>
+const size_t XorTrie<ValueType>::kMaxSize;
+
+template <typename ValueType>
+const typename XorTrie<ValueType>::Link XorTrie<ValueType>::kLeaf;
+
+template <typename ValueType>
+const typename XorTrie<ValueType>::Link XorTrie<ValueType>::kEmpty;
+
+template <typename ValueType>
+bool XorTrie<ValueType>::Add(const NodeId& key, ValueType value) {
+  CheckValid(key);
+  if (root_ == kEmpty) {
+    entries_.emplace_back(key, std::move(value));
+    root_ = LeafLink(0);
+    return true;
+  }
+
+  const int common_leading_bits(key.CommonLeadingBits(entries_[EntryIndex(Descend(key))].first));
+  if (common_leading_bits == static_cast<int>(8 * NodeId::kSize))
+    return false;
+  if (entries_.size() >= kMaxSize) {
+    LOG(kError) << "XorTrie is full.";
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::cannot_exceed_limit));
+  }
+
+  const Link leaf(LeafLink(entries_.size()));
+  entries_.emplace_back(key, std::move(value));
+  try {
+    nodes_.push_back(Node());
+  } catch (...) {
+    entries_.pop_back();
+    throw;
+  }
+  const Link node(static_cast<Link>(nodes_.size() - 1));
+
+  // The new node goes above the first node on the path which splits on a later bit.
+  const uint32_t bit(static_cast<uint32_t>(common_leading_bits));
+  Link* link(&root_);
+  while (!IsLeaf(*link) && nodes_[*link].bit < bit) {
+    ++nodes_[*link].count;
+    link = &nodes_[*link].children[Bit(key, nodes_[*link].bit)];
+  }
+  Node& new_node(nodes_[node]);
+  const int side(Bit(key, bit));
+  new_node.children[side] = leaf;
+  new_node.children[1 - side] = *link;
+  new_node.count = Count(*link) + 1;
+  new_node.bit = bit;
+  *link = node;
+  return true;
+}
+
+template <typename ValueType>
+bool XorTrie<ValueType>::Delete(const NodeId& key) {
+  if (root_ == kEmpty)
+    return false;
+  const Link leaf(Descend(key));
+  if (!(entries_[EntryIndex(leaf)].first == key))
+    return false;
+
+  // Remove the leaf's parent, replacing it with the leaf's sibling.
+  if (root_ == leaf) {
+    root_ = kEmpty;
+  } else {
+    Link* parent(&root_);
+    for (;;) {
+      Node& node(nodes_[*parent]);
+      --node.count;
+      const int side(Bit(key, node.bit));
+      if (node.children[side] == leaf) {
+        const Link removed(*parent);
+        *parent = node.children[1 - side];
+        RemoveNode(removed);
+        break;
+      }
+      parent = &node.children[side];
+    }
+  }
+  RemoveEntry(EntryIndex(leaf));
+  return true;
+}
+
+template <typename ValueType>
+const ValueType* XorTrie<ValueType>::Find(const NodeId& key) const {
+  if (root_ == kEmpty)
+    return nullptr;
+  const value_type& entry(entries_[EntryIndex(Descend(key))]);
+  return entry.first == key ? &entry.second : nullptr;
+}
+
+template <typename ValueType>
+std::vector<const typename XorTrie<ValueType>::value_type*> XorTrie<ValueType>::Closest(
+    const NodeId& target, size_t k) const {
+  CheckValid(target);
+  std::vector<const value_type*> closest;
+  if (root_ == kEmpty || k == 0)
+    return closest;
+  closest.reserve(std::min(k, entries_.size()));
+  // Depth-first, visiting the child on the target's side of each split first.
+  std::vector<Link> pending(1, root_);
+  while (!pending.empty() && closest.size() < k) {
+    const Link link(pending.back());
+    pending.pop_back();
+    if (IsLeaf(link)) {
+      closest.push_back(&entries_[EntryIndex(link)]);
+    } else {
+      const Node& node(nodes_[link]);
+      const int side(Bit(target, node.bit));
+      pending.push_back(node.children[1 - side]);
+      pending.push_back(node.children[side]);
+    }
+  }
+  return closest;
+}
+
+template <typename ValueType>
+size_t XorTrie<ValueType>::CountWithinCommonLeadingBits(const NodeId& target,
+                                                        int common_leading_bits) const {
+  CheckValid(target);
+  if (common_leading_bits < 0 || common_leading_bits > static_cast<int>(8 * NodeId::kSize)) {
+    LOG(kError) << "Invalid number of common leading bits: " << common_leading_bits;
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::invalid_parameter));
+  }
+  if (root_ == kEmpty)
+    return 0;
+  // Find the highest subtree whose keys all have the first 'common_leading_bits' bits in common,
+  // then check whether those match the target's.
+  const uint32_t bit(static_cast<uint32_t>(common_leading_bits));
+  Link link(root_);
+  while (!IsLeaf(link) && nodes_[link].bit < bit)
+    link = nodes_[link].children[Bit(target, nodes_[link].bit)];
+  return AnyKey(link).CommonLeadingBits(target) >= common_leading_bits ? Count(link) : 0;
+}
+
+template <typename ValueType>
+void XorTrie<ValueType>::clear() {
+  nodes_.clear();
+  entries_.clear();
+  root_ = kEmpty;
+}
+
+template <typename ValueType>
+void XorTrie<ValueType>::CheckValid(const NodeId& id) {
+#ifndef USE_DEPRECATED_NODE_ID_BEHAVIOUR
+  if (!id.IsValid()) {
+    LOG(kError) << "Invalid NodeId.";
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::invalid_node_id));
+  }
+#else
+  static_cast<void>(id);
+#endif
+}
+
+template <typename ValueType>
+const NodeId& XorTrie<ValueType>::AnyKey(Link link) const {
+  while (!IsLeaf(link))
+    link = nodes_[link].children[0];
+  return entries_[EntryIndex(link)].first;
+}
+
+template <typename ValueType>
+typename XorTrie<ValueType>::Link XorTrie<ValueType>::Descend(const NodeId& key) const {
+  Link link(root_);
+  while (!IsLeaf(link))
+    link = nodes_[link].children[Bit(key, nodes_[link].bit)];
+  return link;
+}
+
+template <typename ValueType>
+typename XorTrie<ValueType>::Link& XorTrie<ValueType>::LinkTo(Link target, const NodeId& key) {
+  Link* link(&root_);
+  while (*link != target)
+    link = &nodes_[*link].children[Bit(key, nodes_[*link].bit)];
+  return *link;
+}
+
+template <typename ValueType>
+void XorTrie<ValueType>::RemoveNode(Link node) {
+  const Link last(static_cast<Link>(nodes_.size() - 1));
+  if (node != last) {
+    LinkTo(last, AnyKey(last)) = node;
+    nodes_[node] = nodes_[last];
+  }
+  nodes_.pop_back();
+}
+
+template <typename ValueType>
+void XorTrie<ValueType>::RemoveEntry(size_t entry_index) {
+  const size_t last(entries_.size() - 1);
+  if (entry_index != last) {
+    LinkTo(LeafLink(last), entries_[last].first) = LeafLink(entry_index);
+    entries_[entry_index] = std::move(entries_[last]);
+  }
+  entries_.pop_back();
+}
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_COMMON_CONTAINERS_XOR_TRIE_H_
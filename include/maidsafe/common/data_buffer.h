@@ -19,26 +19,36 @@
 #ifndef MAIDSAFE_COMMON_DATA_BUFFER_H_
 #define MAIDSAFE_COMMON_DATA_BUFFER_H_
 
+#include <algorithm>
 #include <atomic>
 #include <condition_variable>
 #include <chrono>
 #include <cstdint>
-#include <deque>
 #include <functional>
 #include <future>
-#include <map>
+#include <list>
+#include <memory>
 #include <mutex>
 #include <string>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "boost/filesystem/convenience.hpp"
 #include "boost/filesystem/path.hpp"
 #include "boost/variant.hpp"
 
+#include "maidsafe/common/asio_service.h"
+#include "maidsafe/common/crypto.h"
+#include "maidsafe/common/latency_histogram.h"
 #include "maidsafe/common/log.h"
+#include "maidsafe/common/on_scope_exit.h"
+#include "maidsafe/common/segment_store.h"
 #include "maidsafe/common/tagged_value.h"
 #include "maidsafe/common/types.h"
 #include "maidsafe/common/utils.h"
+#include "maidsafe/common/containers/flat_hash_map.h"
+#include "maidsafe/common/containers/frequency_sketch.h"
 #include "maidsafe/common/data_types/data_name_variant.h"
 #include "maidsafe/common/data_types/data_type_values.h"
 
@@ -54,6 +64,143 @@ inline std::string HexSubstr(const std::pair<std::string, std::string>& input) {
   return HexSubstr(input.first + input.second);
 }
 
+// Selects how DataBuffer holds values on disk: either one file per value, or appended to large
+// segment files (see SegmentStore) which avoids a create and unlink per value.
+enum class DiskBackend { kFilePerValue, kSegmentFiles };
+
+// Selects what DataBuffer does with values already held in its disk folder when it's constructed
+// (e.g. after a restart with should_remove_root false).  kNone ignores them (removing any segment
+// files), while kRecover rebuilds the disk index from them so they can be retrieved, deleted or
+// popped as before, and counts them against the max disk usage.  Values which were only held in
+// memory when the previous DataBuffer was destroyed are not recovered.
+enum class DiskRecovery { kNone, kRecover };
+
+// Selects whether DataBuffer compresses values as it moves them to disk.  With kGzip, a sample of
+// each value is compressed first, and the value is only held compressed if that saves a worthwhile
+// amount of space.  Disk usage is then measured in the bytes actually held on disk.  A folder must
+// be recovered with the same DiskCompression as it was written with.
+enum class DiskCompression { kNone, kGzip };
+
+// Selects what DataBuffer::Get does with values found only on disk.  kNone leaves them on disk.
+// kLru copies them back into memory, evicting the least recently used values which are already on
+// disk to make room; memory hits also refresh a value's recency.  kTinyLfu does the same, but only
+// admits a value if it has been requested more often recently than every value it would evict, so
+// a one-off scan over many cold values can't flush the memory tier.
+enum class ReadPromotion { kNone, kLru, kTinyLfu };
+
+// Counts of how DataBuffer::Get requests were satisfied.
+struct DataBufferHitStatistics {
+  DataBufferHitStatistics()
+      : memory_hits(0), disk_hits(0), misses(0), promotions(0), rejected_promotions(0) {}
+  uint64_t memory_hits, disk_hits, misses, promotions, rejected_promotions;
+};
+
+// A snapshot of DataBuffer's counters, as returned by DataBuffer::GetStatistics.
+struct DataBufferStatistics {
+  DataBufferStatistics()
+      : hits(),
+        memory_bytes(0),
+        memory_values(0),
+        disk_bytes(0),
+        disk_values(0),
+        spill_queue_bytes(0),
+        spill_queue_values(0),
+        pops(0),
+        memory_wait_time(0),
+        disk_wait_time(0),
+        disk_write_latency(),
+        disk_read_latency() {}
+  DataBufferHitStatistics hits;
+  // Space used in, and number of values held in, each tier.  Values in memory may also be held on
+  // disk, and the disk figures include values which are still being written.
+  uint64_t memory_bytes, memory_values, disk_bytes, disk_values;
+  // Values in memory which haven't yet started to be copied to disk.
+  uint64_t spill_queue_bytes, spill_queue_values;
+  // Values removed from disk and passed to the pop_functor to make space.
+  uint64_t pops;
+  // Total time spent blocked waiting for space in each tier.
+  std::chrono::microseconds memory_wait_time, disk_wait_time;
+  // Durations of individual (or batched) disk writes and of disk reads.
+  LatencyHistogram::Snapshot disk_write_latency, disk_read_latency;
+};
+
+namespace detail {
+
+// Hash functor used by DataBuffer to index its keys.  Defaults to std::hash<Key>; specialise this
+// for any key type which has no std::hash specialisation.
+template <typename Key>
+struct DataBufferKeyHash {
+  size_t operator()(const Key& key) const { return std::hash<Key>()(key); }
+};
+
+template <typename First, typename Second>
+struct DataBufferKeyHash<std::pair<First, Second>> {
+  size_t operator()(const std::pair<First, Second>& key) const {
+    size_t seed(DataBufferKeyHash<First>()(key.first));
+    return seed ^ (DataBufferKeyHash<Second>()(key.second) + 0x9e3779b9 + (seed << 6) +
+                   (seed >> 2));
+  }
+};
+
+template <>
+struct DataBufferKeyHash<DataNameVariant> {
+  size_t operator()(const DataNameVariant& key) const {
+    auto result(boost::apply_visitor(GetTagValueAndIdentityVisitor(), key));
+    return std::hash<std::string>()(result.second.string()) ^
+           static_cast<size_t>(result.first);
+  }
+};
+
+// Recovers a key from the name DataBuffer gave its value on disk.  Pair keys are held under the
+// concatenation of their two halves, so they (and any other key types without a specialisation
+// here) can't be recovered.
+template <typename Key>
+struct DataBufferKeyFromFilename {
+  static const bool kRecoverable = false;
+  Key operator()(const std::string& /*filename*/) const {
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::invalid_conversion));
+  }
+};
+
+template <>
+struct DataBufferKeyFromFilename<std::string> {
+  static const bool kRecoverable = true;
+  std::string operator()(const std::string& filename) const {
+    std::string key(HexDecode(filename));
+    if (HexEncode(key) != filename)
+      BOOST_THROW_EXCEPTION(MakeError(CommonErrors::invalid_conversion));
+    return key;
+  }
+};
+
+template <>
+struct DataBufferKeyFromFilename<DataNameVariant> {
+  static const bool kRecoverable = true;
+  DataNameVariant operator()(const std::string& filename) const {
+    DataNameVariant key(GetDataNameVariant(filename));
+    if (GetFileName(key).string() != filename)
+      BOOST_THROW_EXCEPTION(MakeError(CommonErrors::invalid_conversion));
+    return key;
+  }
+};
+
+typedef std::pair<boost::filesystem::path, std::reference_wrapper<const std::string>>
+    NamedContent;
+
+// Writes each content to a temporary file beside its path, syncs it to disk and then renames it to
+// its path, finally syncing the (shared) parent folder.  A crash or power loss part way through
+// therefore can't leave a partially written value to be recovered.  All of 'files' must be in the
+// same folder.
+bool WriteFilesAtomically(const std::vector<NamedContent>& files);
+
+// Returns the name and size of every regular file in 'disk_buffer', oldest first.  The files'
+// sizes and modification times are read in parallel.  Temporary files left by WriteFilesAtomically
+// are removed.
+std::vector<std::pair<std::string, uint64_t>> ScanDiskBuffer(
+    const boost::filesystem::path& disk_buffer);
+
+}  // namespace detail
+
 namespace test {
 
 class DataBufferTest;
@@ -66,37 +213,95 @@ class DataBuffer {
  public:
   typedef Key KeyType;
   typedef std::function<void(const KeyType&, const NonEmptyString&)> PopFunctor;
-  // Throws if max_memory_usage >= max_disk_usage.  Throws if a writable folder can't be created in
-  // temp_directory_path().  Starts a background worker thread which copies values from memory to
-  // disk.  If pop_functor is valid, the disk cache will pop excess items when it is full,
-  // otherwise Store will block until there is space made via Delete calls.
-  DataBuffer(MemoryUsage max_memory_usage, DiskUsage max_disk_usage, PopFunctor pop_functor);
-  // Throws if max_memory_usage >= max_disk_usage.  Throws if a writable folder can't be created in
-  // "disk_buffer".  Starts a background worker thread which copies values from memory to disk.  If
-  // pop_functor is valid, the disk cache will pop excess items when it is full, otherwise Store
-  // will block until there is space made via Delete calls.
+  // Values are held in memory as shared, immutable strings, so they can be handed out by GetShared
+  // without being copied.
+  typedef std::shared_ptr<const NonEmptyString> SharedValue;
+  // Throws if max_memory_usage > max_disk_usage (or if it's non-zero and not less than
+  // max_disk_usage when compressing), or if disk_writer_count is 0.  Throws if a writable folder
+  // can't be created in temp_directory_path().  Starts disk_writer_count background worker threads
+  // which copy values from memory to disk.  If pop_functor is valid, the disk cache will pop excess
+  // items when it is full, otherwise Store will block until there is space made via Delete calls.
   DataBuffer(MemoryUsage max_memory_usage, DiskUsage max_disk_usage, PopFunctor pop_functor,
-             const boost::filesystem::path& disk_buffer, bool should_remove_root = false);
+             DiskBackend disk_backend = DiskBackend::kFilePerValue,
+             DiskCompression disk_compression = DiskCompression::kNone,
+             uint32_t disk_writer_count = 1);
+  // Throws if max_memory_usage > max_disk_usage (or if it's non-zero and not less than
+  // max_disk_usage when compressing), or if disk_writer_count is 0.  Throws if a writable folder
+  // can't be created in "disk_buffer".  Throws if disk_recovery is kRecover and KeyType can't be
+  // recovered from the values' filenames (e.g. pair keys).  Starts disk_writer_count background
+  // worker threads which copy values from memory to disk.  If pop_functor is valid, the disk cache
+  // will pop excess items when it is full, otherwise Store will block until there is space made via
+  // Delete calls.
+  DataBuffer(MemoryUsage max_memory_usage, DiskUsage max_disk_usage, PopFunctor pop_functor,
+             const boost::filesystem::path& disk_buffer, bool should_remove_root = false,
+             DiskBackend disk_backend = DiskBackend::kFilePerValue,
+             DiskRecovery disk_recovery = DiskRecovery::kNone,
+             DiskCompression disk_compression = DiskCompression::kNone,
+             uint32_t disk_writer_count = 1);
   ~DataBuffer();
-  // Throws if the background worker has thrown (e.g. the disk has become inaccessible).  Throws if
-  // the size of value is greater than the current specified maximum disk usage, or if the value
-  // can't be written to disk (e.g. value is not initialised).  If there is not enough space to
-  // store to memory, blocks until there is enough space to store to disk.  Space will be made
-  // available via external calls to Delete, and also automatically if pop_functor_ is not NULL.
+  // Throws if the background worker has thrown (e.g. the disk has become inaccessible).  Throws
+  // without changing the buffer if the size of value (plus one byte when compressing) is greater
+  // than the current specified maximum disk usage, or if the value can't be written to disk (e.g.
+  // value is not initialised).  If there is not enough space to store to memory, blocks until there
+  // is enough space to store to disk.  Space will be made available via external calls to Delete,
+  // and also automatically if pop_functor_ is not NULL.
   void Store(const KeyType& key, const NonEmptyString& value);
+  // As above, but takes ownership of 'value' rather than copying it.
+  void Store(const KeyType& key, NonEmptyString&& value);
+  // As above, but shares 'value' rather than copying it.  Throws if 'value' is null.
+  void Store(const KeyType& key, SharedValue value);
   // Throws if the background worker has thrown (e.g. the disk has become inaccessible).  Throws if
   // the value can't be read from disk.  If the value isn't in memory and has started to be stored
   // to disk, blocks briefly while waiting for the storing to complete.
   NonEmptyString Get(const KeyType& key);
+  // As for Get, but if the value is held in memory a reference to it is returned rather than a
+  // copy.  The returned value remains valid even if it is subsequently deleted from the buffer.
+  SharedValue GetShared(const KeyType& key);
+  // As for Store, except that rather than blocking indefinitely for space to become available,
+  // returns false if there's still no space at 'deadline', in which case any existing value held
+  // under 'key' is left in place.  The space held by that existing value counts as available.  A
+  // value too large for memory is written straight to disk once its disk space has been reserved,
+  // so blocks past 'deadline' only for the write itself.
+  bool TryStore(const KeyType& key, const NonEmptyString& value,
+                std::chrono::steady_clock::time_point deadline);
+  bool TryStore(const KeyType& key, SharedValue value,
+                std::chrono::steady_clock::time_point deadline);
+  // Stores the value in memory immediately if that can be done without blocking, otherwise runs
+  // Store on one of 'asio_service''s threads (as always happens for values too large for memory).
+  // The returned future becomes ready once the value is stored, or holds the exception which Store
+  // threw.  This DataBuffer must outlive the operation.
+  std::future<void> AsyncStore(AsioService& asio_service, const KeyType& key, SharedValue value);
+  // Returns a ready future if the value is held in memory, otherwise reads it from disk on one of
+  // 'asio_service''s threads.  The future holds the exception which Get would have thrown, if any.
+  // This DataBuffer must outlive the operation.
+  std::future<SharedValue> AsyncGet(AsioService& asio_service, const KeyType& key);
   // Throws if the background worker has thrown (e.g. the disk has become inaccessible).  Throws if
-  // the value was written to disk and can't be removed.
+  // the value was written to disk and can't be removed.  If the value is part way through being
+  // written to disk, blocks until the write has finished and been removed again.
   void Delete(const KeyType& key);
   // Delete based on a predicate, allows pairs etc. to be used as key
   void Delete(std::function<bool(const KeyType&)> predicate);
-  // Throws if max_memory_usage > max_disk_usage_.
+  // Equivalent to calling Store for each element, except that each lock is taken once for the
+  // whole batch and memory is reserved for as many of the values at a time as will fit.  If a key
+  // appears more than once, only its last value is stored.  Throws if any value is null.
+  void StoreBatch(std::vector<std::pair<KeyType, NonEmptyString>> elements);
+  void StoreBatch(std::vector<std::pair<KeyType, SharedValue>> elements);
+  // Returns the values in the same order as 'keys'.  The entry for any key which isn't held is
+  // null.  Throws if the background worker has thrown, or if a value can't be read from disk.
+  std::vector<SharedValue> GetBatch(const std::vector<KeyType>& keys);
+  // Deletes all of 'keys' which are held.  Throws if any weren't held, after deleting the rest.
+  void DeleteBatch(const std::vector<KeyType>& keys);
+  // Throws if max_memory_usage > max_disk_usage_ (see the constructors).
   void SetMaxMemoryUsage(MemoryUsage max_memory_usage);
-  // Throws if max_memory_usage_ > max_disk_usage.
+  // Throws if max_memory_usage_ > max_disk_usage (see the constructors).  A value held in memory
+  // which no longer fits on disk is dropped when it would have been copied there.
   void SetMaxDiskUsage(DiskUsage max_disk_usage);
+  // Defaults to ReadPromotion::kNone.
+  void SetReadPromotion(ReadPromotion read_promotion);
+  DataBufferHitStatistics GetHitStatistics() const;
+  // The counters are maintained with relaxed atomic operations, so are always enabled.  Taking the
+  // snapshot briefly locks each tier, and walks the values waiting to be copied to disk.
+  DataBufferStatistics GetStatistics();
 
   friend class test::DataBufferTest;
   friend class test::DataStoreTest;
@@ -106,17 +311,38 @@ class DataBuffer {
   DataBuffer(DataBuffer&&);
   DataBuffer& operator=(DataBuffer);
 
+  typedef detail::DataBufferKeyHash<KeyType> KeyHash;
+  typedef std::vector<std::pair<KeyType, SharedValue>> Batch;
+
+  // Upper limit on the total size of values which the disk workers take from memory at once.  With
+  // several workers, each takes an equal share of this so that a burst is spread between them.
+  static const uint64_t kMaxDiskBatchSize;
+  // With compression enabled, each value on disk is prefixed by one of these markers.  Values
+  // smaller than kMinCompressibleSize are never compressed, and for larger ones the first
+  // kCompressionSampleSize bytes are compressed first to check the value is worth compressing.
+  static const char kUncompressedMarker, kCompressedMarker;
+  static const uint64_t kMinCompressibleSize, kCompressionSampleSize;
+  static const uint16_t kCompressionLevel;
+
+  // 'index' holds the elements in FIFO order, while 'lookup' maps each key to its element(s) in
+  // 'index'.  A key can briefly appear more than once (e.g. concurrent Store calls for the same
+  // key), in which case the element with the lowest 'sequence' is the oldest.
   template <typename UsageType, typename IndexType>
   struct Storage {
     typedef IndexType index_type;
+    typedef std::unordered_multimap<KeyType, typename IndexType::iterator, KeyHash> lookup_type;
     explicit Storage(UsageType max_in)
         : max(std::move(max_in)),  // NOLINT
           current(0),
           index(),
+          lookup(),
+          next_sequence(0),
           mutex(),
           cond_var() {}
     UsageType max, current;
     IndexType index;
+    lookup_type lookup;
+    uint64_t next_sequence;
     std::mutex mutex;
     std::condition_variable cond_var;
   };
@@ -124,39 +350,112 @@ class DataBuffer {
   enum class StoringState { kNotStarted, kStarted, kCancelled, kCompleted };
 
   struct MemoryElement {
-    MemoryElement(KeyType key_in, NonEmptyString value_in)
+    MemoryElement(KeyType key_in, SharedValue value_in)
         : key(std::move(key_in)),
           value(std::move(value_in)),
-          also_on_disk(StoringState::kNotStarted) {}
+          also_on_disk(StoringState::kNotStarted),
+          sequence(0),
+          promoted(false),
+          disk_sequence(0) {}
     KeyType key;
-    NonEmptyString value;
+    SharedValue value;
     StoringState also_on_disk;
+    uint64_t sequence;
+    // Set if this element was copied back into memory by Get, in which case 'disk_sequence' is the
+    // sequence of the disk element it was read from.
+    bool promoted;
+    uint64_t disk_sequence;
   };
 
-  typedef std::deque<MemoryElement> MemoryIndex;
+  typedef std::list<MemoryElement> MemoryIndex;
 
   struct DiskElement {
-    explicit DiskElement(KeyType key_in) : key(std::move(key_in)), state(StoringState::kStarted) {}
+    explicit DiskElement(KeyType key_in)
+        : key(std::move(key_in)), state(StoringState::kStarted), sequence(0) {}
     KeyType key;
     StoringState state;
+    uint64_t sequence;
   };
-  typedef std::deque<DiskElement> DiskIndex;
-
-  void Init();
-
-  std::unique_lock<std::mutex> StoreInMemory(const KeyType& key, const NonEmptyString& value);
-  void WaitForSpaceInMemory(uint64_t required_space,
-                            std::unique_lock<std::mutex>& memory_store_lock);
-  void StoreOnDisk(const KeyType& key, const NonEmptyString& value,
+  typedef std::list<DiskElement> DiskIndex;
+
+  void Init(DiskRecovery disk_recovery);
+  // Adds a completed disk element for every value found in 'kDiskBuffer_', oldest first.
+  void RecoverDiskIndex();
+
+  typedef std::chrono::steady_clock::time_point TimePoint;
+
+  // Waits on 'cond_var' until 'predicate' is true, or until 'deadline' unless that is
+  // TimePoint::max().  Returns the final value of 'predicate'.
+  template <typename Predicate>
+  static bool WaitUntil(std::condition_variable& cond_var, std::unique_lock<std::mutex>& lock,
+                        TimePoint deadline, Predicate predicate);
+  static void AddElapsedTime(std::atomic<uint64_t>& total_microseconds, TimePoint start);
+
+  std::unique_lock<std::mutex> StoreInMemory(const KeyType& key, const SharedValue& value);
+  // Returns false if there is still not enough space at 'deadline'.
+  bool WaitForSpaceInMemory(uint64_t required_space,
+                            std::unique_lock<std::mutex>& memory_store_lock,
+                            TimePoint deadline = TimePoint::max());
+  // Removes any existing value held under 'key' while 'memory_store_lock' is held.
+  void ReplaceExisting(const KeyType& key, std::unique_lock<std::mutex>& memory_store_lock);
+  // The TryStore paths for values which fit in memory and for those which don't.
+  bool TryStoreInMemory(const KeyType& key, const SharedValue& value,
+                        std::unique_lock<std::mutex>& memory_store_lock, TimePoint deadline);
+  bool TryStoreOnDisk(const KeyType& key, const SharedValue& value, TimePoint deadline);
+  // Adds 'required_space' to the disk usage once it's available, popping values if there's a
+  // pop_functor.  Returns false if there is still not enough space at 'deadline'.
+  bool ReserveSpaceOnDisk(uint64_t required_space, std::unique_lock<std::mutex>& disk_store_lock,
+                          TimePoint deadline);
+  void StoreOnDisk(const KeyType& key, const SharedValue& value,
                    std::unique_lock<std::mutex>&& disk_store_lock);
-  void WaitForSpaceOnDisk(const KeyType& key, const NonEmptyString* const value,
+  void StoreBatchOnDisk(Batch batch, std::unique_lock<std::mutex>&& disk_store_lock);
+  // Writes 'batch', whose elements are in the disk index under 'sequences' and whose space has
+  // already been reserved, with 'disk_store_lock' released for the duration of the write.  Any
+  // element deleted meanwhile is removed from disk again afterwards.
+  void WriteUnlocked(const Batch& batch, const std::vector<uint64_t>& sequences,
+                     std::unique_lock<std::mutex>& disk_store_lock);
+  // Throws if 'value' can never fit on disk.  Must be called with the disk store's mutex locked.
+  void CheckFitsOnDisk(const KeyType& key, const SharedValue& value);
+  // The most space 'value' can take on disk once encoded.
+  uint64_t MaxDiskSize(const SharedValue& value) const;
+  // Whether every value small enough for memory also fits on disk once encoded.
+  bool MemoryFitsOnDisk(uint64_t max_memory_usage, uint64_t max_disk_usage) const;
+  // Returns 'value' as it should be written to disk, i.e. unchanged if compression is disabled.
+  SharedValue EncodeForDisk(const SharedValue& value) const;
+  NonEmptyString DecodeFromDisk(const NonEmptyString& stored) const;
+  // Writes a value whose element has already been added to the disk index.
+  void FinishStoringOnDisk(const KeyType& key, uint64_t sequence, const SharedValue& value,
+                           std::unique_lock<std::mutex>& disk_store_lock);
+  // Also waits for any other value under 'key' which is being written to finish, since both would
+  // be written to the same file.
+  void WaitForSpaceOnDisk(const KeyType& key, uint64_t sequence, const SharedValue& value,
                           std::unique_lock<std::mutex>& disk_store_lock, bool& cancelled);
+  // Removes the value at 'itr' from disk and passes it to the pop_functor.
+  void PopFromDisk(typename DiskIndex::iterator itr);
   void DeleteFromMemory(const KeyType& key, StoringState& also_on_disk);
-  void DeleteFromDisk(const KeyType& key);
-  void RemoveFile(const KeyType& key, NonEmptyString* value);
+  // Returns the sequence of the removed disk element.
+  uint64_t DeleteFromDisk(const KeyType& key);
+  void RemoveDiskElement(typename DiskIndex::iterator itr);
+  // Returns the number of keys which weren't held.
+  size_t DeleteKeys(const std::vector<KeyType>& keys);
+  void DeletePromotedCopy(const KeyType& key, uint64_t disk_sequence);
+  bool ErasePromotedCopy(const KeyType& key, uint64_t disk_sequence);
+  // Returns null if 'key' isn't held in memory.  Requires 'memory_store_.mutex' to be held.
+  SharedValue GetFromMemory(const KeyType& key);
+  // Returns null if 'key' isn't held on disk.
+  SharedValue GetFromDisk(const KeyType& key);
+  void MarkRecentlyUsed(typename MemoryIndex::iterator itr);
+  void PromoteToMemory(const KeyType& key, const SharedValue& value, uint64_t disk_sequence);
+  bool MakeSpaceForPromotion(const KeyType& key, uint64_t required_space);
+  bool WriteToDisk(const KeyType& key, const NonEmptyString& value);
+  bool WriteBatchToDisk(const Batch& batch);
+  NonEmptyString ReadFromDisk(const KeyType& key);
+  void RemoveFromDisk(const KeyType& key, NonEmptyString* value);
 
   void CopyQueueToDisk();
   void CheckWorkerIsStillRunning();
+  // Waits for every worker which hasn't yet been waited for, rethrowing the first exception.
+  void GetWorkerResults();
   void StopRunning();
   boost::filesystem::path GetFilename(const KeyType& key) const;
 
@@ -165,15 +464,29 @@ class DataBuffer {
 
   template <typename T>
   typename T::index_type::iterator Find(T& store, const KeyType& key);
+  template <typename T>
+  typename T::index_type::iterator Find(T& store, const KeyType& key, uint64_t sequence);
+
+  template <typename T, typename... Args>
+  typename T::index_type::iterator Emplace(T& store,
+                                           typename T::index_type::const_iterator position,
+                                           Args&&... args);
+
+  template <typename T>
+  void Erase(T& store, typename T::index_type::iterator itr);
+
+  void EraseFromMemory(typename MemoryIndex::iterator itr);
 
   typename MemoryIndex::iterator FindOldestInMemoryOnly();
   typename MemoryIndex::iterator FindMemoryRemovalCandidate(
-      uint64_t required_space, std::unique_lock<std::mutex>& memory_store_lock);
+      uint64_t required_space, std::unique_lock<std::mutex>& memory_store_lock,
+      TimePoint deadline);
 
-  typename DiskIndex::iterator FindStartedToStoreOnDisk(const KeyType& key);
+  typename DiskIndex::iterator FindOnDisk(const KeyType& key, uint64_t sequence);
+  // Returns the oldest element which has been stored, or end().
   typename DiskIndex::iterator FindOldestOnDisk();
 
-  typename DiskIndex::iterator FindAndThrowIfCancelled(const KeyType& key);
+  typename DiskIndex::iterator FindIfNotCancelled(const KeyType& key);
 
   std::string DebugKeyName(const KeyType& key);
 
@@ -182,41 +495,98 @@ class DataBuffer {
   const PopFunctor kPopFunctor_;
   const boost::filesystem::path kDiskBuffer_;
   const bool kShouldRemoveRoot_;
-  std::map<KeyType, const NonEmptyString*> elements_being_moved_to_disk_{};
+  const DiskBackend kDiskBackend_;
+  const DiskCompression kDiskCompression_;
+  const uint32_t kDiskWriterCount_;
+  std::unique_ptr<SegmentStore> segment_store_;
+  // All elements in 'memory_store_.index' from this point onwards are kNotStarted, and all before
+  // it are either kStarted or kCompleted.
+  typename MemoryIndex::iterator oldest_in_memory_only_;
+  FlatHashMap<KeyType, SharedValue, KeyHash> elements_being_moved_to_disk_{};
+  // Keys whose values are being written by a worker without 'disk_store_.mutex' held.  Guarded by
+  // 'disk_store_.mutex'.
+  FlatHashSet<KeyType, KeyHash> keys_being_written_{};
+  // These are guarded by 'memory_store_.mutex'.
+  ReadPromotion read_promotion_{ReadPromotion::kNone};
+  std::unique_ptr<FrequencySketch<KeyType, KeyHash>> frequency_sketch_{};
+  std::atomic<uint64_t> memory_hits_{0}, disk_hits_{0}, misses_{0}, promotions_{0},
+      rejected_promotions_{0};
+  std::atomic<uint64_t> pops_{0}, memory_wait_microseconds_{0}, disk_wait_microseconds_{0};
+  LatencyHistogram disk_write_latency_{}, disk_read_latency_{};
   std::atomic<bool> running_{true};
   std::mutex worker_mutex_{};
-  std::future<void> worker_{};
+  std::vector<std::future<void>> workers_{};
 };
 
 // ==================== Implementation =============================================================
+template <typename Key>
+const uint64_t DataBuffer<Key>::kMaxDiskBatchSize(4 * 1024 * 1024);
+
+template <typename Key>
+const char DataBuffer<Key>::kUncompressedMarker('U');
+
+template <typename Key>
+const char DataBuffer<Key>::kCompressedMarker('C');
+
+template <typename Key>
+const uint64_t DataBuffer<Key>::kMinCompressibleSize(256);
+
+template <typename Key>
+const uint64_t DataBuffer<Key>::kCompressionSampleSize(4096);
+
+template <typename Key>
+const uint16_t DataBuffer<Key>::kCompressionLevel(1);
+
 template <typename Key>
 DataBuffer<Key>::DataBuffer(MemoryUsage max_memory_usage, DiskUsage max_disk_usage,
-                            PopFunctor pop_functor)
+                            PopFunctor pop_functor, DiskBackend disk_backend,
+                            DiskCompression disk_compression, uint32_t disk_writer_count)
     : memory_store_(max_memory_usage),
       disk_store_(max_disk_usage),
       kPopFunctor_(std::move(pop_functor)),
       kDiskBuffer_(boost::filesystem::unique_path(boost::filesystem::temp_directory_path() /
                                                   "DB-%%%%-%%%%-%%%%-%%%%")),
-      kShouldRemoveRoot_(true) {
-  Init();
+      kShouldRemoveRoot_(true),
+      kDiskBackend_(disk_backend),
+      kDiskCompression_(disk_compression),
+      kDiskWriterCount_(disk_writer_count),
+      segment_store_(),
+      oldest_in_memory_only_(memory_store_.index.end()) {
+  Init(DiskRecovery::kNone);
 }
 
 template <typename Key>
 DataBuffer<Key>::DataBuffer(MemoryUsage max_memory_usage, DiskUsage max_disk_usage,
                             PopFunctor pop_functor, const boost::filesystem::path& disk_buffer,
-                            bool should_remove_root)
+                            bool should_remove_root, DiskBackend disk_backend,
+                            DiskRecovery disk_recovery, DiskCompression disk_compression,
+                            uint32_t disk_writer_count)
     : memory_store_(max_memory_usage),
       disk_store_(max_disk_usage),
       kPopFunctor_(std::move(pop_functor)),
       kDiskBuffer_(disk_buffer),
-      kShouldRemoveRoot_(should_remove_root) {
-  Init();
+      kShouldRemoveRoot_(should_remove_root),
+      kDiskBackend_(disk_backend),
+      kDiskCompression_(disk_compression),
+      kDiskWriterCount_(disk_writer_count),
+      segment_store_(),
+      oldest_in_memory_only_(memory_store_.index.end()) {
+  Init(disk_recovery);
 }
 
 template <typename Key>
-void DataBuffer<Key>::Init() {
-  if (memory_store_.max > disk_store_.max) {
-    LOG(kError) << "Max memory usage must be < max disk usage.";
+void DataBuffer<Key>::Init(DiskRecovery disk_recovery) {
+  if (!MemoryFitsOnDisk(memory_store_.max.data, disk_store_.max.data)) {
+    LOG(kError) << "Max memory usage must be <= max disk usage, or < if compressing.";
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::invalid_parameter));
+  }
+  if (kDiskWriterCount_ == 0) {
+    LOG(kError) << "There must be at least one disk writer.";
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::invalid_parameter));
+  }
+  if (disk_recovery == DiskRecovery::kRecover &&
+      !detail::DataBufferKeyFromFilename<KeyType>::kRecoverable) {
+    LOG(kError) << "Keys of this type can't be recovered from disk.";
     BOOST_THROW_EXCEPTION(MakeError(CommonErrors::invalid_parameter));
   }
   boost::system::error_code error_code;
@@ -235,7 +605,37 @@ void DataBuffer<Key>::Init() {
     return;
   }
   boost::filesystem::remove(test_file);
-  worker_ = std::async(std::launch::async, &DataBuffer<KeyType>::CopyQueueToDisk, this);
+  if (kDiskBackend_ == DiskBackend::kSegmentFiles) {
+    segment_store_.reset(new SegmentStore(kDiskBuffer_,
+                                          SegmentStore::SegmentSizeFor(disk_store_.max.data),
+                                          disk_recovery == DiskRecovery::kRecover));
+  }
+  if (disk_recovery == DiskRecovery::kRecover)
+    RecoverDiskIndex();
+  for (uint32_t i(0); i != kDiskWriterCount_; ++i)
+    workers_.push_back(std::async(std::launch::async, &DataBuffer<KeyType>::CopyQueueToDisk, this));
+}
+
+template <typename Key>
+void DataBuffer<Key>::RecoverDiskIndex() {
+  std::vector<std::pair<std::string, uint64_t>> contents(
+      segment_store_ ? segment_store_->Contents() : detail::ScanDiskBuffer(kDiskBuffer_));
+  detail::DataBufferKeyFromFilename<KeyType> key_from_filename;
+  for (const auto& entry : contents) {
+    try {
+      auto itr(Emplace(disk_store_, disk_store_.index.end(), key_from_filename(entry.first)));
+      (*itr).state = StoringState::kCompleted;
+      disk_store_.current.data += entry.second;
+    } catch (const std::exception&) {
+      LOG(kWarning) << "Ignoring " << kDiskBuffer_ / entry.first << " which isn't a stored value.";
+    }
+  }
+  LOG(kInfo) << "Recovered " << disk_store_.index.size() << " values ("
+             << disk_store_.current.data << " bytes) from " << kDiskBuffer_;
+  if (disk_store_.current > disk_store_.max) {
+    LOG(kWarning) << "Recovered values exceed max disk usage of " << disk_store_.max.data
+                  << " bytes; Store will pop or wait for Delete calls until there is space.";
+  }
 }
 
 template <typename Key>
@@ -250,23 +650,26 @@ DataBuffer<Key>::~DataBuffer() {
   }
   {
     std::unique_lock<std::mutex> worker_lock(worker_mutex_);
-    while (worker_.valid() &&
-           worker_.wait_for(std::chrono::seconds(0)) == std::future_status::timeout) {
-      worker_lock.unlock();
-      memory_store_.cond_var.notify_all();
-      disk_store_.cond_var.notify_all();
-      std::this_thread::yield();
-      worker_lock.lock();
-    }
-    if (worker_.valid()) {
-      try {
-        worker_.get();
-      } catch (const std::exception& e) {
-        LOG(kError) << boost::diagnostic_information(e);
+    for (auto& worker : workers_) {
+      while (worker.valid() &&
+             worker.wait_for(std::chrono::seconds(0)) == std::future_status::timeout) {
+        worker_lock.unlock();
+        memory_store_.cond_var.notify_all();
+        disk_store_.cond_var.notify_all();
+        std::this_thread::yield();
+        worker_lock.lock();
+      }
+      if (worker.valid()) {
+        try {
+          worker.get();
+        } catch (const std::exception& e) {
+          LOG(kError) << boost::diagnostic_information(e);
+        }
       }
     }
   }
 
+  segment_store_.reset();
   if (kShouldRemoveRoot_) {
     boost::system::error_code error_code;
     boost::filesystem::remove_all(kDiskBuffer_, error_code);
@@ -277,11 +680,29 @@ DataBuffer<Key>::~DataBuffer() {
 
 template <typename Key>
 void DataBuffer<Key>::Store(const KeyType& key, const NonEmptyString& value) {
+  Store(key, std::make_shared<const NonEmptyString>(value));
+}
+
+template <typename Key>
+void DataBuffer<Key>::Store(const KeyType& key, NonEmptyString&& value) {
+  Store(key, std::make_shared<const NonEmptyString>(std::move(value)));
+}
+
+template <typename Key>
+void DataBuffer<Key>::Store(const KeyType& key, SharedValue value) {
+  if (!value) {
+    LOG(kError) << "Cannot store " << DebugKeyName(key) << " with a null value.";
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::invalid_parameter));
+  }
+  {
+    std::lock_guard<std::mutex> disk_store_lock(disk_store_.mutex);
+    CheckFitsOnDisk(key, value);
+  }
   try {
     Delete(key);
-    LOG(kVerbose) << "Re-storing " << DebugKeyName(key) << " with value " << HexSubstr(value);
+    LOG(kVerbose) << "Re-storing " << DebugKeyName(key) << " with value " << HexSubstr(*value);
   } catch (const std::exception&) {
-    LOG(kVerbose) << "Storing " << DebugKeyName(key) << " with value " << HexSubstr(value);
+    LOG(kVerbose) << "Storing " << DebugKeyName(key) << " with value " << HexSubstr(*value);
   }
 
   CheckWorkerIsStillRunning();
@@ -292,9 +713,9 @@ void DataBuffer<Key>::Store(const KeyType& key, const NonEmptyString& value) {
 
 template <typename Key>
 std::unique_lock<std::mutex> DataBuffer<Key>::StoreInMemory(const KeyType& key,
-                                                            const NonEmptyString& value) {
+                                                            const SharedValue& value) {
   {
-    uint64_t required_space(value.string().size());
+    uint64_t required_space(value->string().size());
     std::unique_lock<std::mutex> memory_store_lock(memory_store_.mutex);
     if (required_space > memory_store_.max)
       return std::move(std::unique_lock<std::mutex>(disk_store_.mutex));
@@ -302,95 +723,513 @@ std::unique_lock<std::mutex> DataBuffer<Key>::StoreInMemory(const KeyType& key,
     WaitForSpaceInMemory(required_space, memory_store_lock);
 
     if (!running_) {
-      {
-        std::lock_guard<std::mutex> worker_lock(worker_mutex_);
-        if (worker_.valid())
-          worker_.get();
-      }
+      // The workers may need this lock to finish.
+      memory_store_lock.unlock();
+      GetWorkerResults();
       return std::move(std::unique_lock<std::mutex>());
     }
 
     memory_store_.current.data += required_space;
-    memory_store_.index.emplace_back(key, value);
+    auto itr(Emplace(memory_store_, memory_store_.index.end(), key, value));
+    if (oldest_in_memory_only_ == memory_store_.index.end())
+      oldest_in_memory_only_ = itr;
   }
   memory_store_.cond_var.notify_all();
   return std::move(std::unique_lock<std::mutex>());
 }
 
 template <typename Key>
-void DataBuffer<Key>::WaitForSpaceInMemory(uint64_t required_space,
-                                           std::unique_lock<std::mutex>& memory_store_lock) {
+bool DataBuffer<Key>::WaitForSpaceInMemory(uint64_t required_space,
+                                           std::unique_lock<std::mutex>& memory_store_lock,
+                                           TimePoint deadline) {
+  if (HasSpace(memory_store_, required_space))
+    return true;
+  TimePoint start(std::chrono::steady_clock::now());
+  on_scope_exit record_wait_time([this, start] {
+    AddElapsedTime(memory_wait_microseconds_, start);
+  });
   while (!HasSpace(memory_store_, required_space)) {
-    auto itr(FindMemoryRemovalCandidate(required_space, memory_store_lock));
+    auto itr(FindMemoryRemovalCandidate(required_space, memory_store_lock, deadline));
     if (!running_)
-      return;
+      return true;
 
-    if (itr != memory_store_.index.end()) {
-      memory_store_.current.data -= (*itr).value.string().size();
-      memory_store_.index.erase(itr);
+    if (itr != memory_store_.index.end())
+      EraseFromMemory(itr);
+    else if (!HasSpace(memory_store_, required_space))
+      return false;
+  }
+  return true;
+}
+
+template <typename Key>
+bool DataBuffer<Key>::TryStore(const KeyType& key, const NonEmptyString& value,
+                               std::chrono::steady_clock::time_point deadline) {
+  return TryStore(key, std::make_shared<const NonEmptyString>(value), deadline);
+}
+
+template <typename Key>
+bool DataBuffer<Key>::TryStore(const KeyType& key, SharedValue value,
+                               std::chrono::steady_clock::time_point deadline) {
+  if (!value) {
+    LOG(kError) << "Cannot store " << DebugKeyName(key) << " with a null value.";
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::invalid_parameter));
+  }
+  CheckWorkerIsStillRunning();
+  {
+    std::unique_lock<std::mutex> memory_store_lock(memory_store_.mutex);
+    if (value->string().size() <= memory_store_.max)
+      return TryStoreInMemory(key, value, memory_store_lock, deadline);
+  }
+  return TryStoreOnDisk(key, value, deadline);
+}
+
+template <typename Key>
+bool DataBuffer<Key>::TryStoreInMemory(const KeyType& key, const SharedValue& value,
+                                       std::unique_lock<std::mutex>& memory_store_lock,
+                                       TimePoint deadline) {
+  uint64_t required_space(value->string().size());
+  // The existing value under 'key' is about to be replaced, so its space needn't be waited for.
+  // It may be evicted while waiting though, so this is re-checked after every wait.
+  auto replaced_space([&]() -> uint64_t {
+    auto itr(Find(memory_store_, key));
+    if (itr == memory_store_.index.end())
+      return 0;
+    return std::min(required_space, static_cast<uint64_t>((*itr).value->string().size()));
+  });
+  while (running_ && !HasSpace(memory_store_, required_space - replaced_space())) {
+    if (!WaitForSpaceInMemory(required_space - replaced_space(), memory_store_lock, deadline)) {
+      LOG(kVerbose) << "No memory space for " << DebugKeyName(key) << " before deadline.";
+      return false;
     }
   }
+  CheckWorkerIsStillRunning();
+  // The space is reserved for as long as the lock is held.
+  ReplaceExisting(key, memory_store_lock);
+  memory_store_.current.data += required_space;
+  auto itr(Emplace(memory_store_, memory_store_.index.end(), key, value));
+  if (oldest_in_memory_only_ == memory_store_.index.end())
+    oldest_in_memory_only_ = itr;
+  memory_store_lock.unlock();
+  memory_store_.cond_var.notify_all();
+  return true;
 }
 
 template <typename Key>
-void DataBuffer<Key>::StoreOnDisk(const KeyType& key, const NonEmptyString& value,
-                                  std::unique_lock<std::mutex>&& disk_store_lock) {
-  assert(disk_store_lock);
-  if (value.string().size() > disk_store_.max) {
-    LOG(kError) << "Cannot store " << DebugKeyName(key) << " since its " << value.string().size()
+bool DataBuffer<Key>::TryStoreOnDisk(const KeyType& key, const SharedValue& value,
+                                     TimePoint deadline) {
+  std::unique_lock<std::mutex> disk_store_lock(disk_store_.mutex);
+  uint64_t reserved_space(MaxDiskSize(value));
+  if (reserved_space > disk_store_.max) {
+    LOG(kError) << "Cannot store " << DebugKeyName(key) << " since its " << reserved_space
                 << " bytes exceeds max of " << disk_store_.max << " bytes.";
-    StopRunning();
     BOOST_THROW_EXCEPTION(MakeError(CommonErrors::cannot_exceed_limit));
   }
-  disk_store_.index.emplace_back(key);
+  if (!ReserveSpaceOnDisk(reserved_space, disk_store_lock, deadline)) {
+    LOG(kVerbose) << "No disk space for " << DebugKeyName(key) << " before deadline.";
+    return false;
+  }
+  // The reservation is returned if anything fails before the write takes it over.
+  on_scope_exit release_reservation([&] {
+    if (!disk_store_lock)
+      disk_store_lock.lock();
+    disk_store_.current.data -= reserved_space;
+    disk_store_lock.unlock();
+    disk_store_.cond_var.notify_all();
+  });
+  disk_store_lock.unlock();
 
-  bool cancelled(false);
-  WaitForSpaceOnDisk(key, &value, disk_store_lock, cancelled);
-  if (!running_)
+  auto encoded(EncodeForDisk(value));
+  try {
+    Delete(key);
+    LOG(kVerbose) << "Re-storing " << DebugKeyName(key) << " with value " << HexSubstr(*value);
+  } catch (const std::exception&) {
+    LOG(kVerbose) << "Storing " << DebugKeyName(key) << " with value " << HexSubstr(*value);
+  }
+  CheckWorkerIsStillRunning();
+
+  disk_store_lock.lock();
+  // Another value under 'key' may still be being written to the same file.  Its space is already
+  // reserved, so this is only a wait for that write to finish.
+  disk_store_.cond_var.wait(disk_store_lock, [&]() -> bool {
+    return keys_being_written_.count(key) == 0 || !running_;
+  });
+  if (!running_) {
+    disk_store_lock.unlock();
+    CheckWorkerIsStillRunning();
+  }
+  release_reservation.Release();
+  disk_store_.current.data -= reserved_space - encoded->string().size();
+  uint64_t sequence((*Emplace(disk_store_, disk_store_.index.end(), key)).sequence);
+  WriteUnlocked(Batch(1, std::make_pair(key, encoded)), std::vector<uint64_t>(1, sequence),
+                disk_store_lock);
+  disk_store_lock.unlock();
+  disk_store_.cond_var.notify_all();
+  return true;
+}
+
+template <typename Key>
+bool DataBuffer<Key>::ReserveSpaceOnDisk(uint64_t required_space,
+                                         std::unique_lock<std::mutex>& disk_store_lock,
+                                         TimePoint deadline) {
+  if (!HasSpace(disk_store_, required_space)) {
+    TimePoint start(std::chrono::steady_clock::now());
+    on_scope_exit record_wait_time([this, start] {
+      AddElapsedTime(disk_wait_microseconds_, start);
+    });
+    while (running_ && !HasSpace(disk_store_, required_space)) {
+      auto itr(kPopFunctor_ ? FindOldestOnDisk() : disk_store_.index.end());
+      if (itr != disk_store_.index.end()) {
+        PopFromDisk(itr);
+        continue;
+      }
+      // Either there's no pop_functor, or all of the used space is held by values which are still
+      // being written.
+      if (!WaitUntil(disk_store_.cond_var, disk_store_lock, deadline, [&]() -> bool {
+            return !running_ || HasSpace(disk_store_, required_space) ||
+                   (kPopFunctor_ && FindOldestOnDisk() != disk_store_.index.end());
+          })) {
+        return false;
+      }
+    }
+  }
+  disk_store_.current.data += required_space;
+  return true;
+}
+
+template <typename Key>
+void DataBuffer<Key>::ReplaceExisting(const KeyType& key,
+                                      std::unique_lock<std::mutex>& memory_store_lock) {
+  assert(memory_store_lock);
+  StoringState also_on_disk(StoringState::kCompleted);
+  auto itr(Find(memory_store_, key));
+  if (itr != memory_store_.index.end()) {
+    also_on_disk = (*itr).also_on_disk;
+    EraseFromMemory(itr);
+  }
+  if (also_on_disk == StoringState::kNotStarted)
     return;
+  {
+    std::lock_guard<std::mutex> disk_store_lock(disk_store_.mutex);
+    auto disk_itr(Find(disk_store_, key));
+    if (disk_itr == disk_store_.index.end())
+      return;
+    RemoveDiskElement(disk_itr);
+  }
+  disk_store_.cond_var.notify_all();
+}
 
-  if (!cancelled) {
-    if (!WriteFile(GetFilename(key), value.string())) {
-      LOG(kError) << "Failed to move " << DebugKeyName(key) << " to disk.";
-      StopRunning();
-      BOOST_THROW_EXCEPTION(MakeError(CommonErrors::filesystem_io_error));
+template <typename Key>
+std::future<void> DataBuffer<Key>::AsyncStore(AsioService& asio_service, const KeyType& key,
+                                              SharedValue value) {
+  auto promise(std::make_shared<std::promise<void>>());
+  auto future(promise->get_future());
+  try {
+    if (!value) {
+      LOG(kError) << "Cannot store " << DebugKeyName(key) << " with a null value.";
+      BOOST_THROW_EXCEPTION(MakeError(CommonErrors::invalid_parameter));
     }
-    auto itr(FindStartedToStoreOnDisk(key));
-    if (itr != disk_store_.index.end())
-      (*itr).state = StoringState::kCompleted;
+    CheckWorkerIsStillRunning();
+    // Only the memory path can complete without blocking; anything needing the disk is posted.
+    std::unique_lock<std::mutex> memory_store_lock(memory_store_.mutex);
+    if (value->string().size() <= memory_store_.max &&
+        TryStoreInMemory(key, value, memory_store_lock, std::chrono::steady_clock::now())) {
+      promise->set_value();
+      return future;
+    }
+  } catch (...) {
+    promise->set_exception(std::current_exception());
+    return future;
+  }
+  asio_service.service().post([this, promise, key, value] {
+    try {
+      Store(key, value);
+      promise->set_value();
+    } catch (...) {
+      promise->set_exception(std::current_exception());
+    }
+  });
+  return future;
+}
+
+template <typename Key>
+std::future<typename DataBuffer<Key>::SharedValue> DataBuffer<Key>::AsyncGet(
+    AsioService& asio_service, const KeyType& key) {
+  auto promise(std::make_shared<std::promise<SharedValue>>());
+  auto future(promise->get_future());
+  try {
+    CheckWorkerIsStillRunning();
+    std::lock_guard<std::mutex> memory_store_lock(memory_store_.mutex);
+    auto value(GetFromMemory(key));
+    if (value) {
+      promise->set_value(value);
+      return future;
+    }
+  } catch (...) {
+    promise->set_exception(std::current_exception());
+    return future;
+  }
+  asio_service.service().post([this, promise, key] {
+    try {
+      auto value(GetFromDisk(key));
+      if (!value) {
+        LOG(kWarning) << DebugKeyName(key) << " is not in the disk index or is cancelled.";
+        BOOST_THROW_EXCEPTION(MakeError(CommonErrors::no_such_element));
+      }
+      promise->set_value(value);
+    } catch (...) {
+      promise->set_exception(std::current_exception());
+    }
+  });
+  return future;
+}
+
+template <typename Key>
+void DataBuffer<Key>::StoreOnDisk(const KeyType& key, const SharedValue& value,
+                                  std::unique_lock<std::mutex>&& disk_store_lock) {
+  StoreBatchOnDisk(Batch(1, std::make_pair(key, value)), std::move(disk_store_lock));
+}
+
+template <typename Key>
+void DataBuffer<Key>::StoreBatchOnDisk(Batch batch,
+                                       std::unique_lock<std::mutex>&& disk_store_lock) {
+  assert(disk_store_lock);
+  for (const auto& element : batch)
+    CheckFitsOnDisk(element.first, element.second);
+  // Elements are identified by sequence from here on, since other workers may be storing values
+  // under the same keys.
+  std::vector<uint64_t> sequences;
+  sequences.reserve(batch.size());
+  for (const auto& element : batch)
+    sequences.push_back((*Emplace(disk_store_, disk_store_.index.end(), element.first)).sequence);
+
+  if (kDiskCompression_ != DiskCompression::kNone) {
+    // The values keep their places in the disk index while being compressed without the lock, but
+    // may be deleted (i.e. cancelled) meanwhile.
+    disk_store_lock.unlock();
+    for (auto& element : batch)
+      element.second = EncodeForDisk(element.second);
+    disk_store_lock.lock();
+    Batch live;
+    std::vector<uint64_t> live_sequences;
+    live.reserve(batch.size());
+    live_sequences.reserve(batch.size());
+    for (size_t i(0); i != batch.size(); ++i) {
+      auto itr(FindOnDisk(batch[i].first, sequences[i]));
+      if (itr != disk_store_.index.end() && (*itr).state == StoringState::kCancelled) {
+        Erase(disk_store_, itr);
+      } else if (itr != disk_store_.index.end()) {
+        live.push_back(std::move(batch[i]));
+        live_sequences.push_back(sequences[i]);
+      }
+    }
+    batch.swap(live);
+    sequences.swap(live_sequences);
+  }
 
-    disk_store_.current.data += value.string().size();
+  // Values under the same key can't be written concurrently, so any key which is already being
+  // written, or appears twice in the batch, means falling back to storing one value at a time.
+  uint64_t batch_size(0);
+  bool overwriting(false);
+  FlatHashSet<KeyType, KeyHash> batch_keys(batch.size());
+  for (const auto& element : batch) {
+    batch_size += element.second->string().size();
+    overwriting = overwriting || keys_being_written_.count(element.first) != 0 ||
+                  !batch_keys.insert(element.first).second;
+  }
+  if (batch.size() > 1 && !overwriting && batch_size <= disk_store_.max &&
+      HasSpace(disk_store_, batch_size)) {
+    // There's room for the whole batch, so reserve it and write the batch in one go.
+    disk_store_.current.data += batch_size;
+    WriteUnlocked(batch, sequences, disk_store_lock);
+  } else {
+    for (size_t i(0); i != batch.size(); ++i) {
+      if (!running_)
+        return;
+      // The lock may have been released while waiting for space for an earlier value, so this one
+      // may since have been deleted.
+      auto itr(FindOnDisk(batch[i].first, sequences[i]));
+      if (itr == disk_store_.index.end())
+        continue;
+      if ((*itr).state == StoringState::kCancelled) {
+        Erase(disk_store_, itr);
+        continue;
+      }
+      FinishStoringOnDisk(batch[i].first, sequences[i], batch[i].second, disk_store_lock);
+    }
   }
   disk_store_lock.unlock();
   disk_store_.cond_var.notify_all();
 }
 
 template <typename Key>
-void DataBuffer<Key>::WaitForSpaceOnDisk(const KeyType& key, const NonEmptyString* const value,
+void DataBuffer<Key>::WriteUnlocked(const Batch& batch, const std::vector<uint64_t>& sequences,
+                                    std::unique_lock<std::mutex>& disk_store_lock) {
+  for (size_t i(0); i != batch.size(); ++i) {
+    // Concurrent Store calls for the same key can leave an older value for it on disk, which is
+    // about to be overwritten.
+    auto range(disk_store_.lookup.equal_range(batch[i].first));
+    for (auto itr(range.first); itr != range.second; ++itr) {
+      if (itr->second->sequence != sequences[i] &&
+          itr->second->state == StoringState::kCompleted) {
+        auto stale(itr->second);
+        RemoveFromDisk(batch[i].first, nullptr);
+        Erase(disk_store_, stale);
+        break;
+      }
+    }
+  }
+  // Get can be served from 'elements_being_moved_to_disk_' until the elements are completed.
+  for (const auto& element : batch) {
+    keys_being_written_.insert(element.first);
+    elements_being_moved_to_disk_[element.first] = element.second;
+  }
+  disk_store_lock.unlock();
+  bool written(batch.size() == 1 ? WriteToDisk(batch.front().first, *batch.front().second)
+                                 : WriteBatchToDisk(batch));
+  disk_store_lock.lock();
+  for (const auto& element : batch) {
+    keys_being_written_.erase(element.first);
+    elements_being_moved_to_disk_.erase(element.first);
+  }
+  disk_store_.cond_var.notify_all();
+
+  if (!written) {
+    for (const auto& element : batch)
+      disk_store_.current.data -= element.second->string().size();
+    if (batch.size() == 1)
+      LOG(kError) << "Failed to move " << DebugKeyName(batch.front().first) << " to disk.";
+    else
+      LOG(kError) << "Failed to move batch of " << batch.size() << " values to disk.";
+    StopRunning();
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::filesystem_io_error));
+  }
+  for (size_t i(0); i != batch.size(); ++i) {
+    auto itr(FindOnDisk(batch[i].first, sequences[i]));
+    if (itr != disk_store_.index.end() && (*itr).state == StoringState::kStarted) {
+      (*itr).state = StoringState::kCompleted;
+      continue;
+    }
+    // The value was deleted while it was being written.
+    RemoveFromDisk(batch[i].first, nullptr);
+    if (itr != disk_store_.index.end())
+      Erase(disk_store_, itr);
+  }
+}
+
+template <typename Key>
+void DataBuffer<Key>::CheckFitsOnDisk(const KeyType& key, const SharedValue& value) {
+  if (MaxDiskSize(value) > disk_store_.max) {
+    LOG(kError) << "Cannot store " << DebugKeyName(key) << " since its " << MaxDiskSize(value)
+                << " bytes exceeds max of " << disk_store_.max << " bytes.";
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::cannot_exceed_limit));
+  }
+}
+
+template <typename Key>
+uint64_t DataBuffer<Key>::MaxDiskSize(const SharedValue& value) const {
+  return value->string().size() + (kDiskCompression_ == DiskCompression::kNone ? 0 : 1);
+}
+
+template <typename Key>
+bool DataBuffer<Key>::MemoryFitsOnDisk(uint64_t max_memory_usage, uint64_t max_disk_usage) const {
+  // A compressed value can take one byte more than its raw size.
+  return max_memory_usage == 0 ||
+         max_memory_usage + (kDiskCompression_ == DiskCompression::kNone ? 0 : 1) <=
+             max_disk_usage;
+}
+
+template <typename Key>
+typename DataBuffer<Key>::SharedValue DataBuffer<Key>::EncodeForDisk(
+    const SharedValue& value) const {
+  if (kDiskCompression_ == DiskCompression::kNone)
+    return value;
+  const std::string& raw(value->string());
+  if (raw.size() >= kMinCompressibleSize) {
+    try {
+      // Only compress the whole value if a sample of it compresses to 7/8 of its size or less.
+      bool compressible(true);
+      if (raw.size() > kCompressionSampleSize) {
+        NonEmptyString sample(raw.substr(0, static_cast<size_t>(kCompressionSampleSize)));
+        compressible = crypto::Compress(sample, kCompressionLevel)->string().size() * 8 <=
+                       kCompressionSampleSize * 7;
+      }
+      if (compressible) {
+        auto compressed(crypto::Compress(*value, kCompressionLevel));
+        if (compressed->string().size() < raw.size()) {
+          return std::make_shared<const NonEmptyString>(kCompressedMarker +
+                                                        compressed->string());
+        }
+      }
+    } catch (const std::exception& e) {
+      LOG(kWarning) << "Failed to compress value: " << boost::diagnostic_information(e);
+    }
+  }
+  return std::make_shared<const NonEmptyString>(kUncompressedMarker + raw);
+}
+
+template <typename Key>
+NonEmptyString DataBuffer<Key>::DecodeFromDisk(const NonEmptyString& stored) const {
+  if (kDiskCompression_ == DiskCompression::kNone)
+    return stored;
+  const std::string& encoded(stored.string());
+  if (encoded.size() > 1 && encoded[0] == kCompressedMarker)
+    return crypto::Uncompress(crypto::CompressedText(NonEmptyString(encoded.substr(1))));
+  if (encoded.size() > 1 && encoded[0] == kUncompressedMarker)
+    return NonEmptyString(encoded.substr(1));
+  LOG(kError) << "Value on disk has no valid compression marker.";
+  BOOST_THROW_EXCEPTION(MakeError(CommonErrors::parsing_error));
+}
+
+template <typename Key>
+void DataBuffer<Key>::FinishStoringOnDisk(const KeyType& key, uint64_t sequence,
+                                          const SharedValue& value,
+                                          std::unique_lock<std::mutex>& disk_store_lock) {
+  bool cancelled(false);
+  WaitForSpaceOnDisk(key, sequence, value, disk_store_lock, cancelled);
+  if (!running_ || cancelled)
+    return;
+
+  // Reserve the space before releasing the lock, so other workers can't claim it too.
+  disk_store_.current.data += value->string().size();
+  WriteUnlocked(Batch(1, std::make_pair(key, value)), std::vector<uint64_t>(1, sequence),
+                disk_store_lock);
+}
+
+template <typename Key>
+void DataBuffer<Key>::WaitForSpaceOnDisk(const KeyType& key, uint64_t sequence,
+                                         const SharedValue& value,
                                          std::unique_lock<std::mutex>& disk_store_lock,
                                          bool& cancelled) {
-  while (!HasSpace(disk_store_, value->string().size()) && running_) {
-    auto itr(Find(disk_store_, key));
+  uint64_t required_space(value->string().size());
+  auto must_wait([&]() -> bool {
+    return keys_being_written_.count(key) != 0 || !HasSpace(disk_store_, required_space);
+  });
+  if (!must_wait())
+    return;
+  TimePoint start(std::chrono::steady_clock::now());
+  on_scope_exit record_wait_time([this, start] { AddElapsedTime(disk_wait_microseconds_, start); });
+  while (must_wait() && running_) {
+    auto itr(FindOnDisk(key, sequence));
     if (itr == disk_store_.index.end()) {
       cancelled = true;
       return;
     }
 
     if ((*itr).state == StoringState::kCancelled) {
-      disk_store_.index.erase(itr);
+      Erase(disk_store_, itr);
       cancelled = true;
       return;
     }
 
-    if (kPopFunctor_) {
+    if (keys_being_written_.count(key) != 0) {
+      disk_store_.cond_var.wait(disk_store_lock);
+    } else if (kPopFunctor_) {
       itr = FindOldestOnDisk();
-      assert((*itr).state != StoringState::kStarted);
-      if ((*itr).state == StoringState::kCompleted) {
-        KeyType oldest_key(itr->key);
-        NonEmptyString oldest_value;
-        RemoveFile(oldest_key, &oldest_value);
-        disk_store_.index.erase(itr);
-        kPopFunctor_(oldest_key, oldest_value);
+      if (itr == disk_store_.index.end()) {
+        // All of the used space is held by values which other workers are still writing.
+        disk_store_.cond_var.wait(disk_store_lock);
+      } else {
+        PopFromDisk(itr);
       }
     } else {
       // Rely on client of this class to call Delete until enough space becomes available.  Make the
@@ -405,30 +1244,83 @@ void DataBuffer<Key>::WaitForSpaceOnDisk(const KeyType& key, const NonEmptyStrin
   }
 }
 
+template <typename Key>
+void DataBuffer<Key>::PopFromDisk(typename DiskIndex::iterator itr) {
+  KeyType oldest_key(itr->key);
+  NonEmptyString oldest_value;
+  RemoveFromDisk(oldest_key, &oldest_value);
+  Erase(disk_store_, itr);
+  ++pops_;
+  kPopFunctor_(oldest_key, oldest_value);
+}
+
 template <typename Key>
 NonEmptyString DataBuffer<Key>::Get(const KeyType& key) {
+  return *GetShared(key);
+}
+
+template <typename Key>
+typename DataBuffer<Key>::SharedValue DataBuffer<Key>::GetShared(const KeyType& key) {
   CheckWorkerIsStillRunning();
   {
     std::lock_guard<std::mutex> memory_store_lock(memory_store_.mutex);
-    auto itr(Find(memory_store_, key));
-    if (itr != memory_store_.index.end())
-      return (*itr).value;
+    auto value(GetFromMemory(key));
+    if (value)
+      return value;
   }
-  std::unique_lock<std::mutex> disk_store_lock(disk_store_.mutex);
-  auto itr(FindAndThrowIfCancelled(key));
-  if ((*itr).state == StoringState::kStarted) {
-    auto temp_itr(elements_being_moved_to_disk_.find(key));
-    if (temp_itr != std::end(elements_being_moved_to_disk_))
-      return *temp_itr->second;
-    disk_store_.cond_var.wait(disk_store_lock, [this, &key]() -> bool {
-      auto itr(Find(disk_store_, key));
-      return (itr == disk_store_.index.end() || (*itr).state != StoringState::kStarted);
-    });
-    itr = FindAndThrowIfCancelled(key);
+  auto value(GetFromDisk(key));
+  if (!value) {
+    LOG(kWarning) << DebugKeyName(key) << " is not in the disk index or is cancelled.";
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::no_such_element));
   }
-  return ReadFile(GetFilename(key));
-  // TODO(Fraser#5#): 2012-11-23 - There should maybe be another background task moving the item
-  //                               from wherever it's found to the back of the memory index.
+  return value;
+}
+
+template <typename Key>
+typename DataBuffer<Key>::SharedValue DataBuffer<Key>::GetFromMemory(const KeyType& key) {
+  if (frequency_sketch_)
+    frequency_sketch_->Increment(key);
+  auto itr(Find(memory_store_, key));
+  if (itr == memory_store_.index.end())
+    return SharedValue();
+  ++memory_hits_;
+  if (read_promotion_ != ReadPromotion::kNone)
+    MarkRecentlyUsed(itr);
+  return (*itr).value;
+}
+
+template <typename Key>
+typename DataBuffer<Key>::SharedValue DataBuffer<Key>::GetFromDisk(const KeyType& key) {
+  SharedValue value;
+  uint64_t disk_sequence(0);
+  {
+    std::unique_lock<std::mutex> disk_store_lock(disk_store_.mutex);
+    auto itr(FindIfNotCancelled(key));
+    if (itr != disk_store_.index.end() && (*itr).state == StoringState::kStarted) {
+      auto temp_itr(elements_being_moved_to_disk_.find(key));
+      if (temp_itr != std::end(elements_being_moved_to_disk_)) {
+        ++memory_hits_;
+        // This holds the value as encoded for disk.
+        if (kDiskCompression_ == DiskCompression::kNone)
+          return temp_itr->second;
+        return std::make_shared<const NonEmptyString>(DecodeFromDisk(*temp_itr->second));
+      }
+      disk_store_.cond_var.wait(disk_store_lock, [this, &key]() -> bool {
+        auto itr(Find(disk_store_, key));
+        return (itr == disk_store_.index.end() || (*itr).state != StoringState::kStarted);
+      });
+      itr = FindIfNotCancelled(key);
+    }
+    if (itr == disk_store_.index.end()) {
+      ++misses_;
+      return value;
+    }
+    value = std::make_shared<const NonEmptyString>(ReadFromDisk(key));
+    disk_sequence = (*itr).sequence;
+  }
+  ++disk_hits_;
+  PromoteToMemory(key, value, disk_sequence);
+  return value;
 }
 
 template <typename Key>
@@ -436,38 +1328,211 @@ void DataBuffer<Key>::Delete(const KeyType& key) {
   CheckWorkerIsStillRunning();
   StoringState also_on_disk(StoringState::kNotStarted);
   DeleteFromMemory(key, also_on_disk);
-  if (also_on_disk != StoringState::kNotStarted)
-    DeleteFromDisk(key);
+  if (also_on_disk != StoringState::kNotStarted) {
+    uint64_t disk_sequence(DeleteFromDisk(key));
+    // A concurrent Get may have copied the value back into memory after DeleteFromMemory.
+    DeletePromotedCopy(key, disk_sequence);
+  }
 }
 
 template <typename Key>
 void DataBuffer<Key>::Delete(std::function<bool(const KeyType&)> predicate) {
   CheckWorkerIsStillRunning();
+  // Both stores are locked throughout so that a concurrent Get can't promote a value back into
+  // memory between the two passes.
+  std::lock_guard<std::mutex> memory_store_lock(memory_store_.mutex);
+  std::lock_guard<std::mutex> disk_store_lock(disk_store_.mutex);
+  auto before_size(memory_store_.index.size());
+  for (auto itr(memory_store_.index.begin()); itr != memory_store_.index.end();) {
+    if (predicate((*itr).key))
+      EraseFromMemory(itr++);
+    else
+      ++itr;
+  }
+  if (memory_store_.index.size() != before_size)
+    memory_store_.cond_var.notify_all();
+
+  bool changed(false);
+  for (auto itr(disk_store_.index.begin()); itr != disk_store_.index.end();) {
+    if (predicate((*itr).key)) {
+      // Cancels a write in progress, or removes the stored value so that it isn't recovered later.
+      RemoveDiskElement(itr++);
+      changed = true;
+    } else {
+      ++itr;
+    }
+  }
+  if (changed)
+    disk_store_.cond_var.notify_all();
+}
+
+template <typename Key>
+void DataBuffer<Key>::StoreBatch(std::vector<std::pair<KeyType, NonEmptyString>> elements) {
+  Batch batch;
+  batch.reserve(elements.size());
+  for (auto& element : elements) {
+    batch.emplace_back(std::move(element.first),
+                       std::make_shared<const NonEmptyString>(std::move(element.second)));
+  }
+  StoreBatch(std::move(batch));
+}
+
+template <typename Key>
+void DataBuffer<Key>::StoreBatch(std::vector<std::pair<KeyType, SharedValue>> elements) {
+  // Keep only the last value for each key, preserving the order of the remainder.
+  {
+    FlatHashMap<KeyType, size_t, KeyHash> last_index(elements.size());
+    for (size_t i(0); i != elements.size(); ++i) {
+      if (!elements[i].second) {
+        LOG(kError) << "Cannot store " << DebugKeyName(elements[i].first) << " with a null value.";
+        BOOST_THROW_EXCEPTION(MakeError(CommonErrors::invalid_parameter));
+      }
+      last_index[elements[i].first] = i;
+    }
+    if (last_index.size() != elements.size()) {
+      Batch unique_elements;
+      unique_elements.reserve(last_index.size());
+      for (size_t i(0); i != elements.size(); ++i) {
+        if (last_index[elements[i].first] == i)
+          unique_elements.push_back(std::move(elements[i]));
+      }
+      elements.swap(unique_elements);
+    }
+  }
+  {
+    std::lock_guard<std::mutex> disk_store_lock(disk_store_.mutex);
+    for (const auto& element : elements)
+      CheckFitsOnDisk(element.first, element.second);
+  }
+  std::vector<KeyType> keys;
+  keys.reserve(elements.size());
+  for (const auto& element : elements)
+    keys.push_back(element.first);
+  DeleteKeys(keys);
+
+  CheckWorkerIsStillRunning();
+  std::vector<size_t> too_large_for_memory;
   {
-    std::lock_guard<std::mutex> memory_store_lock(memory_store_.mutex);
-    auto before_size(memory_store_.index.size());
-    memory_store_.index.erase(std::remove_if(std::begin(memory_store_.index),
-                                             std::end(memory_store_.index),
-                                             [&](const MemoryElement& item) {
-                                if (predicate(item.key)) {
-                                  memory_store_.current.data -= item.value.string().size();
-                                  return true;
-                                } else {
-                                  return false;
-                                }
-                              }),
-                              std::end(memory_store_.index));
-    if (memory_store_.index.size() != before_size)
+    std::unique_lock<std::mutex> memory_store_lock(memory_store_.mutex);
+    size_t next(0);
+    while (next != elements.size()) {
+      // Reserve space for as many of the remaining values as will fit in memory at once.
+      std::vector<size_t> run;
+      uint64_t required_space(0);
+      for (; next != elements.size(); ++next) {
+        uint64_t size(elements[next].second->string().size());
+        if (size > memory_store_.max) {
+          too_large_for_memory.push_back(next);
+          continue;
+        }
+        if (!run.empty() && required_space + size > memory_store_.max)
+          break;
+        required_space += size;
+        run.push_back(next);
+      }
+      if (run.empty())
+        break;
+
+      WaitForSpaceInMemory(required_space, memory_store_lock);
+      if (!running_) {
+        memory_store_lock.unlock();
+        GetWorkerResults();
+        return;
+      }
+
+      memory_store_.current.data += required_space;
+      for (size_t index : run) {
+        auto itr(Emplace(memory_store_, memory_store_.index.end(), elements[index].first,
+                         elements[index].second));
+        if (oldest_in_memory_only_ == memory_store_.index.end())
+          oldest_in_memory_only_ = itr;
+      }
       memory_store_.cond_var.notify_all();
+    }
+  }
+  for (size_t index : too_large_for_memory) {
+    StoreOnDisk(elements[index].first, elements[index].second,
+                std::unique_lock<std::mutex>(disk_store_.mutex));
   }
-  std::lock_guard<std::mutex> disk_store_lock(disk_store_.mutex);
-  auto before_size(disk_store_.index.size());
-  disk_store_.index.erase(
-      std::remove_if(std::begin(disk_store_.index), std::end(disk_store_.index),
-                     [&](const DiskElement& item) { return predicate(item.key); }),
-      std::end(disk_store_.index));
-  if (disk_store_.index.size() != before_size)
-    disk_store_.cond_var.notify_all();
+}
+
+template <typename Key>
+std::vector<typename DataBuffer<Key>::SharedValue> DataBuffer<Key>::GetBatch(
+    const std::vector<KeyType>& keys) {
+  CheckWorkerIsStillRunning();
+  std::vector<SharedValue> values(keys.size());
+  {
+    std::lock_guard<std::mutex> memory_store_lock(memory_store_.mutex);
+    for (size_t i(0); i != keys.size(); ++i)
+      values[i] = GetFromMemory(keys[i]);
+  }
+  for (size_t i(0); i != keys.size(); ++i) {
+    if (!values[i])
+      values[i] = GetFromDisk(keys[i]);
+  }
+  return values;
+}
+
+template <typename Key>
+void DataBuffer<Key>::DeleteBatch(const std::vector<KeyType>& keys) {
+  CheckWorkerIsStillRunning();
+  size_t missing_count(DeleteKeys(keys));
+  if (missing_count != 0) {
+    LOG(kWarning) << missing_count << " of " << keys.size() << " keys were not held.";
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::no_such_element));
+  }
+}
+
+template <typename Key>
+size_t DataBuffer<Key>::DeleteKeys(const std::vector<KeyType>& keys) {
+  // Keys which may also be held on disk.
+  std::vector<KeyType> disk_keys;
+  bool changed(false);
+  {
+    std::lock_guard<std::mutex> memory_store_lock(memory_store_.mutex);
+    for (const auto& key : keys) {
+      auto itr(Find(memory_store_, key));
+      if (itr == memory_store_.index.end()) {
+        disk_keys.push_back(key);
+        continue;
+      }
+      if ((*itr).also_on_disk != StoringState::kNotStarted)
+        disk_keys.push_back(key);
+      EraseFromMemory(itr);
+      changed = true;
+    }
+  }
+  if (changed)
+    memory_store_.cond_var.notify_all();
+  if (disk_keys.empty())
+    return 0;
+
+  size_t missing_count(0);
+  std::vector<std::pair<KeyType, uint64_t>> removed;
+  {
+    std::lock_guard<std::mutex> disk_store_lock(disk_store_.mutex);
+    for (const auto& key : disk_keys) {
+      auto itr(Find(disk_store_, key));
+      if (itr == disk_store_.index.end()) {
+        ++missing_count;
+        continue;
+      }
+      removed.emplace_back(key, (*itr).sequence);
+      RemoveDiskElement(itr);
+    }
+  }
+  disk_store_.cond_var.notify_all();
+
+  // As for Delete, a concurrent Get may have copied some of the values back into memory.
+  changed = false;
+  {
+    std::lock_guard<std::mutex> memory_store_lock(memory_store_.mutex);
+    for (const auto& key_and_sequence : removed)
+      changed = ErasePromotedCopy(key_and_sequence.first, key_and_sequence.second) || changed;
+  }
+  if (changed)
+    memory_store_.cond_var.notify_all();
+  return missing_count;
 }
 
 template <typename Key>
@@ -478,8 +1543,7 @@ void DataBuffer<Key>::DeleteFromMemory(const KeyType& key, StoringState& also_on
     auto itr(Find(memory_store_, key));
     if (itr != memory_store_.index.end()) {
       also_on_disk = (*itr).also_on_disk;
-      memory_store_.current.data -= (*itr).value.string().size();
-      memory_store_.index.erase(itr);
+      EraseFromMemory(itr);
       changed = true;
     } else {
       // Assume it's on disk so as to invoke a DeleteFromDisk
@@ -491,27 +1555,184 @@ void DataBuffer<Key>::DeleteFromMemory(const KeyType& key, StoringState& also_on
 }
 
 template <typename Key>
-void DataBuffer<Key>::DeleteFromDisk(const KeyType& key) {
+uint64_t DataBuffer<Key>::DeleteFromDisk(const KeyType& key) {
+  uint64_t disk_sequence(0);
   {
-    std::lock_guard<std::mutex> disk_store_lock(disk_store_.mutex);
+    std::unique_lock<std::mutex> disk_store_lock(disk_store_.mutex);
     auto itr(Find(disk_store_, key));
     if (itr == disk_store_.index.end()) {
       LOG(kWarning) << DebugKeyName(key) << " is not in the disk index.";
       BOOST_THROW_EXCEPTION(MakeError(CommonErrors::no_such_element));
     }
 
-    if ((*itr).state == StoringState::kStarted) {
-      (*itr).state = StoringState::kCancelled;
-    } else if ((*itr).state == StoringState::kCompleted) {
-      RemoveFile(itr->key, nullptr);
-      disk_store_.index.erase(itr);
+    disk_sequence = (*itr).sequence;
+    bool being_written((*itr).state == StoringState::kStarted);
+    RemoveDiskElement(itr);
+    if (being_written) {
+      // The writer removes the value from disk once it sees the write was cancelled.  Wait for
+      // that, so that the value can't be recovered after a crash once this has returned.
+      disk_store_.cond_var.notify_all();
+      disk_store_.cond_var.wait(disk_store_lock, [&]() -> bool {
+        return !running_ || FindOnDisk(key, disk_sequence) == disk_store_.index.end();
+      });
     }
   }
   disk_store_.cond_var.notify_all();
+  return disk_sequence;
 }
 
 template <typename Key>
-void DataBuffer<Key>::RemoveFile(const KeyType& key, NonEmptyString* value) {
+void DataBuffer<Key>::RemoveDiskElement(typename DiskIndex::iterator itr) {
+  if ((*itr).state == StoringState::kStarted) {
+    (*itr).state = StoringState::kCancelled;
+  } else if ((*itr).state == StoringState::kCompleted) {
+    RemoveFromDisk(itr->key, nullptr);
+    Erase(disk_store_, itr);
+  }
+}
+
+template <typename Key>
+void DataBuffer<Key>::DeletePromotedCopy(const KeyType& key, uint64_t disk_sequence) {
+  {
+    std::lock_guard<std::mutex> memory_store_lock(memory_store_.mutex);
+    if (!ErasePromotedCopy(key, disk_sequence))
+      return;
+  }
+  memory_store_.cond_var.notify_all();
+}
+
+template <typename Key>
+bool DataBuffer<Key>::ErasePromotedCopy(const KeyType& key, uint64_t disk_sequence) {
+  if (read_promotion_ == ReadPromotion::kNone)
+    return false;
+  auto itr(Find(memory_store_, key));
+  if (itr == memory_store_.index.end() || !(*itr).promoted ||
+      (*itr).disk_sequence != disk_sequence) {
+    return false;
+  }
+  EraseFromMemory(itr);
+  return true;
+}
+
+template <typename Key>
+void DataBuffer<Key>::MarkRecentlyUsed(typename MemoryIndex::iterator itr) {
+  // Elements not yet stored to disk are never eviction candidates, so only those before
+  // 'oldest_in_memory_only_' need to be moved.  Moving them to just before that point makes them
+  // the last of the disk-backed elements to be evicted.
+  if ((*itr).also_on_disk != StoringState::kNotStarted)
+    memory_store_.index.splice(oldest_in_memory_only_, memory_store_.index, itr);
+}
+
+template <typename Key>
+void DataBuffer<Key>::PromoteToMemory(const KeyType& key, const SharedValue& value,
+                                      uint64_t disk_sequence) {
+  {
+    std::lock_guard<std::mutex> memory_store_lock(memory_store_.mutex);
+    if (read_promotion_ == ReadPromotion::kNone)
+      return;
+    uint64_t required_space(value->string().size());
+    if (required_space > memory_store_.max || Find(memory_store_, key) != memory_store_.index.end())
+      return;
+    {
+      // Don't promote if the value has since been deleted or replaced.
+      std::lock_guard<std::mutex> disk_store_lock(disk_store_.mutex);
+      auto itr(Find(disk_store_, key));
+      if (itr == disk_store_.index.end() || (*itr).sequence != disk_sequence ||
+          (*itr).state != StoringState::kCompleted) {
+        return;
+      }
+    }
+    if (!MakeSpaceForPromotion(key, required_space)) {
+      ++rejected_promotions_;
+      return;
+    }
+    memory_store_.current.data += required_space;
+    auto itr(Emplace(memory_store_, oldest_in_memory_only_, key, value));
+    (*itr).also_on_disk = StoringState::kCompleted;
+    (*itr).promoted = true;
+    (*itr).disk_sequence = disk_sequence;
+    ++promotions_;
+  }
+  memory_store_.cond_var.notify_all();
+}
+
+template <typename Key>
+bool DataBuffer<Key>::MakeSpaceForPromotion(const KeyType& key, uint64_t required_space) {
+  if (HasSpace(memory_store_, required_space))
+    return true;
+  // Only elements already stored to disk can be evicted, and they are held least recently used
+  // first.  Never block waiting for the disk worker here.
+  uint8_t frequency(frequency_sketch_ ? frequency_sketch_->Estimate(key) : 0);
+  uint64_t freed_space(0);
+  std::vector<typename MemoryIndex::iterator> victims;
+  for (auto itr(memory_store_.index.begin()); itr != oldest_in_memory_only_; ++itr) {
+    if (memory_store_.current.data - freed_space <= memory_store_.max.data - required_space)
+      break;
+    if ((*itr).also_on_disk != StoringState::kCompleted)
+      continue;
+    if (frequency_sketch_ && frequency_sketch_->Estimate((*itr).key) >= frequency)
+      return false;
+    victims.push_back(itr);
+    freed_space += (*itr).value->string().size();
+  }
+  if (memory_store_.current.data - freed_space > memory_store_.max.data - required_space)
+    return false;
+  for (auto victim : victims)
+    EraseFromMemory(victim);
+  return true;
+}
+
+template <typename Key>
+bool DataBuffer<Key>::WriteToDisk(const KeyType& key, const NonEmptyString& value) {
+  TimePoint start(std::chrono::steady_clock::now());
+  auto path(GetFilename(key));
+  bool result(segment_store_ ? segment_store_->Put(path.filename().string(), value.string())
+                             : detail::WriteFilesAtomically(std::vector<detail::NamedContent>(
+                                   1, detail::NamedContent(path, std::cref(value.string())))));
+  disk_write_latency_.Record(std::chrono::steady_clock::now() - start);
+  return result;
+}
+
+template <typename Key>
+bool DataBuffer<Key>::WriteBatchToDisk(const Batch& batch) {
+  TimePoint start(std::chrono::steady_clock::now());
+  on_scope_exit record_latency([this, start] {
+    disk_write_latency_.Record(std::chrono::steady_clock::now() - start);
+  });
+  if (segment_store_) {
+    std::vector<SegmentStore::NamedValue> values;
+    values.reserve(batch.size());
+    for (const auto& element : batch) {
+      values.emplace_back(GetFilename(element.first).filename().string(),
+                          std::cref(element.second->string()));
+    }
+    return segment_store_->PutBatch(values);
+  }
+  // Written together so that the folder is only synced once for the whole batch.
+  std::vector<detail::NamedContent> files;
+  files.reserve(batch.size());
+  for (const auto& element : batch)
+    files.emplace_back(GetFilename(element.first), std::cref(element.second->string()));
+  return detail::WriteFilesAtomically(files);
+}
+
+template <typename Key>
+NonEmptyString DataBuffer<Key>::ReadFromDisk(const KeyType& key) {
+  TimePoint start(std::chrono::steady_clock::now());
+  NonEmptyString stored(segment_store_ ? segment_store_->Get(GetFilename(key).filename().string())
+                                       : ReadFile(GetFilename(key)));
+  disk_read_latency_.Record(std::chrono::steady_clock::now() - start);
+  return DecodeFromDisk(stored);
+}
+
+template <typename Key>
+void DataBuffer<Key>::RemoveFromDisk(const KeyType& key, NonEmptyString* value) {
+  if (segment_store_) {
+    disk_store_.current.data -= segment_store_->Remove(GetFilename(key).filename().string(), value);
+    if (value)
+      *value = DecodeFromDisk(*value);
+    return;
+  }
   auto path(GetFilename(key));
   boost::system::error_code error_code;
   uint64_t size(boost::filesystem::file_size(path, error_code));
@@ -520,7 +1741,7 @@ void DataBuffer<Key>::RemoveFile(const KeyType& key, NonEmptyString* value) {
     BOOST_THROW_EXCEPTION(MakeError(CommonErrors::filesystem_io_error));
   }
   if (value)
-    *value = ReadFile(path);
+    *value = DecodeFromDisk(ReadFile(path));
   if (!boost::filesystem::remove(path, error_code) || error_code) {
     LOG(kError) << "Error removing " << path << ": " << error_code.message();
     BOOST_THROW_EXCEPTION(MakeError(CommonErrors::filesystem_io_error));
@@ -530,32 +1751,65 @@ void DataBuffer<Key>::RemoveFile(const KeyType& key, NonEmptyString* value) {
 
 template <typename Key>
 void DataBuffer<Key>::CopyQueueToDisk() {
-  KeyType key;
-  NonEmptyString value;
+  // However this worker exits (e.g. by throwing), callers waiting on it must be woken so that they
+  // see it has stopped rather than waiting for space it will never make.
+  on_scope_exit stop_running([this] { StopRunning(); });
+  Batch batch;
+  std::vector<uint64_t> sequences;
   for (;;) {
     {
-      // Get oldest value not yet stored to disk
       std::unique_lock<std::mutex> memory_store_lock(memory_store_.mutex);
-      auto itr(memory_store_.index.end());
-
-      memory_store_.cond_var.wait(memory_store_lock, [this, &itr]() -> bool {
-        itr = FindOldestInMemoryOnly();
-        return itr != memory_store_.index.end() || !running_;
+      memory_store_.cond_var.wait(memory_store_lock, [this]() -> bool {
+        return FindOldestInMemoryOnly() != memory_store_.index.end() || !running_;
       });
       if (!running_)
         return;
 
-      assert(itr != memory_store_.index.end());
-      key = (*itr).key;
-      value = (*itr).value;
-      (*itr).also_on_disk = StoringState::kStarted;
+      // Take the oldest values not yet stored to disk, up to this worker's share of
+      // kMaxDiskBatchSize in total.
+      batch.clear();
+      sequences.clear();
+      uint64_t batch_size(0);
+      for (auto itr(FindOldestInMemoryOnly()); itr != memory_store_.index.end();
+           itr = FindOldestInMemoryOnly()) {
+        uint64_t size((*itr).value->string().size());
+        if (!batch.empty() && batch_size + size > kMaxDiskBatchSize / kDiskWriterCount_)
+          break;
+        batch.emplace_back((*itr).key, (*itr).value);
+        sequences.push_back((*itr).sequence);
+        batch_size += size;
+        (*itr).also_on_disk = StoringState::kStarted;
+        ++oldest_in_memory_only_;
+      }
       std::unique_lock<std::mutex> disk_store_lock(disk_store_.mutex);
+      // A value stored before the limits were lowered may no longer fit on disk.  It can never be
+      // copied there, so is dropped rather than stopping this worker.
+      for (size_t i(0); i != batch.size();) {
+        if (MaxDiskSize(batch[i].second) <= disk_store_.max) {
+          ++i;
+          continue;
+        }
+        LOG(kError) << "Dropping " << DebugKeyName(batch[i].first) << " since its "
+                    << MaxDiskSize(batch[i].second) << " bytes exceeds max of "
+                    << disk_store_.max << " bytes.";
+        auto itr(Find(memory_store_, batch[i].first, sequences[i]));
+        if (itr != memory_store_.index.end())
+          EraseFromMemory(itr);
+        batch.erase(batch.begin() + i);
+        sequences.erase(sequences.begin() + i);
+      }
       memory_store_lock.unlock();
-      StoreOnDisk(key, value, std::move(disk_store_lock));
+      StoreBatchOnDisk(batch, std::move(disk_store_lock));
       memory_store_lock.lock();
-      itr = Find(memory_store_, key);
-      if (itr != memory_store_.index.end())
-        (*itr).also_on_disk = StoringState::kCompleted;
+      // Only the elements taken above are completed; any of them may since have been replaced by
+      // a new value which another worker is still storing.
+      for (size_t i(0); i != batch.size(); ++i) {
+        auto itr(Find(memory_store_, batch[i].first, sequences[i]));
+        if (itr != memory_store_.index.end() &&
+            (*itr).also_on_disk == StoringState::kStarted) {
+          (*itr).also_on_disk = StoringState::kCompleted;
+        }
+      }
     }
     memory_store_.cond_var.notify_all();
   }
@@ -563,11 +1817,13 @@ void DataBuffer<Key>::CopyQueueToDisk() {
 
 template <typename Key>
 void DataBuffer<Key>::CheckWorkerIsStillRunning() {
-  // if this goes ready then we have an exception so get that (throw basically)
+  // if any goes ready then we have an exception so get that (throw basically)
   {
     std::lock_guard<std::mutex> worker_lock(worker_mutex_);
-    if (worker_.valid() && worker_.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
-      worker_.get();
+    for (auto& worker : workers_) {
+      if (worker.valid() && worker.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+        worker.get();
+    }
   }
   if (!running_) {
     LOG(kError) << "Worker is no longer running.";
@@ -575,6 +1831,15 @@ void DataBuffer<Key>::CheckWorkerIsStillRunning() {
   }
 }
 
+template <typename Key>
+void DataBuffer<Key>::GetWorkerResults() {
+  std::lock_guard<std::mutex> worker_lock(worker_mutex_);
+  for (auto& worker : workers_) {
+    if (worker.valid())
+      worker.get();
+  }
+}
+
 template <typename Key>
 void DataBuffer<Key>::StopRunning() {
   running_ = false;
@@ -586,8 +1851,8 @@ template <typename Key>
 void DataBuffer<Key>::SetMaxMemoryUsage(MemoryUsage max_memory_usage) {
   {
     std::lock_guard<std::mutex> memory_store_lock(memory_store_.mutex);
-    if (max_memory_usage > disk_store_.max) {
-      LOG(kError) << "Max memory usage must be <= max disk usage.";
+    if (!MemoryFitsOnDisk(max_memory_usage.data, disk_store_.max.data)) {
+      LOG(kError) << "Max memory usage must be <= max disk usage, or < if compressing.";
       BOOST_THROW_EXCEPTION(MakeError(CommonErrors::invalid_parameter));
     }
     memory_store_.max = max_memory_usage;
@@ -600,8 +1865,8 @@ void DataBuffer<Key>::SetMaxDiskUsage(DiskUsage max_disk_usage) {
   bool increased(false);
   {
     std::lock_guard<std::mutex> disk_store_lock(disk_store_.mutex);
-    if (memory_store_.max > max_disk_usage) {
-      LOG(kError) << "Max memory usage must be <= max disk usage.";
+    if (!MemoryFitsOnDisk(memory_store_.max.data, max_disk_usage.data)) {
+      LOG(kError) << "Max memory usage must be <= max disk usage, or < if compressing.";
       BOOST_THROW_EXCEPTION(MakeError(CommonErrors::invalid_parameter));
     }
     increased = (max_disk_usage > disk_store_.max);
@@ -611,6 +1876,55 @@ void DataBuffer<Key>::SetMaxDiskUsage(DiskUsage max_disk_usage) {
     disk_store_.cond_var.notify_all();
 }
 
+template <typename Key>
+void DataBuffer<Key>::SetReadPromotion(ReadPromotion read_promotion) {
+  std::lock_guard<std::mutex> memory_store_lock(memory_store_.mutex);
+  read_promotion_ = read_promotion;
+  if (read_promotion_ == ReadPromotion::kTinyLfu) {
+    if (!frequency_sketch_)
+      frequency_sketch_.reset(new FrequencySketch<KeyType, KeyHash>);
+  } else {
+    frequency_sketch_.reset();
+  }
+}
+
+template <typename Key>
+DataBufferHitStatistics DataBuffer<Key>::GetHitStatistics() const {
+  DataBufferHitStatistics statistics;
+  statistics.memory_hits = memory_hits_;
+  statistics.disk_hits = disk_hits_;
+  statistics.misses = misses_;
+  statistics.promotions = promotions_;
+  statistics.rejected_promotions = rejected_promotions_;
+  return statistics;
+}
+
+template <typename Key>
+DataBufferStatistics DataBuffer<Key>::GetStatistics() {
+  DataBufferStatistics statistics;
+  statistics.hits = GetHitStatistics();
+  {
+    std::lock_guard<std::mutex> memory_store_lock(memory_store_.mutex);
+    statistics.memory_bytes = memory_store_.current.data;
+    statistics.memory_values = memory_store_.index.size();
+    for (auto itr(oldest_in_memory_only_); itr != memory_store_.index.end(); ++itr) {
+      statistics.spill_queue_bytes += (*itr).value->string().size();
+      ++statistics.spill_queue_values;
+    }
+  }
+  {
+    std::lock_guard<std::mutex> disk_store_lock(disk_store_.mutex);
+    statistics.disk_bytes = disk_store_.current.data;
+    statistics.disk_values = disk_store_.index.size();
+  }
+  statistics.pops = pops_;
+  statistics.memory_wait_time = std::chrono::microseconds(memory_wait_microseconds_);
+  statistics.disk_wait_time = std::chrono::microseconds(disk_wait_microseconds_);
+  statistics.disk_write_latency = disk_write_latency_.GetSnapshot();
+  statistics.disk_read_latency = disk_read_latency_.GetSnapshot();
+  return statistics;
+}
+
 template <typename Key>
 boost::filesystem::path DataBuffer<Key>::GetFilename(const KeyType& key) const {
   return kDiskBuffer_ / HexEncode(key);
@@ -619,6 +1933,24 @@ boost::filesystem::path DataBuffer<Key>::GetFilename(const KeyType& key) const {
 template <>
 boost::filesystem::path DataBuffer<DataNameVariant>::GetFilename(const DataNameVariant& key) const;
 
+template <typename Key>
+template <typename Predicate>
+bool DataBuffer<Key>::WaitUntil(std::condition_variable& cond_var,
+                                std::unique_lock<std::mutex>& lock, TimePoint deadline,
+                                Predicate predicate) {
+  if (deadline == TimePoint::max()) {
+    cond_var.wait(lock, predicate);
+    return true;
+  }
+  return cond_var.wait_until(lock, deadline, predicate);
+}
+
+template <typename Key>
+void DataBuffer<Key>::AddElapsedTime(std::atomic<uint64_t>& total_microseconds, TimePoint start) {
+  total_microseconds += std::chrono::duration_cast<std::chrono::microseconds>(
+                            std::chrono::steady_clock::now() - start).count();
+}
+
 template <typename Key>
 template <typename T>
 bool DataBuffer<Key>::HasSpace(const T& store, uint64_t required_space) const {
@@ -629,55 +1961,102 @@ bool DataBuffer<Key>::HasSpace(const T& store, uint64_t required_space) const {
 template <typename Key>
 template <typename T>
 typename T::index_type::iterator DataBuffer<Key>::Find(T& store, const KeyType& key) {
-  return std::find_if(
-      store.index.begin(), store.index.end(),
-      [&key](const typename T::index_type::value_type& key_value) { return key_value.key == key; });
+  auto range(store.lookup.equal_range(key));
+  auto result(store.index.end());
+  for (auto itr(range.first); itr != range.second; ++itr) {
+    if (result == store.index.end() || itr->second->sequence < result->sequence)
+      result = itr->second;
+  }
+  return result;
+}
+
+template <typename Key>
+template <typename T>
+typename T::index_type::iterator DataBuffer<Key>::Find(T& store, const KeyType& key,
+                                                       uint64_t sequence) {
+  auto range(store.lookup.equal_range(key));
+  for (auto itr(range.first); itr != range.second; ++itr) {
+    if (itr->second->sequence == sequence)
+      return itr->second;
+  }
+  return store.index.end();
+}
+
+template <typename Key>
+template <typename T, typename... Args>
+typename T::index_type::iterator DataBuffer<Key>::Emplace(
+    T& store, typename T::index_type::const_iterator position, Args&&... args) {
+  auto itr(store.index.emplace(position, std::forward<Args>(args)...));
+  (*itr).sequence = store.next_sequence++;
+  store.lookup.emplace((*itr).key, itr);
+  return itr;
+}
+
+template <typename Key>
+template <typename T>
+void DataBuffer<Key>::Erase(T& store, typename T::index_type::iterator itr) {
+  auto range(store.lookup.equal_range((*itr).key));
+  for (auto lookup_itr(range.first); lookup_itr != range.second; ++lookup_itr) {
+    if (lookup_itr->second == itr) {
+      store.lookup.erase(lookup_itr);
+      break;
+    }
+  }
+  store.index.erase(itr);
+}
+
+template <typename Key>
+void DataBuffer<Key>::EraseFromMemory(typename MemoryIndex::iterator itr) {
+  if (itr == oldest_in_memory_only_)
+    ++oldest_in_memory_only_;
+  memory_store_.current.data -= (*itr).value->string().size();
+  Erase(memory_store_, itr);
 }
 
 template <typename Key>
 typename DataBuffer<Key>::MemoryIndex::iterator DataBuffer<Key>::FindOldestInMemoryOnly() {
-  return std::find_if(memory_store_.index.begin(), memory_store_.index.end(),
-                      [](const MemoryElement& key_value) {
-    return key_value.also_on_disk == StoringState::kNotStarted;
-  });
+  return oldest_in_memory_only_;
 }
 
 template <typename Key>
 typename DataBuffer<Key>::MemoryIndex::iterator DataBuffer<Key>::FindMemoryRemovalCandidate(
-    uint64_t required_space, std::unique_lock<std::mutex>& memory_store_lock) {
+    uint64_t required_space, std::unique_lock<std::mutex>& memory_store_lock,
+    TimePoint deadline) {
   auto itr(memory_store_.index.end());
-  memory_store_.cond_var.wait(memory_store_lock, [this, &itr, &required_space]() -> bool {
-    itr = std::find_if(memory_store_.index.begin(), memory_store_.index.end(),
+  WaitUntil(memory_store_.cond_var, memory_store_lock, deadline,
+            [this, &itr, &required_space]() -> bool {
+    // Only elements before 'oldest_in_memory_only_' can have been stored to disk
+    itr = std::find_if(memory_store_.index.begin(), oldest_in_memory_only_,
                        [](const MemoryElement& key_value) {
       return key_value.also_on_disk == StoringState::kCompleted;
     });
+    if (itr == oldest_in_memory_only_)
+      itr = memory_store_.index.end();
     return itr != memory_store_.index.end() || HasSpace(memory_store_, required_space) || !running_;
   });
   return itr;
 }
 
 template <typename Key>
-typename DataBuffer<Key>::DiskIndex::iterator DataBuffer<Key>::FindStartedToStoreOnDisk(
-    const KeyType& key) {
-  return std::find_if(disk_store_.index.begin(), disk_store_.index.end(),
-                      [&key](const DiskElement& entry) {
-    return entry.state == StoringState::kStarted && entry.key == key;
-  });
+typename DataBuffer<Key>::DiskIndex::iterator DataBuffer<Key>::FindOnDisk(const KeyType& key,
+                                                                          uint64_t sequence) {
+  return Find(disk_store_, key, sequence);
 }
 
 template <typename Key>
 typename DataBuffer<Key>::DiskIndex::iterator DataBuffer<Key>::FindOldestOnDisk() {
-  return disk_store_.index.begin();
+  return std::find_if(disk_store_.index.begin(), disk_store_.index.end(),
+                      [](const DiskElement& element) {
+    return element.state == StoringState::kCompleted;
+  });
 }
 
 template <typename Key>
-typename DataBuffer<Key>::DiskIndex::iterator DataBuffer<Key>::FindAndThrowIfCancelled(
+typename DataBuffer<Key>::DiskIndex::iterator DataBuffer<Key>::FindIfNotCancelled(
     const KeyType& key) {
   auto itr(Find(disk_store_, key));
-  if (itr == disk_store_.index.end() || (*itr).state == StoringState::kCancelled) {
-    LOG(kWarning) << DebugKeyName(key) << " is not in the disk index or is cancelled.";
-    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::no_such_element));
-  }
+  if (itr != disk_store_.index.end() && (*itr).state == StoringState::kCancelled)
+    return disk_store_.index.end();
   return itr;
 }
 
@@ -19,6 +19,7 @@
 #ifndef MAIDSAFE_COMMON_DATA_TYPES_DATA_NAME_VARIANT_H_
 #define MAIDSAFE_COMMON_DATA_TYPES_DATA_NAME_VARIANT_H_
 
+#include <functional>
 #include <utility>
 
 #include "boost/variant/static_visitor.hpp"
@@ -72,6 +73,26 @@ struct GetTagValueAndIdentityVisitor
   }
 };
 
+struct GetHashVisitor : public boost::static_visitor<size_t> {
+  template <typename NameType>
+  result_type operator()(const NameType& name) const {
+    return std::hash<Identity>()(name.value) ^
+           static_cast<size_t>(NameType::data_type::Tag::kValue);
+  }
+};
+
 }  // namespace maidsafe
 
+namespace std {
+
+// Replaces Boost's std::hash for variants, which would need a boost::hash for each name type.
+template <>
+struct hash<maidsafe::DataNameVariant> {
+  size_t operator()(const maidsafe::DataNameVariant& name) const {
+    return boost::apply_visitor(maidsafe::GetHashVisitor(), name);
+  }
+};
+
+}  // namespace std
+
 #endif  // MAIDSAFE_COMMON_DATA_TYPES_DATA_NAME_VARIANT_H_
@@ -0,0 +1,123 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+/*
+  A fixed-size histogram of durations, cheap enough to leave permanently enabled on hot paths.
+  Samples are counted in buckets whose bounds are powers of two microseconds, so recording a sample
+  is a handful of relaxed atomic increments and never blocks.  Percentiles read from a snapshot are
+  therefore only accurate to within a factor of two.
+*/
+
+#ifndef MAIDSAFE_COMMON_LATENCY_HISTOGRAM_H_
+#define MAIDSAFE_COMMON_LATENCY_HISTOGRAM_H_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace maidsafe {
+
+class LatencyHistogram {
+ public:
+  // Bucket 0 counts samples under 1 microsecond; bucket i counts samples in [2^(i-1), 2^i)
+  // microseconds; the last bucket also counts anything longer.
+  static const size_t kBucketCount = 32;
+
+  struct Snapshot {
+    Snapshot() : buckets(), count(0), total_microseconds(0) { buckets.fill(0); }
+    // Returns the upper bound in microseconds of the bucket holding the given percentile (in the
+    // range [0, 100]), or 0 if there are no samples.
+    uint64_t Percentile(double percentile) const;
+    uint64_t MeanMicroseconds() const { return count == 0 ? 0 : total_microseconds / count; }
+    Snapshot& operator+=(const Snapshot& other);
+
+    std::array<uint64_t, kBucketCount> buckets;
+    uint64_t count, total_microseconds;
+  };
+
+  LatencyHistogram() : buckets_(), count_(0), total_microseconds_(0) {
+    for (auto& bucket : buckets_)
+      bucket.store(0, std::memory_order_relaxed);
+  }
+
+  template <typename Rep, typename Period>
+  void Record(std::chrono::duration<Rep, Period> duration) {
+    auto microseconds(std::chrono::duration_cast<std::chrono::microseconds>(duration).count());
+    uint64_t sample(microseconds < 0 ? 0 : static_cast<uint64_t>(microseconds));
+    buckets_[BucketIndex(sample)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    total_microseconds_.fetch_add(sample, std::memory_order_relaxed);
+  }
+
+  // Concurrent calls to Record may or may not be reflected in the returned snapshot.
+  Snapshot GetSnapshot() const {
+    Snapshot snapshot;
+    for (size_t i(0); i != kBucketCount; ++i)
+      snapshot.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+    snapshot.count = count_.load(std::memory_order_relaxed);
+    snapshot.total_microseconds = total_microseconds_.load(std::memory_order_relaxed);
+    return snapshot;
+  }
+
+ private:
+  LatencyHistogram(const LatencyHistogram&);
+  LatencyHistogram& operator=(const LatencyHistogram&);
+
+  static size_t BucketIndex(uint64_t microseconds) {
+    size_t index(0);
+    while (microseconds != 0 && index != kBucketCount - 1) {
+      microseconds >>= 1;
+      ++index;
+    }
+    return index;
+  }
+
+  std::array<std::atomic<uint64_t>, kBucketCount> buckets_;
+  std::atomic<uint64_t> count_, total_microseconds_;
+};
+
+inline LatencyHistogram::Snapshot& LatencyHistogram::Snapshot::operator+=(const Snapshot& other) {
+  for (size_t i(0); i != kBucketCount; ++i)
+    buckets[i] += other.buckets[i];
+  count += other.count;
+  total_microseconds += other.total_microseconds;
+  return *this;
+}
+
+inline uint64_t LatencyHistogram::Snapshot::Percentile(double percentile) const {
+  uint64_t total(0);
+  for (auto bucket : buckets)
+    total += bucket;
+  if (total == 0)
+    return 0;
+  auto rank(static_cast<uint64_t>(percentile / 100.0 * static_cast<double>(total) + 0.5));
+  if (rank == 0)
+    rank = 1;
+  uint64_t seen(0);
+  for (size_t i(0); i != kBucketCount; ++i) {
+    seen += buckets[i];
+    if (seen >= rank)
+      return uint64_t(1) << i;
+  }
+  return uint64_t(1) << (kBucketCount - 1);
+}
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_COMMON_LATENCY_HISTOGRAM_H_
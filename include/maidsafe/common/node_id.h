@@ -19,16 +19,49 @@
 #ifndef MAIDSAFE_COMMON_NODE_ID_H_
 #define MAIDSAFE_COMMON_NODE_ID_H_
 
+#include <array>
 #include <cstdint>
+#include <cstring>
 #include <ostream>
 #include <string>
 #include <vector>
 
+#ifdef _MSC_VER
+#include <stdlib.h>
+#endif
+
 #include "maidsafe/common/crypto.h"
 #include "maidsafe/common/error.h"
+#include "maidsafe/common/types.h"
 
 namespace maidsafe {
 
+namespace detail {
+
+// Reads 8 bytes as a big-endian word, so that comparing such words gives the same order as
+// comparing the bytes lexicographically.
+inline uint64_t ReadBigEndianWord(const uint8_t* bytes) {
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__BYTE_ORDER__) && \
+    __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  uint64_t word;
+  std::memcpy(&word, bytes, 8);
+  return __builtin_bswap64(word);
+#elif defined(_MSC_VER)
+  uint64_t word;
+  std::memcpy(&word, bytes, 8);
+  return _byteswap_uint64(word);
+#else
+  uint64_t word(0);
+  for (int i(0); i != 8; ++i)
+    word = (word << 8) | bytes[i];
+  return word;
+#endif
+}
+
+}  // namespace detail
+
+// The ID is held inline in a fixed-size array, so copying doesn't allocate and comparisons work a
+// word at a time.
 class NodeId {
  public:
   enum class EncodingType { kBinary = 0, kHex, kBase64 };
@@ -37,10 +70,9 @@ class NodeId {
   // Creates an ID for which IsValid() returns false.
   NodeId();
 
-  NodeId(const NodeId& other);
-  NodeId(NodeId&& other) MAIDSAFE_NOEXCEPT;
+  // Moving is the same as copying.
+  NodeId(const NodeId&) = default;
   NodeId& operator=(const NodeId&) = default;
-  NodeId& operator=(NodeId&& other) MAIDSAFE_NOEXCEPT;
 
   // Creates a NodeId from a raw (decoded) string.  Will throw if 'id' is invalid.
   explicit NodeId(std::string id);
@@ -64,6 +96,10 @@ class NodeId {
   // False for default constructed NodeId, otherwise true.
   bool IsValid() const;
 
+  // The raw (decoded) ID; all zero for a default constructed NodeId.  Unlike string(), this neither
+  // allocates nor throws.
+  const std::array<uint8_t, kSize>& bytes() const { return raw_id_; }
+
   // Number of most significant bits which are common to this ID and 'other'.  Will throw if
   // IsValid() is false for '*this' or 'other'.
   int CommonLeadingBits(const NodeId& other) const;
@@ -99,18 +135,47 @@ class NodeId {
   friend void swap(NodeId& lhs, NodeId& rhs) MAIDSAFE_NOEXCEPT;
 
  private:
+  static_assert(kSize % 8 == 0, "NodeId comparisons assume a whole number of 64-bit words.");
+
+  // Throws if 'id' is not kSize bytes.
+  void Assign(const std::string& id);
+  std::string RawString() const;
   std::string EncodeToBinary() const;
-  void DecodeFromBinary(const std::string& binary_id);
+  static std::string DecodeFromBinary(const std::string& binary_id);
 
-  std::string raw_id_;
-#ifndef NDEBUG
-  std::string debug_id_;
-#endif
+  // All zero for a default constructed NodeId.
+  std::array<uint8_t, kSize> raw_id_;
+  // False for a default constructed NodeId (always true if USE_DEPRECATED_NODE_ID_BEHAVIOUR is
+  // defined, in which case IsValid() instead checks for a non-zero ID).
+  bool valid_;
 };
 
-inline bool operator==(const NodeId& lhs, const NodeId& rhs) { return lhs.raw_id_ == rhs.raw_id_; }
+inline bool operator==(const NodeId& lhs, const NodeId& rhs) {
+  // Invalid IDs are all zero, so only the validity flags need to be checked separately.
+  uint64_t difference(lhs.valid_ == rhs.valid_ ? 0 : 1);
+  for (size_t i(0); i != NodeId::kSize; i += 8) {
+    uint64_t lhs_word, rhs_word;
+    std::memcpy(&lhs_word, &lhs.raw_id_[i], 8);
+    std::memcpy(&rhs_word, &rhs.raw_id_[i], 8);
+    difference |= lhs_word ^ rhs_word;
+  }
+  return difference == 0;
+}
+
 inline bool operator!=(const NodeId& lhs, const NodeId& rhs) { return !operator==(lhs, rhs); }
-inline bool operator<(const NodeId& lhs, const NodeId& rhs) { return lhs.raw_id_ < rhs.raw_id_; }
+
+inline bool operator<(const NodeId& lhs, const NodeId& rhs) {
+  if (lhs.valid_ != rhs.valid_)
+    return rhs.valid_;
+  for (size_t i(0); i != NodeId::kSize; i += 8) {
+    uint64_t lhs_word(detail::ReadBigEndianWord(&lhs.raw_id_[i]));
+    uint64_t rhs_word(detail::ReadBigEndianWord(&rhs.raw_id_[i]));
+    if (lhs_word != rhs_word)
+      return lhs_word < rhs_word;
+  }
+  return false;
+}
+
 inline bool operator>(const NodeId& lhs, const NodeId& rhs) { return operator<(rhs, lhs); }
 inline bool operator<=(const NodeId& lhs, const NodeId& rhs) { return !operator>(lhs, rhs); }
 inline bool operator>=(const NodeId& lhs, const NodeId& rhs) { return !operator<(lhs, rhs); }
@@ -130,4 +195,16 @@ std::basic_ostream<Elem, Traits>& operator<<(std::basic_ostream<Elem, Traits>& o
 
 }  // namespace maidsafe
 
+namespace std {
+
+// Uses the first machine word of the ID.  All invalid IDs hash to 0.
+template <>
+struct hash<maidsafe::NodeId> {
+  size_t operator()(const maidsafe::NodeId& node_id) const {
+    return maidsafe::detail::HashPrefixWord(node_id.bytes().data());
+  }
+};
+
+}  // namespace std
+
 #endif  // MAIDSAFE_COMMON_NODE_ID_H_
@@ -0,0 +1,140 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+/*
+  A log-structured store which appends named values to large, preallocated segment files rather
+  than writing one file per value.  The location of each value is held in an in-memory index.
+  Removing a value only marks its record as deleted; a background worker reclaims the space by
+  copying the live records out of any sealed segment which is at least half dead, marking the
+  originals as deleted, then deleting that segment.  The active segment is sealed early once half
+  of its capacity is dead, so the space used on disk stays within a small multiple of the live
+  values plus one segment.
+
+  Each record is laid out as a 24 byte header (state, name size, value size and a CRC-32 of the
+  sizes, name and value) followed by the name and then the value.  Segment files are named
+  "segment_<number>" and are created in 'root'.
+
+  On recovery each segment is scanned up to its first record which fails the checksum (e.g. one only
+  partly written before a crash), then truncated there and sealed, so that new records always go to
+  a fresh segment.
+*/
+
+#ifndef MAIDSAFE_COMMON_SEGMENT_STORE_H_
+#define MAIDSAFE_COMMON_SEGMENT_STORE_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "boost/filesystem/path.hpp"
+
+#include "maidsafe/common/types.h"
+
+namespace maidsafe {
+
+class SegmentStore {
+ public:
+  typedef std::pair<std::string, std::reference_wrapper<const std::string>> NamedValue;
+  static const uint64_t kDefaultSegmentSize, kMinSegmentSize;
+
+  // Returns a segment size suited to holding up to 'max_bytes' of values: an eighth of it, clamped
+  // to [kMinSegmentSize, kDefaultSegmentSize].
+  static uint64_t SegmentSizeFor(uint64_t max_bytes);
+
+  // Throws if 'root' isn't an existing directory.  Any segment files already in 'root' are
+  // removed, unless 'recover' is true in which case they are scanned (in parallel) and the live
+  // records in them are indexed again.  Starts a background worker thread which compacts segments.
+  SegmentStore(boost::filesystem::path root, uint64_t segment_size = kDefaultSegmentSize,
+               bool recover = false);
+  ~SegmentStore();
+
+  // Appends 'value' to the current segment, replacing any existing value held under 'name'.
+  // Returns false if the value can't be written.
+  bool Put(const std::string& name, const std::string& value);
+  // As for Put, but appends all the values contiguously to a single segment, flushing once.  If
+  // this returns false, none of the values have been stored.
+  bool PutBatch(const std::vector<NamedValue>& values);
+  // Throws if 'name' isn't held, or if the value can't be read.
+  NonEmptyString Get(const std::string& name);
+  // Throws if 'name' isn't held, or if the record can't be marked as deleted.  If 'value' is not
+  // NULL, it is set to the removed value.  Returns the size of the removed value.
+  uint64_t Remove(const std::string& name, NonEmptyString* value);
+  bool Has(const std::string& name) const;
+  // Copies the live records out of every sealed segment which is at least half dead.  This is
+  // normally done by the background worker.
+  void Compact();
+
+  // Total size of the live values (excluding record headers and names).
+  uint64_t LiveValueBytes() const;
+  // Number of segment files currently held.
+  size_t SegmentCount() const;
+  // Returns the name and value size of every live value, in the order the values were stored.
+  std::vector<std::pair<std::string, uint64_t>> Contents() const;
+
+ private:
+  SegmentStore(const SegmentStore&);
+  SegmentStore(SegmentStore&&);
+  SegmentStore& operator=(SegmentStore);
+
+  struct Segment {
+    Segment(uint32_t number_in, boost::filesystem::path path_in, uint64_t capacity_in);
+    uint32_t number;
+    boost::filesystem::path path;
+    std::fstream stream;
+    uint64_t capacity, write_offset, dead_bytes;
+  };
+
+  struct Location {
+    uint32_t segment;
+    uint64_t offset, value_size;
+  };
+
+  void Recover(const std::vector<boost::filesystem::path>& segment_paths);
+  Segment& ActiveSegment(uint64_t required_space);
+  bool Append(const std::vector<NamedValue>& values, std::vector<Location>& locations);
+  void UpdateIndex(const std::string& name, const Location& location);
+  void MarkDeleted(const Location& location, uint64_t record_size);
+  void Seal(Segment& segment);
+  void CompactSegment(uint32_t number, std::unique_lock<std::mutex>& lock);
+  void CompactionWorker();
+
+  const boost::filesystem::path kRoot_;
+  const uint64_t kSegmentSize_;
+  std::map<uint32_t, std::unique_ptr<Segment>> segments_;
+  std::unordered_map<std::string, Location> index_;
+  std::set<uint32_t> compaction_candidates_;
+  uint64_t live_value_bytes_;
+  bool running_;
+  mutable std::mutex mutex_;
+  std::condition_variable cond_var_;
+  std::future<void> worker_;
+};
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_COMMON_SEGMENT_STORE_H_
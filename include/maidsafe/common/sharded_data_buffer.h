@@ -0,0 +1,410 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+/*
+  A DataBuffer which partitions its keys by hash across a number of independent DataBuffer shards.
+  Each shard has its own locks, its own background worker and an equal share of the overall memory
+  and disk limits, so operations on keys in different shards never contend with each other.
+
+  Since the limits are split evenly, a value larger than a shard's share of memory goes straight
+  to disk, and a value larger than a shard's share of disk can't be stored at all.  The pop_functor
+  may be invoked concurrently by different shards.
+*/
+
+#ifndef MAIDSAFE_COMMON_SHARDED_DATA_BUFFER_H_
+#define MAIDSAFE_COMMON_SHARDED_DATA_BUFFER_H_
+
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "boost/filesystem/operations.hpp"
+#include "boost/filesystem/path.hpp"
+
+#include "maidsafe/common/asio_service.h"
+#include "maidsafe/common/data_buffer.h"
+#include "maidsafe/common/error.h"
+#include "maidsafe/common/log.h"
+#include "maidsafe/common/types.h"
+
+namespace maidsafe {
+
+template <typename Key>
+class ShardedDataBuffer {
+ public:
+  typedef Key KeyType;
+  typedef DataBuffer<KeyType> ShardType;
+  typedef typename ShardType::PopFunctor PopFunctor;
+  typedef typename ShardType::SharedValue SharedValue;
+
+  // Throws if shard_count is 0.  Otherwise, as for the equivalent DataBuffer constructor, where
+  // each shard gets its own folder in temp_directory_path().
+  ShardedDataBuffer(MemoryUsage max_memory_usage, DiskUsage max_disk_usage, PopFunctor pop_functor,
+                    uint32_t shard_count, DiskBackend disk_backend = DiskBackend::kFilePerValue,
+                    DiskCompression disk_compression = DiskCompression::kNone,
+                    uint32_t disk_writer_count = 1);
+  // Throws if shard_count is 0.  Otherwise, as for the equivalent DataBuffer constructor, where
+  // each shard uses the folder "disk_buffer/shard_<index>".  Recovering values from disk requires
+  // the same shard_count as was used when they were stored.
+  ShardedDataBuffer(MemoryUsage max_memory_usage, DiskUsage max_disk_usage, PopFunctor pop_functor,
+                    uint32_t shard_count, const boost::filesystem::path& disk_buffer,
+                    bool should_remove_root = false,
+                    DiskBackend disk_backend = DiskBackend::kFilePerValue,
+                    DiskRecovery disk_recovery = DiskRecovery::kNone,
+                    DiskCompression disk_compression = DiskCompression::kNone,
+                    uint32_t disk_writer_count = 1);
+  // Destroys each shard in turn, then removes "disk_buffer" if should_remove_root was true.
+  ~ShardedDataBuffer();
+
+  // These behave as the equivalent DataBuffer functions, applied to the shard owning 'key'.
+  void Store(const KeyType& key, const NonEmptyString& value);
+  void Store(const KeyType& key, NonEmptyString&& value);
+  void Store(const KeyType& key, SharedValue value);
+  NonEmptyString Get(const KeyType& key);
+  SharedValue GetShared(const KeyType& key);
+  bool TryStore(const KeyType& key, const NonEmptyString& value,
+                std::chrono::steady_clock::time_point deadline);
+  bool TryStore(const KeyType& key, SharedValue value,
+                std::chrono::steady_clock::time_point deadline);
+  std::future<void> AsyncStore(AsioService& asio_service, const KeyType& key, SharedValue value);
+  std::future<SharedValue> AsyncGet(AsioService& asio_service, const KeyType& key);
+  void Delete(const KeyType& key);
+  // Applied to every shard.
+  void Delete(std::function<bool(const KeyType&)> predicate);
+  // These split the batch by shard, then behave as the equivalent DataBuffer functions applied to
+  // each shard's part of the batch in turn.
+  void StoreBatch(std::vector<std::pair<KeyType, NonEmptyString>> elements);
+  void StoreBatch(std::vector<std::pair<KeyType, SharedValue>> elements);
+  std::vector<SharedValue> GetBatch(const std::vector<KeyType>& keys);
+  void DeleteBatch(const std::vector<KeyType>& keys);
+  // Throws if max_memory_usage > max_disk_usage_.  Splits the new limit evenly across the shards.
+  void SetMaxMemoryUsage(MemoryUsage max_memory_usage);
+  // Throws if max_memory_usage_ > max_disk_usage.  Splits the new limit evenly across the shards.
+  void SetMaxDiskUsage(DiskUsage max_disk_usage);
+  // Applied to every shard.
+  void SetReadPromotion(ReadPromotion read_promotion);
+  // Returns the sum of every shard's statistics.
+  DataBufferHitStatistics GetHitStatistics() const;
+  // Returns the sum of the shards' statistics.
+  DataBufferStatistics GetStatistics();
+
+  size_t shard_count() const { return shards_.size(); }
+
+ private:
+  ShardedDataBuffer(const ShardedDataBuffer&);
+  ShardedDataBuffer(ShardedDataBuffer&&);
+  ShardedDataBuffer& operator=(ShardedDataBuffer);
+
+  static void CheckShardCount(uint32_t shard_count);
+  // Returns index's share of 'total', with any remainder going to the lowest-indexed shards.
+  static uint64_t Share(uint64_t total, size_t index, size_t shard_count);
+  size_t ShardIndex(const KeyType& key) const;
+  ShardType& Shard(const KeyType& key);
+
+  const boost::filesystem::path kDiskBuffer_;
+  const bool kShouldRemoveRoot_;
+  std::vector<std::unique_ptr<ShardType>> shards_;
+  std::mutex limits_mutex_;
+  MemoryUsage max_memory_usage_;
+  DiskUsage max_disk_usage_;
+};
+
+// ==================== Implementation =============================================================
+template <typename Key>
+ShardedDataBuffer<Key>::ShardedDataBuffer(MemoryUsage max_memory_usage, DiskUsage max_disk_usage,
+                                          PopFunctor pop_functor, uint32_t shard_count,
+                                          DiskBackend disk_backend,
+                                          DiskCompression disk_compression,
+                                          uint32_t disk_writer_count)
+    : kDiskBuffer_(),
+      kShouldRemoveRoot_(false),
+      shards_(),
+      limits_mutex_(),
+      max_memory_usage_(max_memory_usage),
+      max_disk_usage_(max_disk_usage) {
+  CheckShardCount(shard_count);
+  shards_.reserve(shard_count);
+  for (uint32_t i(0); i != shard_count; ++i) {
+    shards_.emplace_back(new ShardType(MemoryUsage(Share(max_memory_usage, i, shard_count)),
+                                       DiskUsage(Share(max_disk_usage, i, shard_count)),
+                                       pop_functor, disk_backend, disk_compression,
+                                       disk_writer_count));
+  }
+}
+
+template <typename Key>
+ShardedDataBuffer<Key>::ShardedDataBuffer(MemoryUsage max_memory_usage, DiskUsage max_disk_usage,
+                                          PopFunctor pop_functor, uint32_t shard_count,
+                                          const boost::filesystem::path& disk_buffer,
+                                          bool should_remove_root, DiskBackend disk_backend,
+                                          DiskRecovery disk_recovery,
+                                          DiskCompression disk_compression,
+                                          uint32_t disk_writer_count)
+    : kDiskBuffer_(disk_buffer),
+      kShouldRemoveRoot_(should_remove_root),
+      shards_(),
+      limits_mutex_(),
+      max_memory_usage_(max_memory_usage),
+      max_disk_usage_(max_disk_usage) {
+  CheckShardCount(shard_count);
+  shards_.reserve(shard_count);
+  for (uint32_t i(0); i != shard_count; ++i) {
+    shards_.emplace_back(new ShardType(MemoryUsage(Share(max_memory_usage, i, shard_count)),
+                                       DiskUsage(Share(max_disk_usage, i, shard_count)),
+                                       pop_functor, disk_buffer / ("shard_" + std::to_string(i)),
+                                       should_remove_root, disk_backend, disk_recovery,
+                                       disk_compression, disk_writer_count));
+  }
+}
+
+template <typename Key>
+ShardedDataBuffer<Key>::~ShardedDataBuffer() {
+  shards_.clear();
+  if (kShouldRemoveRoot_) {
+    boost::system::error_code error_code;
+    boost::filesystem::remove_all(kDiskBuffer_, error_code);
+    if (error_code)
+      LOG(kWarning) << "Failed to remove " << kDiskBuffer_ << ": " << error_code.message();
+  }
+}
+
+template <typename Key>
+void ShardedDataBuffer<Key>::Store(const KeyType& key, const NonEmptyString& value) {
+  Shard(key).Store(key, value);
+}
+
+template <typename Key>
+void ShardedDataBuffer<Key>::Store(const KeyType& key, NonEmptyString&& value) {
+  Shard(key).Store(key, std::move(value));
+}
+
+template <typename Key>
+void ShardedDataBuffer<Key>::Store(const KeyType& key, SharedValue value) {
+  Shard(key).Store(key, std::move(value));
+}
+
+template <typename Key>
+NonEmptyString ShardedDataBuffer<Key>::Get(const KeyType& key) {
+  return Shard(key).Get(key);
+}
+
+template <typename Key>
+typename ShardedDataBuffer<Key>::SharedValue ShardedDataBuffer<Key>::GetShared(
+    const KeyType& key) {
+  return Shard(key).GetShared(key);
+}
+
+template <typename Key>
+bool ShardedDataBuffer<Key>::TryStore(const KeyType& key, const NonEmptyString& value,
+                                      std::chrono::steady_clock::time_point deadline) {
+  return Shard(key).TryStore(key, value, deadline);
+}
+
+template <typename Key>
+bool ShardedDataBuffer<Key>::TryStore(const KeyType& key, SharedValue value,
+                                      std::chrono::steady_clock::time_point deadline) {
+  return Shard(key).TryStore(key, std::move(value), deadline);
+}
+
+template <typename Key>
+std::future<void> ShardedDataBuffer<Key>::AsyncStore(AsioService& asio_service,
+                                                     const KeyType& key, SharedValue value) {
+  return Shard(key).AsyncStore(asio_service, key, std::move(value));
+}
+
+template <typename Key>
+std::future<typename ShardedDataBuffer<Key>::SharedValue> ShardedDataBuffer<Key>::AsyncGet(
+    AsioService& asio_service, const KeyType& key) {
+  return Shard(key).AsyncGet(asio_service, key);
+}
+
+template <typename Key>
+void ShardedDataBuffer<Key>::Delete(const KeyType& key) {
+  Shard(key).Delete(key);
+}
+
+template <typename Key>
+void ShardedDataBuffer<Key>::Delete(std::function<bool(const KeyType&)> predicate) {
+  for (auto& shard : shards_)
+    shard->Delete(predicate);
+}
+
+template <typename Key>
+void ShardedDataBuffer<Key>::StoreBatch(std::vector<std::pair<KeyType, NonEmptyString>> elements) {
+  std::vector<std::vector<std::pair<KeyType, NonEmptyString>>> batches(shards_.size());
+  for (auto& element : elements)
+    batches[ShardIndex(element.first)].push_back(std::move(element));
+  for (size_t i(0); i != shards_.size(); ++i) {
+    if (!batches[i].empty())
+      shards_[i]->StoreBatch(std::move(batches[i]));
+  }
+}
+
+template <typename Key>
+void ShardedDataBuffer<Key>::StoreBatch(std::vector<std::pair<KeyType, SharedValue>> elements) {
+  std::vector<std::vector<std::pair<KeyType, SharedValue>>> batches(shards_.size());
+  for (auto& element : elements)
+    batches[ShardIndex(element.first)].push_back(std::move(element));
+  for (size_t i(0); i != shards_.size(); ++i) {
+    if (!batches[i].empty())
+      shards_[i]->StoreBatch(std::move(batches[i]));
+  }
+}
+
+template <typename Key>
+std::vector<typename ShardedDataBuffer<Key>::SharedValue> ShardedDataBuffer<Key>::GetBatch(
+    const std::vector<KeyType>& keys) {
+  std::vector<std::vector<KeyType>> batches(shards_.size());
+  std::vector<std::vector<size_t>> positions(shards_.size());
+  for (size_t i(0); i != keys.size(); ++i) {
+    size_t shard_index(ShardIndex(keys[i]));
+    batches[shard_index].push_back(keys[i]);
+    positions[shard_index].push_back(i);
+  }
+  std::vector<SharedValue> values(keys.size());
+  for (size_t i(0); i != shards_.size(); ++i) {
+    if (batches[i].empty())
+      continue;
+    auto shard_values(shards_[i]->GetBatch(batches[i]));
+    for (size_t j(0); j != shard_values.size(); ++j)
+      values[positions[i][j]] = std::move(shard_values[j]);
+  }
+  return values;
+}
+
+template <typename Key>
+void ShardedDataBuffer<Key>::DeleteBatch(const std::vector<KeyType>& keys) {
+  std::vector<std::vector<KeyType>> batches(shards_.size());
+  for (const auto& key : keys)
+    batches[ShardIndex(key)].push_back(key);
+  // Delete from every shard before reporting the first failure.
+  std::exception_ptr error;
+  for (size_t i(0); i != shards_.size(); ++i) {
+    if (batches[i].empty())
+      continue;
+    try {
+      shards_[i]->DeleteBatch(batches[i]);
+    } catch (...) {
+      if (!error)
+        error = std::current_exception();
+    }
+  }
+  if (error)
+    std::rethrow_exception(error);
+}
+
+template <typename Key>
+void ShardedDataBuffer<Key>::SetMaxMemoryUsage(MemoryUsage max_memory_usage) {
+  std::lock_guard<std::mutex> lock(limits_mutex_);
+  if (max_memory_usage > max_disk_usage_) {
+    LOG(kError) << "Max memory usage must be <= max disk usage.";
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::invalid_parameter));
+  }
+  // Since the shares are allocated the same way for memory and disk, each shard's memory share
+  // can't exceed its disk share.
+  for (size_t i(0); i != shards_.size(); ++i)
+    shards_[i]->SetMaxMemoryUsage(MemoryUsage(Share(max_memory_usage, i, shards_.size())));
+  max_memory_usage_ = max_memory_usage;
+}
+
+template <typename Key>
+void ShardedDataBuffer<Key>::SetMaxDiskUsage(DiskUsage max_disk_usage) {
+  std::lock_guard<std::mutex> lock(limits_mutex_);
+  if (max_memory_usage_ > max_disk_usage) {
+    LOG(kError) << "Max memory usage must be <= max disk usage.";
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::invalid_parameter));
+  }
+  for (size_t i(0); i != shards_.size(); ++i)
+    shards_[i]->SetMaxDiskUsage(DiskUsage(Share(max_disk_usage, i, shards_.size())));
+  max_disk_usage_ = max_disk_usage;
+}
+
+template <typename Key>
+void ShardedDataBuffer<Key>::SetReadPromotion(ReadPromotion read_promotion) {
+  for (auto& shard : shards_)
+    shard->SetReadPromotion(read_promotion);
+}
+
+template <typename Key>
+DataBufferHitStatistics ShardedDataBuffer<Key>::GetHitStatistics() const {
+  DataBufferHitStatistics total;
+  for (const auto& shard : shards_) {
+    DataBufferHitStatistics statistics(shard->GetHitStatistics());
+    total.memory_hits += statistics.memory_hits;
+    total.disk_hits += statistics.disk_hits;
+    total.misses += statistics.misses;
+    total.promotions += statistics.promotions;
+    total.rejected_promotions += statistics.rejected_promotions;
+  }
+  return total;
+}
+
+template <typename Key>
+DataBufferStatistics ShardedDataBuffer<Key>::GetStatistics() {
+  DataBufferStatistics total;
+  total.hits = GetHitStatistics();
+  for (const auto& shard : shards_) {
+    DataBufferStatistics statistics(shard->GetStatistics());
+    total.memory_bytes += statistics.memory_bytes;
+    total.memory_values += statistics.memory_values;
+    total.disk_bytes += statistics.disk_bytes;
+    total.disk_values += statistics.disk_values;
+    total.spill_queue_bytes += statistics.spill_queue_bytes;
+    total.spill_queue_values += statistics.spill_queue_values;
+    total.pops += statistics.pops;
+    total.memory_wait_time += statistics.memory_wait_time;
+    total.disk_wait_time += statistics.disk_wait_time;
+    total.disk_write_latency += statistics.disk_write_latency;
+    total.disk_read_latency += statistics.disk_read_latency;
+  }
+  return total;
+}
+
+template <typename Key>
+void ShardedDataBuffer<Key>::CheckShardCount(uint32_t shard_count) {
+  if (shard_count == 0) {
+    LOG(kError) << "ShardedDataBuffer needs at least one shard.";
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::invalid_parameter));
+  }
+}
+
+template <typename Key>
+uint64_t ShardedDataBuffer<Key>::Share(uint64_t total, size_t index, size_t shard_count) {
+  return total / shard_count + (index < total % shard_count ? 1 : 0);
+}
+
+template <typename Key>
+size_t ShardedDataBuffer<Key>::ShardIndex(const KeyType& key) const {
+  return detail::DataBufferKeyHash<KeyType>()(key) % shards_.size();
+}
+
+template <typename Key>
+typename ShardedDataBuffer<Key>::ShardType& ShardedDataBuffer<Key>::Shard(const KeyType& key) {
+  return *shards_[ShardIndex(key)];
+}
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_COMMON_SHARDED_DATA_BUFFER_H_
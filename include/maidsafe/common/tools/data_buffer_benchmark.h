@@ -0,0 +1,95 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_COMMON_TOOLS_DATA_BUFFER_BENCHMARK_H_
+#define MAIDSAFE_COMMON_TOOLS_DATA_BUFFER_BENCHMARK_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "boost/filesystem/path.hpp"
+
+#include "maidsafe/common/data_buffer.h"
+#include "maidsafe/common/latency_histogram.h"
+#include "maidsafe/common/log.h"
+#include "maidsafe/common/types.h"
+
+namespace maidsafe {
+
+namespace benchmark {
+
+enum class ValueSizeDistribution { kFixed, kUniform, kLogUniform };
+
+// A mix of Store and GetShared calls made against a single DataBuffer by 'thread_count' threads.
+// Every key is stored once before the timed run starts.  Keys are chosen with Zipfian popularity
+// (an exponent of 0 gives uniform popularity), and each key has a fixed value size drawn from the
+// given distribution between min_value_size and max_value_size (kFixed always uses the max).  The
+// memory and disk budgets are fractions of the total size of all values.
+struct DataBufferWorkload {
+  DataBufferWorkload();
+  std::string name;
+  uint64_t operation_count, key_count;
+  uint32_t thread_count, seed;
+  double read_fraction, zipf_exponent;
+  ValueSizeDistribution value_size_distribution;
+  uint32_t min_value_size, max_value_size;
+  double memory_budget_ratio, disk_budget_ratio;
+  DiskBackend disk_backend;
+  DiskCompression disk_compression;
+  ReadPromotion read_promotion;
+  uint32_t disk_writer_count;
+};
+
+struct DataBufferWorkloadResult {
+  DataBufferWorkloadResult();
+  double elapsed_seconds;
+  uint64_t reads, writes, read_misses, total_value_bytes;
+  LatencyHistogram::Snapshot read_latency, write_latency;
+  // The DataBuffer's own statistics, covering only the timed run.
+  DataBufferStatistics statistics;
+};
+
+class DataBufferBenchmark {
+ public:
+  DataBufferBenchmark();
+  void Run();
+
+  // Throws if the workload is invalid (e.g. a value wouldn't fit in the disk budget).  The
+  // DataBuffer is created in a new folder inside 'root', which is removed afterwards.
+  static DataBufferWorkloadResult RunWorkload(const DataBufferWorkload& workload,
+                                              const boost::filesystem::path& root);
+  // Returns a single-line JSON object describing the workload and its result.
+  static std::string ToJson(const DataBufferWorkload& workload,
+                            const DataBufferWorkloadResult& result);
+
+ private:
+  // Stores, gets then deletes 'element_count' small values, all of which fit in the memory buffer,
+  // and reports the mean latency of each operation.
+  void ElementCountScaling(size_t element_count);
+
+  boost::filesystem::path data_buffer_path;
+  std::vector<std::string> keys;
+  std::vector<NonEmptyString> values;
+};
+
+}  // namespace benchmark
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_COMMON_TOOLS_DATA_BUFFER_BENCHMARK_H_
@@ -20,6 +20,7 @@
 #define MAIDSAFE_COMMON_TYPES_H_
 
 #include <cstdint>
+#include <cstring>
 #include <functional>
 #include <memory>
 #include <string>
@@ -35,6 +36,18 @@ using NonEmptyString = detail::BoundedString<1>;
 using Identity = detail::BoundedString<64, 64>;
 using byte = unsigned char;
 
+namespace detail {
+
+// Returns the first machine word of 'data' as a hash.  Only suitable for data which is already
+// uniformly distributed (such as an Identity) and at least sizeof(size_t) bytes long.
+inline size_t HashPrefixWord(const void* data) {
+  size_t word;
+  std::memcpy(&word, data, sizeof(word));
+  return word;
+}
+
+}  // namespace detail
+
 using MemoryUsage = TaggedValue<uint64_t, struct memory_usage_tag>;
 using DiskUsage = TaggedValue<uint64_t, struct disk_usage_tag>;
 
@@ -70,4 +83,17 @@ typedef uint16_t Port;
 
 }  // namespace maidsafe
 
+namespace std {
+
+// All uninitialised Identities hash to 0.
+template <>
+struct hash<maidsafe::Identity> {
+  size_t operator()(const maidsafe::Identity& identity) const {
+    return identity.IsInitialised() ? maidsafe::detail::HashPrefixWord(identity.string().data())
+                                    : 0;
+  }
+};
+
+}  // namespace std
+
 #endif  // MAIDSAFE_COMMON_TYPES_H_
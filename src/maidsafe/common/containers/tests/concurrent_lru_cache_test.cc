@@ -0,0 +1,262 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/common/containers/concurrent_lru_cache.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "maidsafe/common/test.h"
+#include "maidsafe/common/utils.h"
+
+namespace maidsafe {
+
+namespace test {
+
+TEST(ConcurrentLruCacheTest, BEH_Construct) {
+  typedef ConcurrentLruCache<int, int> Cache;
+  EXPECT_THROW(Cache(10, 0), std::exception);
+  Cache cache(100, 8);
+  EXPECT_EQ(8U, cache.shard_count());
+  Cache small_cache(3, 8);
+  EXPECT_EQ(3U, small_cache.shard_count());
+  Cache time_cache(std::chrono::seconds(1));
+  EXPECT_EQ(Cache::kDefaultShardCount, time_cache.shard_count());
+}
+
+TEST(ConcurrentLruCacheTest, BEH_ZeroCapacity) {
+  // As for LruCache and HashedLruCache, a cache which can never hold anything is an error rather
+  // than silently dropping every Add.
+  typedef ConcurrentLruCache<int, int> Cache;
+  EXPECT_THROW(Cache(0), std::exception);
+  EXPECT_THROW(Cache(0, std::chrono::seconds(1), 1), std::exception);
+  try {
+    Cache cache(0, 1);
+    FAIL() << "Constructing with capacity 0 should throw";
+  }
+  catch (const maidsafe_error& error) {
+    EXPECT_EQ(MakeError(CommonErrors::cannot_exceed_limit).code(), error.code());
+  }
+  Cache cache(1, 1);
+  cache.Add(0, 0);
+  EXPECT_TRUE(cache.Check(0));
+}
+
+TEST(ConcurrentLruCacheTest, BEH_SizeOnlyTest) {
+  const size_t kSize(100);
+  ConcurrentLruCache<int, int> cache(kSize, 4);
+
+  for (int i(0); i < 10000; ++i) {
+    cache.Add(i, i);
+    EXPECT_GE(kSize, cache.size());
+  }
+  // Every shard should be full.
+  EXPECT_EQ(kSize, cache.size());
+  for (int i(9990); i < 10000; ++i) {
+    ASSERT_TRUE(cache.Get(i).valid());
+    EXPECT_EQ(i, cache.Get(i).value());
+  }
+
+  // Adding an existing key leaves the cache unchanged.
+  cache.Add(9999, 0);
+  EXPECT_EQ(9999, cache.Get(9999).value());
+}
+
+TEST(ConcurrentLruCacheTest, BEH_RecencyTest) {
+  // With a single shard, accessed entries should be kept in preference to unaccessed ones.
+  ConcurrentLruCache<std::string, std::string> cache(3, 1);
+  cache.Add("a", "1");
+  cache.Add("b", "2");
+  cache.Add("c", "3");
+  EXPECT_TRUE(cache.Get("a").valid());
+  cache.Add("d", "4");
+  EXPECT_FALSE(cache.Check("b"));
+  EXPECT_TRUE(cache.Check("a"));
+  cache.Add("e", "5");
+  EXPECT_FALSE(cache.Check("c"));
+  EXPECT_TRUE(cache.Check("a"));
+
+  // Check doesn't count as a use, and "a"'s earlier access has been consumed.
+  cache.Add("f", "6");
+  EXPECT_FALSE(cache.Check("a"));
+  EXPECT_TRUE(cache.Check("d"));
+  EXPECT_TRUE(cache.Check("e"));
+  EXPECT_TRUE(cache.Check("f"));
+}
+
+TEST(ConcurrentLruCacheTest, BEH_DeleteTest) {
+  ConcurrentLruCache<int, int> cache(20, 4);
+  for (int i(0); i < 20; ++i)
+    cache.Add(i, i);
+  for (int i(0); i < 20; ++i) {
+    cache.Delete(i);
+    EXPECT_FALSE(cache.Check(i));
+    EXPECT_FALSE(cache.Get(i).valid());
+  }
+  cache.Delete(0);
+  EXPECT_EQ(0U, cache.size());
+}
+
+TEST(ConcurrentLruCacheTest, BEH_TimeAndSizeTest) {
+  std::chrono::milliseconds time(100);
+  ConcurrentLruCache<int, int> cache(10, time, 1);
+
+  for (int i(0); i < 1000; ++i) {
+    cache.Add(i, i);
+    EXPECT_EQ(std::min(static_cast<size_t>(i + 1), size_t(10)), cache.size());
+  }
+  std::this_thread::sleep_for(time);
+  cache.Add(1, 1);
+  EXPECT_EQ(1U, cache.size());
+}
+
+TEST(ConcurrentLruCacheTest, BEH_GetRespectsTimeToLive) {
+  std::chrono::milliseconds time(100);
+  ConcurrentLruCache<int, int> cache(time, 1);
+  cache.Add(0, 0);
+  std::this_thread::sleep_for(time / 2);
+  cache.Add(1, 1);
+  EXPECT_TRUE(cache.Get(0).valid());
+  std::this_thread::sleep_for(time / 2 + std::chrono::milliseconds(10));
+
+  EXPECT_FALSE(cache.Check(0));
+  EXPECT_FALSE(cache.Get(0).valid());
+  EXPECT_TRUE(cache.Get(1).valid());
+  EXPECT_EQ(2U, cache.size());
+  cache.Delete(1);
+  EXPECT_EQ(0U, cache.size());
+}
+
+TEST(ConcurrentLruCacheTest, BEH_GetOrCompute) {
+  ConcurrentLruCache<int, std::string> cache(10, 2);
+  int calls(0);
+  auto loader([&calls] {
+    ++calls;
+    return std::string("one");
+  });
+  EXPECT_EQ("one", cache.GetOrCompute(1, loader));
+  EXPECT_EQ("one", cache.GetOrCompute(1, loader));
+  EXPECT_EQ(1, calls);
+  EXPECT_TRUE(cache.Check(1));
+
+  // A failed load is not cached.
+  EXPECT_THROW(cache.GetOrCompute(2, []() -> std::string { throw std::runtime_error("fail"); }),
+               std::runtime_error);
+  EXPECT_FALSE(cache.Check(2));
+  EXPECT_EQ("two", cache.GetOrCompute(2, [] { return std::string("two"); }));
+}
+
+TEST(ConcurrentLruCacheTest, FUNC_GetOrComputeCoalesces) {
+  const int kThreadCount(8);
+  ConcurrentLruCache<int, int> cache(100, 4);
+  std::atomic<int> calls(0);
+  auto slow_loader([&calls] {
+    ++calls;
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    return 42;
+  });
+  std::vector<std::future<int>> callers;
+  for (int thread(0); thread != kThreadCount; ++thread) {
+    callers.push_back(
+        std::async(std::launch::async, [&] { return cache.GetOrCompute(1, slow_loader); }));
+  }
+  for (auto& caller : callers)
+    EXPECT_EQ(42, caller.get());
+  EXPECT_EQ(1, calls);
+
+  // A failure is seen by all callers waiting on the load, and isn't cached.
+  auto failing_loader([]() -> int {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    throw std::runtime_error("fail");
+  });
+  callers.clear();
+  for (int thread(0); thread != kThreadCount; ++thread) {
+    callers.push_back(
+        std::async(std::launch::async, [&] { return cache.GetOrCompute(2, failing_loader); }));
+  }
+  for (auto& caller : callers)
+    EXPECT_THROW(caller.get(), std::runtime_error);
+  EXPECT_FALSE(cache.Check(2));
+}
+
+TEST(ConcurrentLruCacheTest, FUNC_DeleteDuringGetOrCompute) {
+  ConcurrentLruCache<int, int> cache(100, 4);
+  std::promise<void> load_started, release_load;
+  auto release(release_load.get_future().share());
+  auto slow_loader([&] {
+    load_started.set_value();
+    release.wait();
+    return 42;
+  });
+  auto caller(std::async(std::launch::async, [&] { return cache.GetOrCompute(1, slow_loader); }));
+  load_started.get_future().wait();
+  cache.Delete(1);
+
+  // A load started after the Delete mustn't wait on, or be overwritten by, the detached one.
+  EXPECT_EQ(7, cache.GetOrCompute(1, [] { return 7; }));
+  cache.Delete(1);
+  release_load.set_value();
+  EXPECT_EQ(42, caller.get());
+  EXPECT_FALSE(cache.Check(1));
+  EXPECT_EQ(0U, cache.size());
+  EXPECT_EQ(9, cache.GetOrCompute(1, [] { return 9; }));
+  EXPECT_TRUE(cache.Check(1));
+}
+
+TEST(ConcurrentLruCacheTest, FUNC_ConcurrentAccess) {
+  const int kThreadCount(8), kOperationsPerThread(20000), kKeyRange(1000);
+  const size_t kSize(256);
+  ConcurrentLruCache<int, std::string> cache(kSize, 8);
+
+  std::vector<std::future<void>> workers;
+  for (int thread(0); thread != kThreadCount; ++thread) {
+    workers.push_back(std::async(std::launch::async, [&, thread] {
+      for (int i(0); i != kOperationsPerThread; ++i) {
+        int key((i * (thread + 1) * 7919) % kKeyRange);
+        switch (i % 8) {
+          case 0:
+            cache.Delete(key);
+            break;
+          case 1:
+          case 2:
+            cache.Add(key, std::to_string(key));
+            break;
+          default: {
+            auto value(cache.Get(key));
+            if (value.valid()) {
+              ASSERT_EQ(std::to_string(key), value.value());
+            }
+          }
+        }
+      }
+    }));
+  }
+  for (auto& worker : workers)
+    EXPECT_NO_THROW(worker.get());
+  EXPECT_GE(kSize, cache.size());
+}
+
+}  // namespace test
+
+}  // namespace maidsafe
@@ -0,0 +1,169 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/common/containers/flat_hash_map.h"
+
+#include <string>
+#include <unordered_map>
+
+#include "maidsafe/common/node_id.h"
+#include "maidsafe/common/test.h"
+#include "maidsafe/common/types.h"
+#include "maidsafe/common/utils.h"
+
+namespace maidsafe {
+
+namespace test {
+
+namespace {
+
+// Maps many keys to the same few hashes, so that probe sequences are long and overlap.
+struct CollidingHash {
+  size_t operator()(int key) const { return static_cast<size_t>(key % 7); }
+};
+
+// Distinct hashes which all share their low 16 bits, as do the keys of one shard when the shard is
+// chosen by hash modulo a power-of-two shard count.
+struct SharedLowBitsHash {
+  size_t operator()(int key) const { return static_cast<size_t>(key) << 16; }
+};
+
+}  // unnamed namespace
+
+TEST(FlatHashMapTest, BEH_MapBasics) {
+  FlatHashMap<std::string, int> map;
+  EXPECT_TRUE(map.empty());
+  EXPECT_TRUE(map.find("a") == map.end());
+  EXPECT_EQ(0U, map.erase("a"));
+
+  EXPECT_TRUE(map.insert(std::make_pair(std::string("a"), 1)).second);
+  EXPECT_TRUE(map.emplace("b", 2).second);
+  auto result(map.insert(std::make_pair(std::string("a"), 3)));
+  EXPECT_FALSE(result.second);
+  EXPECT_EQ(1, result.first->second);
+  map["c"] = 3;
+  ++map["c"];
+  EXPECT_EQ(3U, map.size());
+  EXPECT_EQ(1, map.at("a"));
+  EXPECT_EQ(4, map.at("c"));
+  EXPECT_THROW(map.at("d"), common_error);
+  EXPECT_EQ(1U, map.count("b"));
+  EXPECT_EQ(0U, map.count("d"));
+
+  EXPECT_EQ(1U, map.erase("a"));
+  EXPECT_EQ(0U, map.count("a"));
+  EXPECT_EQ(2, map.at("b"));
+  EXPECT_EQ(4, map.at("c"));
+
+  FlatHashMap<std::string, int> other;
+  other.swap(map);
+  EXPECT_TRUE(map.empty());
+  EXPECT_EQ(2U, other.size());
+  other.clear();
+  EXPECT_TRUE(other.empty());
+  other["a"] = 1;
+  EXPECT_EQ(1, other.at("a"));
+}
+
+TEST(FlatHashMapTest, BEH_SetBasics) {
+  FlatHashSet<int> set(100);
+  for (int i(0); i != 100; ++i)
+    EXPECT_TRUE(set.insert(i).second);
+  EXPECT_FALSE(set.insert(50).second);
+  EXPECT_EQ(100U, set.size());
+  for (int i(0); i != 100; i += 2)
+    EXPECT_EQ(1U, set.erase(i));
+  for (int i(0); i != 100; ++i)
+    EXPECT_EQ(i % 2 == 0 ? 0U : 1U, set.count(i));
+}
+
+TEST(FlatHashMapTest, BEH_EraseWhileIterating) {
+  FlatHashMap<int, int, CollidingHash> map;
+  for (int i(0); i != 1000; ++i)
+    map[i] = i;
+  for (auto itr(map.begin()); itr != map.end();) {
+    if (itr->first % 3 == 0)
+      itr = map.erase(itr);
+    else
+      ++itr;
+  }
+  EXPECT_EQ(666U, map.size());
+  for (int i(0); i != 1000; ++i) {
+    ASSERT_EQ(i % 3 == 0 ? 0U : 1U, map.count(i));
+  }
+}
+
+TEST(FlatHashMapTest, BEH_MatchesUnorderedMap) {
+  FlatHashMap<int, int, CollidingHash> map;
+  std::unordered_map<int, int> expected;
+  for (int i(0); i != 50000; ++i) {
+    int key(static_cast<int>(RandomUint32() % 2000));
+    switch (RandomUint32() % 3) {
+      case 0:
+        ASSERT_EQ(expected.erase(key), map.erase(key));
+        break;
+      case 1:
+        ASSERT_EQ(expected.insert(std::make_pair(key, i)).second,
+                  map.insert(std::make_pair(key, i)).second);
+        break;
+      default: {
+        auto itr(map.find(key));
+        auto expected_itr(expected.find(key));
+        ASSERT_EQ(expected_itr == expected.end(), itr == map.end());
+        if (itr != map.end()) {
+          ASSERT_EQ(expected_itr->second, itr->second);
+        }
+      }
+    }
+    ASSERT_EQ(expected.size(), map.size());
+  }
+  for (const auto& element : map)
+    ASSERT_EQ(expected.at(element.first), element.second);
+}
+
+TEST(FlatHashMapTest, BEH_SharedLowHashBits) {
+  FlatHashSet<int, SharedLowBitsHash> set;
+  for (int i(0); i != 50000; ++i)
+    ASSERT_TRUE(set.insert(i).second);
+  for (int i(0); i < 50000; i += 2)
+    ASSERT_EQ(1U, set.erase(i));
+  for (int i(0); i != 50000; ++i)
+    ASSERT_EQ(i % 2 == 0 ? 0U : 1U, set.count(i));
+}
+
+TEST(FlatHashMapTest, BEH_IdKeys) {
+  FlatHashMap<NodeId, int> node_ids;
+  for (int i(0); i != 1000; ++i)
+    node_ids[NodeId(RandomString(NodeId::kSize))] = i;
+  EXPECT_EQ(1000U, node_ids.size());
+  for (const auto& element : node_ids)
+    EXPECT_EQ(element.second, node_ids.at(element.first));
+  EXPECT_EQ(std::hash<NodeId>()(NodeId()), std::hash<NodeId>()(NodeId()));
+
+  FlatHashSet<Identity> identities;
+  Identity identity(RandomString(64));
+  EXPECT_TRUE(identities.insert(identity).second);
+  EXPECT_FALSE(identities.insert(Identity(identity.string())).second);
+  EXPECT_TRUE(identities.insert(Identity()).second);
+  EXPECT_EQ(1U, identities.count(Identity()));
+  EXPECT_EQ(2U, identities.size());
+}
+
+}  // namespace test
+
+}  // namespace maidsafe
@@ -0,0 +1,60 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/common/containers/frequency_sketch.h"
+
+#include <string>
+
+#include "maidsafe/common/test.h"
+
+namespace maidsafe {
+
+namespace test {
+
+TEST(FrequencySketchTest, BEH_IncrementAndEstimate) {
+  FrequencySketch<std::string> sketch(1000);
+  EXPECT_EQ(1024U, sketch.width());
+  EXPECT_EQ(0, sketch.Estimate("a"));
+  for (int i(0); i != 5; ++i)
+    sketch.Increment("a");
+  sketch.Increment("b");
+  EXPECT_EQ(5, sketch.Estimate("a"));
+  EXPECT_EQ(1, sketch.Estimate("b"));
+
+  for (int i(0); i != 100; ++i)
+    sketch.Increment("a");
+  EXPECT_EQ(FrequencySketch<std::string>::kMaxFrequency, sketch.Estimate("a"));
+
+  sketch.Clear();
+  EXPECT_EQ(0, sketch.Estimate("a"));
+}
+
+TEST(FrequencySketchTest, BEH_Ageing) {
+  FrequencySketch<int> sketch(16);
+  for (int i(0); i != 8; ++i)
+    sketch.Increment(-1);
+  EXPECT_EQ(8, sketch.Estimate(-1));
+  // 10 * width increments in total triggers halving of every counter.
+  for (int i(0); i != 10 * 16 - 8; ++i)
+    sketch.Increment(i % 2);
+  EXPECT_EQ(4, sketch.Estimate(-1));
+}
+
+}  // namespace test
+
+}  // namespace maidsafe
@@ -0,0 +1,286 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/common/containers/hashed_lru_cache.h"
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "maidsafe/common/containers/lru_cache.h"
+#include "maidsafe/common/test.h"
+#include "maidsafe/common/utils.h"
+
+namespace maidsafe {
+
+namespace test {
+
+TEST(HashedLruCacheTest, BEH_SizeOnlyTest) {
+  auto size(10);
+  HashedLruCache<int, int> cache(size);
+
+  for (int i(0); i < 10; ++i) {
+    EXPECT_EQ(cache.size(), i);
+    cache.Add(i, i);
+    EXPECT_EQ(cache.size(), i + 1);
+  }
+
+  for (int i(10); i < 1000; ++i) {
+    EXPECT_EQ(cache.size(), size);
+    cache.Add(i, i);
+    EXPECT_EQ(cache.size(), size);
+  }
+
+  for (int i(0); i < 990; ++i)
+    EXPECT_FALSE(cache.Check(i));
+  for (int i(990); i < 1000; ++i) {
+    EXPECT_TRUE(cache.Check(i));
+    EXPECT_TRUE(cache.Get(i).valid());
+    EXPECT_EQ(cache.Get(i).value(), i);
+  }
+}
+
+TEST(HashedLruCacheTest, BEH_DeleteTest) {
+  auto size(10);
+  HashedLruCache<int, int> cache(size);
+
+  for (int i(0); i < size * 2; ++i)
+    cache.Add(i, i);
+  EXPECT_EQ(cache.size(), size);
+
+  int random_index(RandomUint32() % size);
+  for (int i(0); i < size; ++i) {
+    auto index(((i + random_index) % size) + size);
+    cache.Delete(index);
+    EXPECT_FALSE(cache.Check(index));
+    EXPECT_FALSE(cache.Get(index).valid());
+    EXPECT_EQ(cache.size(), size - i - 1);
+  }
+  // Deleting a missing key is a no-op
+  cache.Delete(0);
+  EXPECT_EQ(cache.size(), 0);
+
+  // Freed nodes are reused
+  for (int i(0); i < size; ++i)
+    cache.Add(i, i * 2);
+  for (int i(0); i < size; ++i)
+    EXPECT_EQ(cache.Get(i).value(), i * 2);
+}
+
+TEST(HashedLruCacheTest, BEH_RecencyTest) {
+  HashedLruCache<std::string, std::string> cache(3);
+  cache.Add("a", "1");
+  cache.Add("b", "2");
+  cache.Add("c", "3");
+
+  // Adding an existing key leaves the cache unchanged
+  cache.Add("a", "4");
+  EXPECT_EQ(cache.size(), 3U);
+  EXPECT_EQ(cache.Get("a").value(), "1");
+
+  // "a" is now the most recently used, so "b" should be evicted next, then "c"
+  cache.Add("d", "4");
+  EXPECT_FALSE(cache.Check("b"));
+  EXPECT_TRUE(cache.Check("a"));
+  cache.Add("e", "5");
+  EXPECT_FALSE(cache.Check("c"));
+  EXPECT_TRUE(cache.Check("a"));
+  EXPECT_TRUE(cache.Check("d"));
+  EXPECT_TRUE(cache.Check("e"));
+
+  // Check doesn't count as a use
+  cache.Add("f", "6");
+  EXPECT_FALSE(cache.Check("a"));
+}
+
+TEST(HashedLruCacheTest, BEH_TimeOnlyTest) {
+  std::chrono::milliseconds time(100);
+  HashedLruCache<int, int> cache(time);
+
+  for (int i(0); i < 10; ++i) {
+    EXPECT_EQ(cache.size(), i);
+    cache.Add(i, i);
+    EXPECT_EQ(cache.size(), i + 1);
+  }
+  std::this_thread::sleep_for(time);
+  cache.Add(11, 11);
+
+  EXPECT_EQ(cache.size(), 1);
+
+  for (int i(0); i < 8; ++i) {
+    EXPECT_EQ(cache.size(), i + 1);
+    cache.Add(i, i);
+    EXPECT_EQ(cache.size(), i + 2);
+  }
+}
+
+TEST(HashedLruCacheTest, BEH_GetRespectsTimeToLive) {
+  std::chrono::milliseconds time(100);
+  HashedLruCache<int, int> cache(time);
+  cache.Add(0, 0);
+  std::this_thread::sleep_for(time / 2);
+  cache.Add(1, 1);
+  EXPECT_TRUE(cache.Get(0).valid());
+  std::this_thread::sleep_for(time / 2 + std::chrono::milliseconds(10));
+
+  EXPECT_FALSE(cache.Check(0));
+  EXPECT_TRUE(cache.Check(1));
+  EXPECT_FALSE(cache.Get(0).valid());
+  EXPECT_EQ(cache.size(), 1);
+  std::this_thread::sleep_for(time / 2);
+  cache.RemoveExpired();
+  EXPECT_EQ(cache.size(), 0);
+}
+
+TEST(HashedLruCacheTest, BEH_TimeAndSizeTest) {
+  std::chrono::milliseconds time(100);
+  auto size(10);
+  HashedLruCache<int, int> cache(size, time);
+
+  for (int i(0); i < 1000; ++i) {
+    cache.Add(i, i);
+    if (i < size)
+      EXPECT_EQ(cache.size(), i + 1);
+    else
+      EXPECT_EQ(cache.size(), size);
+  }
+  std::this_thread::sleep_for(time);
+  cache.Add(1, 1);
+  EXPECT_EQ(cache.size(), 1);
+}
+
+TEST(HashedLruCacheTest, BEH_FilterTimeAndSizeTest) {
+  std::chrono::milliseconds time(100);
+  auto size(10);
+  HashedLruCache<int, void> filter(size, time);
+
+  for (int i(0); i < 1000; ++i) {
+    filter.Add(i);
+    if (i < size)
+      EXPECT_EQ(filter.size(), i + 1);
+    else
+      EXPECT_EQ(filter.size(), size);
+  }
+  EXPECT_TRUE(filter.Check(999));
+  filter.Delete(999);
+  EXPECT_FALSE(filter.Check(999));
+  std::this_thread::sleep_for(time);
+  filter.Add(1);
+  EXPECT_EQ(filter.size(), 1);
+}
+
+TEST(HashedLruCacheTest, BEH_StructKeyAndValueTest) {
+  struct Key {
+    int a;
+    std::string b;
+    bool operator==(const Key& other) const { return a == other.a && b == other.b; }
+  };
+  struct KeyHash {
+    size_t operator()(const Key& key) const {
+      return std::hash<std::string>()(key.b) ^ static_cast<size_t>(key.a);
+    }
+  };
+  HashedLruCache<Key, std::shared_ptr<const std::string>, KeyHash> cache(100);
+
+  for (int i(0); i < 200; ++i)
+    cache.Add(Key{i % 7, std::to_string(i)}, std::make_shared<const std::string>(RandomString(8)));
+  EXPECT_EQ(cache.size(), 100U);
+  EXPECT_FALSE(cache.Check(Key{99 % 7, "99"}));
+  ASSERT_TRUE(cache.Get(Key{199 % 7, "199"}).valid());
+  EXPECT_EQ(cache.Get(Key{199 % 7, "199"}).value()->size(), 8U);
+}
+
+TEST(HashedLruCacheTest, BEH_StatefulHash) {
+  // Each instance hashes differently, so lookups only work if the cache always uses its own.
+  struct SeededHash {
+    SeededHash() : seed(NextSeed()) {}
+    static size_t NextSeed() {
+      static size_t next(0);
+      return ++next;
+    }
+    size_t operator()(int key) const { return std::hash<int>()(key) * 31 + seed; }
+    size_t seed;
+  };
+  HashedLruCache<int, int, SeededHash> cache(100);
+  HashedLruCache<int, void, SeededHash> filter(100);
+  for (int i(0); i < 50; ++i) {
+    cache.Add(i, i);
+    filter.Add(i);
+  }
+  for (int i(0); i < 50; ++i) {
+    EXPECT_TRUE(cache.Check(i));
+    ASSERT_TRUE(cache.Get(i).valid());
+    EXPECT_EQ(i, cache.Get(i).value());
+    EXPECT_TRUE(filter.Check(i));
+  }
+  cache.Delete(0);
+  EXPECT_FALSE(cache.Check(0));
+}
+
+TEST(HashedLruCacheTest, BEH_ZeroCapacity) {
+  // As for LruCache, nothing can be added.
+  HashedLruCache<int, int> cache(0);
+  EXPECT_THROW(cache.Add(1, 1), common_error);
+  EXPECT_EQ(0U, cache.size());
+  HashedLruCache<int, void> filter(0);
+  EXPECT_THROW(filter.Add(1), common_error);
+  EXPECT_FALSE(filter.Check(1));
+  LruCache<int, int> expected(0);
+  EXPECT_THROW(expected.Add(1, 1), common_error);
+}
+
+TEST(HashedLruCacheTest, BEH_MatchesLruCache) {
+  // Drive both caches with the same random sequence of operations.
+  const int kCapacity(500), kKeyRange(2000);
+  LruCache<int, int> expected(kCapacity);
+  HashedLruCache<int, int> cache(kCapacity);
+
+  for (int i(0); i < 50000; ++i) {
+    int key(RandomUint32() % kKeyRange);
+    switch (RandomUint32() % 4) {
+      case 0:
+        EXPECT_EQ(expected.Check(key), cache.Check(key));
+        break;
+      case 1: {
+        auto expected_value(expected.Get(key));
+        auto value(cache.Get(key));
+        ASSERT_EQ(expected_value.valid(), value.valid());
+        if (value.valid()) {
+          EXPECT_EQ(expected_value.value(), value.value());
+        }
+        break;
+      }
+      case 2:
+        expected.Delete(key);
+        cache.Delete(key);
+        break;
+      default:
+        expected.Add(key, i);
+        cache.Add(key, i);
+        break;
+    }
+    ASSERT_EQ(expected.size(), cache.size());
+  }
+  for (int key(0); key < kKeyRange; ++key)
+    EXPECT_EQ(expected.Check(key), cache.Check(key));
+}
+
+}  // namespace test
+
+}  // namespace maidsafe
@@ -19,8 +19,12 @@
 #include "maidsafe/common/containers/lru_cache.h"
 
 #include <chrono>
+#include <string>
 #include <thread>
 
+#include "boost/filesystem/path.hpp"
+#include "cereal/types/string.hpp"
+
 #include "maidsafe/common/test.h"
 #include "maidsafe/common/node_id.h"
 #include "maidsafe/common/utils.h"
@@ -112,6 +116,124 @@ TEST(LruCacheTest, BEH_TimeOnlyTest) {
   }
 }
 
+TEST(LruCacheTest, BEH_GetRespectsTimeToLive) {
+  std::chrono::milliseconds time(100);
+  LruCache<int, int> cache(time);
+  cache.Add(0, 0);
+  std::this_thread::sleep_for(time / 2);
+  cache.Add(1, 1);
+  // Using an entry doesn't extend its life, nor does it change when it expires relative to others.
+  EXPECT_TRUE(cache.Get(0).valid());
+  std::this_thread::sleep_for(time / 2 + std::chrono::milliseconds(10));
+
+  EXPECT_FALSE(cache.Check(0));
+  EXPECT_TRUE(cache.Check(1));
+  EXPECT_EQ(cache.size(), 2);
+  EXPECT_FALSE(cache.Get(0).valid());
+  EXPECT_EQ(cache.size(), 1);
+  EXPECT_TRUE(cache.Get(1).valid());
+
+  std::this_thread::sleep_for(time / 2);
+  EXPECT_FALSE(cache.Check(1));
+  cache.RemoveExpired();
+  EXPECT_EQ(cache.size(), 0);
+
+  // An expired key can be added again.
+  LruCache<int, void> filter(time);
+  filter.Add(0);
+  std::this_thread::sleep_for(time + std::chrono::milliseconds(10));
+  EXPECT_FALSE(filter.Check(0));
+  filter.Add(0);
+  EXPECT_TRUE(filter.Check(0));
+  EXPECT_EQ(filter.size(), 1);
+  filter.Delete(0);
+  EXPECT_EQ(filter.size(), 0);
+}
+
+TEST(LruCacheTest, BEH_FindAndVisitorGet) {
+  LruCache<int, std::string> cache(2);
+  cache.Add(0, "zero");
+  cache.Add(1, "one");
+  EXPECT_EQ(nullptr, cache.Find(2));
+  EXPECT_FALSE(cache.Get(2, [](const std::string&) { FAIL() << "Visited a missing key."; }));
+
+  // Both give access to the held value itself, and count as a use of the entry.
+  const std::string* zero(cache.Find(0));
+  ASSERT_NE(nullptr, zero);
+  EXPECT_EQ("zero", *zero);
+  const std::string* visited(nullptr);
+  EXPECT_TRUE(cache.Get(0, [&](const std::string& value) { visited = &value; }));
+  EXPECT_EQ(zero, visited);
+  cache.Add(2, "two");
+  EXPECT_TRUE(cache.Check(0));
+  EXPECT_FALSE(cache.Check(1));
+
+  // Both respect time_to_live.
+  std::chrono::milliseconds time(50);
+  LruCache<int, std::string> timed_cache(time);
+  timed_cache.Add(0, "zero");
+  std::this_thread::sleep_for(time + std::chrono::milliseconds(10));
+  EXPECT_EQ(nullptr, timed_cache.Find(0));
+  EXPECT_FALSE(timed_cache.Get(0, [](const std::string&) {}));
+}
+
+TEST(LruCacheTest, BEH_SnapshotTest) {
+  TestPath test_path(CreateTestPath("MaidSafe_TestLruCache"));
+  const boost::filesystem::path snapshot(*test_path / "snapshot");
+  {
+    LruCache<int, std::string> cache(3);
+    for (int i(0); i < 3; ++i)
+      cache.Add(i, std::to_string(i));
+    EXPECT_TRUE(cache.Get(0).valid());
+    cache.SaveSnapshot(snapshot);
+  }
+
+  // Relative recency is restored, so 1 is the least recently used.
+  LruCache<int, std::string> cache(3);
+  cache.LoadSnapshot(snapshot);
+  EXPECT_EQ(cache.size(), 3);
+  ASSERT_TRUE(cache.Get(2).valid());
+  EXPECT_EQ("2", cache.Get(2).value());
+  cache.Add(3, "3");
+  EXPECT_FALSE(cache.Check(1));
+  EXPECT_TRUE(cache.Check(0));
+
+  // A smaller cache keeps the most recently used entries.
+  LruCache<int, std::string> small_cache(2);
+  small_cache.LoadSnapshot(snapshot);
+  EXPECT_EQ(small_cache.size(), 2);
+  EXPECT_TRUE(small_cache.Check(2));
+  EXPECT_TRUE(small_cache.Check(0));
+
+  EXPECT_THROW(cache.LoadSnapshot(*test_path / "missing"), std::exception);
+  ASSERT_TRUE(WriteFile(*test_path / "invalid", std::string(3, 'x')));
+  EXPECT_THROW(cache.LoadSnapshot(*test_path / "invalid"), std::exception);
+  EXPECT_EQ(cache.size(), 3);
+}
+
+TEST(LruCacheTest, BEH_SnapshotTimeToLiveTest) {
+  TestPath test_path(CreateTestPath("MaidSafe_TestLruCache"));
+  const boost::filesystem::path snapshot(*test_path / "snapshot");
+  std::chrono::milliseconds time(300);
+  LruCache<int, int> cache(time);
+  cache.Add(0, 0);
+  std::this_thread::sleep_for(time / 2);
+  cache.Add(1, 1);
+  // Make the older entry the most recently used, so it's loaded last.
+  EXPECT_TRUE(cache.Get(0).valid());
+  cache.SaveSnapshot(snapshot);
+
+  LruCache<int, int> loaded_cache(time);
+  loaded_cache.LoadSnapshot(snapshot);
+  EXPECT_EQ(loaded_cache.size(), 2);
+  std::this_thread::sleep_for(time * 2 / 3);
+  // Each entry keeps its remaining time_to_live, and expires in the order it was first added.
+  EXPECT_FALSE(loaded_cache.Check(0));
+  EXPECT_TRUE(loaded_cache.Check(1));
+  loaded_cache.RemoveExpired();
+  EXPECT_EQ(loaded_cache.size(), 1);
+}
+
 TEST(LruCacheTest, BEH_TimeAndSizeTest) {
   std::chrono::milliseconds time(100);
   auto size(10);
@@ -180,6 +302,56 @@ TEST(LruCacheTest, BEH_TimeAndSizeStructValueTest) {
   }
 }
 
+TEST(LruCacheTest, BEH_WeightedTest) {
+  const size_t kCapacity(1000);
+  LruCache<int, std::string> cache(
+      kCapacity, [](const int&, const std::string& value) { return value.size(); });
+
+  for (int i(0); i < 10; ++i)
+    cache.Add(i, std::string(100, 'a'));
+  EXPECT_EQ(cache.size(), 10U);
+  EXPECT_EQ(cache.total_weight(), kCapacity);
+
+  // Use 0 so that 1 becomes the least recently used.  A 350 byte value needs four entries evicted.
+  EXPECT_TRUE(cache.Get(0).valid());
+  cache.Add(10, std::string(350, 'b'));
+  EXPECT_EQ(cache.size(), 7U);
+  EXPECT_EQ(cache.total_weight(), 950U);
+  for (int i(1); i < 5; ++i)
+    EXPECT_FALSE(cache.Check(i));
+  EXPECT_TRUE(cache.Check(0));
+  EXPECT_TRUE(cache.Check(10));
+
+  // An entry which exactly fills the cache evicts everything else.
+  cache.Add(11, std::string(kCapacity, 'c'));
+  EXPECT_EQ(cache.size(), 1U);
+  EXPECT_EQ(cache.total_weight(), kCapacity);
+
+  // An oversized entry is rejected without disturbing the cache.
+  EXPECT_THROW(cache.Add(12, std::string(kCapacity + 1, 'd')), common_error);
+  EXPECT_EQ(cache.size(), 1U);
+  EXPECT_TRUE(cache.Check(11));
+  EXPECT_FALSE(cache.Check(12));
+
+  cache.Delete(11);
+  EXPECT_EQ(cache.size(), 0U);
+  EXPECT_EQ(cache.total_weight(), 0U);
+}
+
+TEST(LruCacheTest, BEH_WeightedTimeTest) {
+  std::chrono::milliseconds time(100);
+  LruCache<int, std::string> cache(
+      1000, time, [](const int&, const std::string& value) { return value.size(); });
+
+  for (int i(0); i < 5; ++i)
+    cache.Add(i, std::string(10, 'a'));
+  EXPECT_EQ(cache.total_weight(), 50U);
+  std::this_thread::sleep_for(time);
+  cache.Add(5, std::string(20, 'b'));
+  EXPECT_EQ(cache.size(), 1U);
+  EXPECT_EQ(cache.total_weight(), 20U);
+}
+
 }  // namespace test
 
 }  // namespace maidsafe
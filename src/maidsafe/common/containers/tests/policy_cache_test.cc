@@ -0,0 +1,137 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/common/containers/policy_cache.h"
+
+#include <string>
+
+#include "maidsafe/common/containers/lru_cache.h"
+#include "maidsafe/common/test.h"
+#include "maidsafe/common/utils.h"
+
+namespace maidsafe {
+
+namespace test {
+
+namespace {
+
+const EvictionPolicy kPolicies[] = {EvictionPolicy::kLru, EvictionPolicy::kWTinyLfu,
+                                    EvictionPolicy::kArc};
+
+// Reads 'key', adding it on a miss, and returns whether it hit.
+bool Access(PolicyCache<int, int>& cache, int key) {
+  if (cache.Get(key).valid())
+    return true;
+  cache.Add(key, key);
+  return false;
+}
+
+}  // unnamed namespace
+
+TEST(PolicyCacheTest, BEH_Construct) {
+  EXPECT_THROW((PolicyCache<int, int>(0, EvictionPolicy::kLru)), std::exception);
+  PolicyCache<int, int> cache(10, EvictionPolicy::kArc);
+  EXPECT_EQ(10U, cache.capacity());
+  EXPECT_EQ(EvictionPolicy::kArc, cache.policy());
+}
+
+TEST(PolicyCacheTest, BEH_AddGetDelete) {
+  for (auto policy : kPolicies) {
+    PolicyCache<int, std::string> cache(10, policy);
+    cache.Add(1, "one");
+    EXPECT_TRUE(cache.Check(1));
+    ASSERT_TRUE(cache.Get(1).valid());
+    EXPECT_EQ("one", cache.Get(1).value());
+    // Adding an existing key leaves the cache unchanged.
+    cache.Add(1, "two");
+    EXPECT_EQ("one", cache.Get(1).value());
+    EXPECT_FALSE(cache.Get(2).valid());
+    cache.Delete(1);
+    EXPECT_FALSE(cache.Check(1));
+    EXPECT_EQ(0U, cache.size());
+    cache.Delete(1);
+  }
+}
+
+TEST(PolicyCacheTest, BEH_RespectsCapacity) {
+  const size_t kCapacity(64);
+  for (auto policy : kPolicies) {
+    PolicyCache<int, int> cache(kCapacity, policy);
+    for (int i(0); i < 20000; ++i) {
+      int key(RandomUint32() % 500);
+      switch (RandomUint32() % 4) {
+        case 0:
+          cache.Delete(key);
+          break;
+        case 1:
+          cache.Add(key, key);
+          break;
+        default: {
+          auto value(cache.Get(key));
+          if (value.valid()) {
+            ASSERT_EQ(key, value.value());
+          }
+        }
+      }
+      ASSERT_GE(kCapacity, cache.size());
+    }
+  }
+}
+
+TEST(PolicyCacheTest, BEH_LruMatchesLruCache) {
+  const size_t kCapacity(100);
+  LruCache<int, int> expected(kCapacity);
+  PolicyCache<int, int> cache(kCapacity, EvictionPolicy::kLru);
+  for (int i(0); i < 20000; ++i) {
+    int key(RandomUint32() % 300);
+    if (RandomUint32() % 2 == 0) {
+      ASSERT_EQ(expected.Get(key).valid(), cache.Get(key).valid());
+    } else {
+      expected.Add(key, key);
+      cache.Add(key, key);
+    }
+    ASSERT_EQ(expected.size(), cache.size());
+  }
+}
+
+TEST(PolicyCacheTest, BEH_ScanResistance) {
+  const int kCapacity(100), kHotKeys(50);
+  for (auto policy : kPolicies) {
+    PolicyCache<int, int> cache(kCapacity, policy);
+    // Establish a popular working set, then scan a large number of keys once each.
+    for (int round(0); round != 20; ++round) {
+      for (int key(0); key != kHotKeys; ++key)
+        Access(cache, key);
+    }
+    for (int key(kHotKeys); key != kHotKeys + 10000; ++key)
+      Access(cache, key);
+
+    int retained(0);
+    for (int key(0); key != kHotKeys; ++key)
+      retained += cache.Check(key) ? 1 : 0;
+    if (policy == EvictionPolicy::kLru) {
+      EXPECT_EQ(0, retained);
+    } else {
+      EXPECT_LE(kHotKeys * 9 / 10, retained) << "Policy " << static_cast<int>(policy);
+    }
+  }
+}
+
+}  // namespace test
+
+}  // namespace maidsafe
@@ -0,0 +1,164 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/common/containers/xor_trie.h"
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "maidsafe/common/test.h"
+#include "maidsafe/common/utils.h"
+
+namespace maidsafe {
+
+namespace test {
+
+namespace {
+
+NodeId RandomId() { return NodeId(RandomString(NodeId::kSize)); }
+
+// Returns a random ID sharing the first 'prefix_length' bytes with 'base', so that IDs cluster.
+NodeId RandomIdNear(const NodeId& base, size_t prefix_length) {
+  std::string raw_id(base.string());
+  std::string suffix(RandomString(NodeId::kSize - prefix_length));
+  std::copy(suffix.begin(), suffix.end(), raw_id.begin() + prefix_length);
+  return NodeId(raw_id);
+}
+
+// Checks the results of queries for 'target' against 'expected'.
+void CheckQueries(const XorTrie<int>& trie, const std::map<NodeId, int>& expected,
+                  const NodeId& target) {
+  std::vector<NodeId> sorted;
+  for (const auto& entry : expected)
+    sorted.push_back(entry.first);
+  std::sort(sorted.begin(), sorted.end(), [&target](const NodeId& lhs, const NodeId& rhs) {
+    return NodeId::CloserToTarget(lhs, rhs, target);
+  });
+  const size_t kCounts[] = {0, 1, 8, 16, sorted.size(), sorted.size() + 1};
+  for (auto k : kCounts) {
+    auto closest(trie.Closest(target, k));
+    ASSERT_EQ(std::min(k, sorted.size()), closest.size());
+    for (size_t i(0); i != closest.size(); ++i) {
+      ASSERT_EQ(sorted[i], closest[i]->first);
+      ASSERT_EQ(expected.at(sorted[i]), closest[i]->second);
+    }
+  }
+  for (int common_leading_bits(0); common_leading_bits <= static_cast<int>(8 * NodeId::kSize);
+       common_leading_bits += 3) {
+    size_t count(static_cast<size_t>(std::count_if(
+        sorted.begin(), sorted.end(), [&](const NodeId& id) {
+          return id.CommonLeadingBits(target) >= common_leading_bits;
+        })));
+    ASSERT_EQ(count, trie.CountWithinCommonLeadingBits(target, common_leading_bits));
+  }
+}
+
+}  // unnamed namespace
+
+TEST(XorTrieTest, BEH_AddDeleteFind) {
+  XorTrie<std::string> trie;
+  EXPECT_TRUE(trie.empty());
+  NodeId id1(RandomId()), id2(RandomId());
+  EXPECT_FALSE(trie.Check(id1));
+  EXPECT_FALSE(trie.Delete(id1));
+
+  EXPECT_TRUE(trie.Add(id1, "one"));
+  EXPECT_TRUE(trie.Add(id2, "two"));
+  EXPECT_FALSE(trie.Add(id1, "three"));
+  EXPECT_EQ(2U, trie.size());
+  ASSERT_NE(nullptr, trie.Find(id1));
+  EXPECT_EQ("one", *trie.Find(id1));
+  EXPECT_EQ(nullptr, trie.Find(RandomId()));
+
+  EXPECT_TRUE(trie.Delete(id1));
+  EXPECT_FALSE(trie.Check(id1));
+  EXPECT_FALSE(trie.Delete(id1));
+  ASSERT_NE(nullptr, trie.Find(id2));
+  EXPECT_EQ("two", *trie.Find(id2));
+  EXPECT_TRUE(trie.Delete(id2));
+  EXPECT_TRUE(trie.empty());
+  EXPECT_TRUE(trie.Closest(id1, 4).empty());
+  EXPECT_EQ(0U, trie.CountWithinCommonLeadingBits(id1, 0));
+
+  EXPECT_TRUE(trie.Add(id2, "two"));
+  trie.clear();
+  EXPECT_TRUE(trie.empty());
+  EXPECT_FALSE(trie.Check(id2));
+}
+
+TEST(XorTrieTest, BEH_InvalidArguments) {
+  XorTrie<int> trie;
+  NodeId id(RandomId());
+  trie.Add(id, 0);
+  EXPECT_THROW(trie.CountWithinCommonLeadingBits(id, -1), common_error);
+  EXPECT_THROW(trie.CountWithinCommonLeadingBits(id, 8 * NodeId::kSize + 1), common_error);
+  EXPECT_EQ(1U, trie.CountWithinCommonLeadingBits(id, 8 * NodeId::kSize));
+#ifndef USE_DEPRECATED_NODE_ID_BEHAVIOUR
+  EXPECT_THROW(trie.Add(NodeId(), 0), common_error);
+  EXPECT_THROW(trie.Closest(NodeId(), 1), common_error);
+  EXPECT_THROW(trie.CountWithinCommonLeadingBits(NodeId(), 0), common_error);
+  EXPECT_FALSE(trie.Check(NodeId()));
+#endif
+}
+
+TEST(XorTrieTest, BEH_MatchesReference) {
+  XorTrie<int> trie;
+  std::map<NodeId, int> expected;
+  const NodeId kBase(RandomId());
+  std::vector<NodeId> ids;
+  for (int i(0); i != 2000; ++i) {
+    // Mix uniformly-distributed IDs with ones sharing long prefixes.
+    ids.push_back(i % 2 == 0 ? RandomId() : RandomIdNear(kBase, RandomUint32() % NodeId::kSize));
+  }
+
+  for (int i(0); i != 20000; ++i) {
+    const NodeId& id(ids[RandomUint32() % ids.size()]);
+    if (RandomUint32() % 3 == 0) {
+      ASSERT_EQ(expected.erase(id) == 1, trie.Delete(id));
+    } else {
+      ASSERT_EQ(expected.insert(std::make_pair(id, i)).second, trie.Add(id, i));
+    }
+    ASSERT_EQ(expected.size(), trie.size());
+    if (i % 1000 == 0) {
+      CheckQueries(trie, expected, RandomId());
+      CheckQueries(trie, expected, RandomIdNear(kBase, RandomUint32() % NodeId::kSize));
+      CheckQueries(trie, expected, id);
+    }
+  }
+
+  for (const auto& entry : expected) {
+    ASSERT_NE(nullptr, trie.Find(entry.first));
+    ASSERT_EQ(entry.second, *trie.Find(entry.first));
+  }
+  size_t iterated(0);
+  for (const auto& entry : trie) {
+    ASSERT_EQ(expected.at(entry.first), entry.second);
+    ++iterated;
+  }
+  EXPECT_EQ(expected.size(), iterated);
+
+  for (const auto& entry : expected)
+    ASSERT_TRUE(trie.Delete(entry.first));
+  EXPECT_TRUE(trie.empty());
+}
+
+}  // namespace test
+
+}  // namespace maidsafe
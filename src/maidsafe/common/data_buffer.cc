@@ -17,10 +17,164 @@
     use of the MaidSafe Software.                                                                 */
 
 #include "maidsafe/common/data_buffer.h"
+
+#ifdef MAIDSAFE_WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <ctime>
+#include <fstream>
+#include <string>
+#include <thread>
+
+#include "boost/filesystem/operations.hpp"
+
 #include "maidsafe/common/utils.h"
 
+namespace fs = boost::filesystem;
+
 namespace maidsafe {
 
+namespace detail {
+
+namespace {
+
+const std::string kPartialFileExtension(".partial");
+
+// Flushes 'path' (a file, or a directory to persist renames within it) to the storage device.
+bool SyncToDisk(const fs::path& path, bool is_directory) {
+#ifdef MAIDSAFE_WIN32
+  // Directories can't be opened this way on Windows, where NTFS journals renames itself.
+  if (is_directory)
+    return true;
+  int descriptor(::_wopen(path.c_str(), _O_WRONLY | _O_BINARY));
+  bool synced(descriptor != -1 && ::_commit(descriptor) == 0);
+  if (descriptor != -1)
+    ::_close(descriptor);
+#else
+  int descriptor(::open(path.c_str(), is_directory ? O_RDONLY : O_WRONLY));
+  bool synced(descriptor != -1 && ::fsync(descriptor) == 0);
+  if (descriptor != -1)
+    ::close(descriptor);
+#endif
+  if (!synced)
+    LOG(kError) << "Failed to sync " << path << " to disk.";
+  return synced;
+}
+
+}  // unnamed namespace
+
+bool WriteFilesAtomically(const std::vector<NamedContent>& files) {
+  if (files.empty())
+    return true;
+  std::vector<fs::path> partial_paths;
+  partial_paths.reserve(files.size());
+  bool written(true);
+  for (const auto& file : files) {
+    partial_paths.emplace_back(file.first.string() + kPartialFileExtension);
+    {
+      std::ofstream file_out(partial_paths.back().c_str(),
+                             std::ios::out | std::ios::trunc | std::ios::binary);
+      file_out.write(file.second.get().data(), file.second.get().size());
+      file_out.close();
+      written = file_out.good();
+    }
+    if (!written || !SyncToDisk(partial_paths.back(), false)) {
+      LOG(kError) << "Failed to write " << partial_paths.back();
+      written = false;
+      break;
+    }
+  }
+  boost::system::error_code error_code;
+  if (!written) {
+    for (const auto& partial_path : partial_paths)
+      fs::remove(partial_path, error_code);
+    return false;
+  }
+  // The contents are on disk before any rename is, so a rename which survives a power loss can't
+  // expose a partially written value.
+  for (size_t i(0); i != files.size(); ++i) {
+    fs::rename(partial_paths[i], files[i].first, error_code);
+    if (error_code) {
+      LOG(kError) << "Failed to rename " << partial_paths[i] << " to " << files[i].first << ": "
+                  << error_code.message();
+      for (size_t j(i); j != files.size(); ++j)
+        fs::remove(partial_paths[j], error_code);
+      return false;
+    }
+  }
+  return SyncToDisk(files.front().first.parent_path(), true);
+}
+
+std::vector<std::pair<std::string, uint64_t>> ScanDiskBuffer(const fs::path& disk_buffer) {
+  std::vector<fs::path> paths;
+  boost::system::error_code error_code;
+  for (fs::directory_iterator itr(disk_buffer, error_code), end; !error_code && itr != end;
+       itr.increment(error_code)) {
+    if (!fs::is_regular_file(itr->status()))
+      continue;
+    if (itr->path().extension() == kPartialFileExtension) {
+      // Left by a write which never completed.
+      boost::system::error_code remove_error;
+      if (!fs::remove(itr->path(), remove_error) || remove_error)
+        LOG(kWarning) << "Failed to remove " << itr->path() << ": " << remove_error.message();
+      continue;
+    }
+    paths.push_back(itr->path());
+  }
+  if (error_code) {
+    LOG(kError) << "Failed to list " << disk_buffer << ": " << error_code.message();
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::filesystem_io_error));
+  }
+
+  struct FileDetails {
+    bool valid;
+    uint64_t size;
+    std::time_t last_write_time;
+  };
+  std::vector<FileDetails> details(paths.size(), FileDetails{false, 0, 0});
+  // Stat the files in parallel, each worker taking every n'th file.
+  size_t worker_count(std::max(1U, std::thread::hardware_concurrency()));
+  worker_count = std::min(worker_count, paths.size());
+  std::vector<std::future<void>> workers;
+  for (size_t i(0); i != worker_count; ++i) {
+    workers.push_back(std::async(std::launch::async, [&paths, &details, i, worker_count] {
+      for (size_t j(i); j < paths.size(); j += worker_count) {
+        boost::system::error_code size_error, time_error;
+        details[j].size = fs::file_size(paths[j], size_error);
+        details[j].last_write_time = fs::last_write_time(paths[j], time_error);
+        details[j].valid = !size_error && !time_error;
+      }
+    }));
+  }
+  for (auto& worker : workers)
+    worker.get();
+
+  std::vector<size_t> order;
+  order.reserve(paths.size());
+  for (size_t i(0); i != paths.size(); ++i) {
+    if (details[i].valid)
+      order.push_back(i);
+    else
+      LOG(kWarning) << "Failed to read size and modification time of " << paths[i];
+  }
+  std::stable_sort(order.begin(), order.end(), [&details](size_t lhs, size_t rhs) {
+    return details[lhs].last_write_time < details[rhs].last_write_time;
+  });
+  std::vector<std::pair<std::string, uint64_t>> contents;
+  contents.reserve(order.size());
+  for (auto index : order)
+    contents.emplace_back(paths[index].filename().string(), details[index].size);
+  return contents;
+}
+
+}  // namespace detail
+
 template <>
 boost::filesystem::path DataBuffer<DataNameVariant>::GetFilename(const DataNameVariant& key) const {
   return kDiskBuffer_ / detail::GetFileName(key);
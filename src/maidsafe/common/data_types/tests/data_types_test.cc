@@ -20,6 +20,7 @@
 
 #include "maidsafe/common/test.h"
 #include "maidsafe/common/utils.h"
+#include "maidsafe/common/containers/flat_hash_map.h"
 #include "maidsafe/common/data_types/data_name_variant.h"
 
 namespace maidsafe {
@@ -59,6 +60,19 @@ TEST(DataTypeTest, BEH_RetrieveType) {
   ASSERT_TRUE((std::is_same<MutableData, MutableData::Name::data_type>::value));
 }
 
+TEST(DataTypeTest, BEH_HashNameVariant) {
+  Identity id(RandomString(64));
+  DataNameVariant immutable_name(GetDataNameVariant(DataTagValue::kImmutableDataValue, id));
+  DataNameVariant mutable_name(GetDataNameVariant(DataTagValue::kMutableDataValue, id));
+  EXPECT_EQ(std::hash<DataNameVariant>()(immutable_name),
+            std::hash<DataNameVariant>()(ImmutableData::Name(Identity(id.string()))));
+  FlatHashSet<DataNameVariant> names;
+  EXPECT_TRUE(names.insert(immutable_name).second);
+  EXPECT_TRUE(names.insert(mutable_name).second);
+  EXPECT_FALSE(names.insert(ImmutableData::Name(id)).second);
+  EXPECT_EQ(2U, names.size());
+}
+
 }  // namespace test
 
 }  // namespace maidsafe
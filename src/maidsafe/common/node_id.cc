@@ -18,102 +18,103 @@
 
 #include "maidsafe/common/node_id.h"
 
-#include <algorithm>
 #include <bitset>
+#include <cstring>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 #include "maidsafe/common/error_categories.h"
 #include "maidsafe/common/log.h"
-#include "maidsafe/common/node_id_common_bits_matrix.h"
 #include "maidsafe/common/utils.h"
 
 namespace maidsafe {
 
-#if !defined(_MSC_VER) || _MSC_VER >= 1900
-const size_t NodeId::kSize;
-#endif
+namespace {
 
-#ifdef NDEBUG
-#define INIT_DEBUG_NODE_ID
+// Number of leading zero bits in 'word', which must be non-zero.
+int CountLeadingZeros(uint64_t word) {
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_clzll(word);
+#elif defined(_MSC_VER) && defined(_M_X64)
+  unsigned long index(0);  // NOLINT
+  _BitScanReverse64(&index, word);
+  return 63 - static_cast<int>(index);
 #else
-#define INIT_DEBUG_NODE_ID , debug_id_(HexSubstr(raw_id_))
+  int count(0);
+  for (uint64_t mask(1ULL << 63); (word & mask) == 0; mask >>= 1)
+    ++count;
+  return count;
 #endif
+}
 
-#ifdef USE_DEPRECATED_NODE_ID_BEHAVIOUR
-
-NodeId::NodeId() : raw_id_(kSize, 0) INIT_DEBUG_NODE_ID {}
-
-#else
-
-#ifdef NDEBUG
-NodeId::NodeId() : raw_id_() {}
-#else
-NodeId::NodeId() : raw_id_(), debug_id_("Invalid ID") {}
-#endif
+}  // unnamed namespace
 
+#if !defined(_MSC_VER) || _MSC_VER >= 1900
+const size_t NodeId::kSize;
 #endif
 
-NodeId::NodeId(const NodeId& other) : raw_id_(other.raw_id_) INIT_DEBUG_NODE_ID {}
-
-NodeId::NodeId(NodeId&& other) MAIDSAFE_NOEXCEPT
-    : raw_id_(std::move(other.raw_id_)) INIT_DEBUG_NODE_ID {}
-
-NodeId& NodeId::operator=(NodeId&& other) MAIDSAFE_NOEXCEPT {
-  raw_id_ = std::move(other.raw_id_);
-#ifndef NDEBUG
-  debug_id_ = std::move(other.debug_id_);
+#ifdef USE_DEPRECATED_NODE_ID_BEHAVIOUR
+NodeId::NodeId() : raw_id_(), valid_(true) {}
+#else
+NodeId::NodeId() : raw_id_(), valid_(false) {}
 #endif
-  return *this;
-}
 
-NodeId::NodeId(std::string id) : raw_id_(std::move(id)) INIT_DEBUG_NODE_ID {
-  if (raw_id_.size() != kSize)
-    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::invalid_node_id));
-}
+NodeId::NodeId(std::string id) : raw_id_(), valid_(false) { Assign(id); }
 
-NodeId::NodeId(const crypto::SHA512Hash& id) : raw_id_(id.string()) INIT_DEBUG_NODE_ID {}
+NodeId::NodeId(const crypto::SHA512Hash& id) : raw_id_(), valid_(false) { Assign(id.string()); }
 
-NodeId::NodeId(const std::string& id, NodeId::EncodingType encoding_type) : raw_id_() {
+NodeId::NodeId(const std::string& id, NodeId::EncodingType encoding_type)
+    : raw_id_(), valid_(false) {
+  std::string decoded;
   try {
     switch (encoding_type) {
       case EncodingType::kBinary:
-        DecodeFromBinary(id);
+        decoded = DecodeFromBinary(id);
         break;
       case EncodingType::kHex:
-        raw_id_ = HexDecode(id);
+        decoded = HexDecode(id);
         break;
       case EncodingType::kBase64:
-        raw_id_ = Base64Decode(id);
+        decoded = Base64Decode(id);
         break;
       default:
-        raw_id_ = id;
+        decoded = id;
     }
   } catch (const std::exception& e) {
     LOG(kError) << "NodeId Ctor: " << boost::diagnostic_information(e);
-    raw_id_.clear();
+    decoded.clear();
   }
-  if (raw_id_.size() != kSize)
+  Assign(decoded);
+}
+
+void NodeId::Assign(const std::string& id) {
+  if (id.size() != kSize)
     BOOST_THROW_EXCEPTION(MakeError(CommonErrors::invalid_node_id));
-#ifndef NDEBUG
-  debug_id_ = HexSubstr(raw_id_);
-#endif
+  std::memcpy(raw_id_.data(), id.data(), kSize);
+  valid_ = true;
 }
 
+std::string NodeId::RawString() const { return std::string(raw_id_.begin(), raw_id_.end()); }
+
 std::string NodeId::EncodeToBinary() const {
   std::string binary;
-  binary.reserve(kSize);
+  binary.reserve(8 * kSize);
   for (size_t i = 0; i < kSize; ++i) {
-    std::bitset<8> temp(static_cast<int>(raw_id_[i]));
+    std::bitset<8> temp(raw_id_[i]);
     binary += temp.to_string();
   }
   return binary;
 }
 
-void NodeId::DecodeFromBinary(const std::string& binary_id) {
-  raw_id_.assign(kSize, 0);
+std::string NodeId::DecodeFromBinary(const std::string& binary_id) {
+  std::string raw_id(kSize, 0);
   for (size_t i = 0; i < kSize; ++i) {
     std::bitset<8> temp(binary_id.substr(i * 8, 8));
-    raw_id_[i] = static_cast<char>(temp.to_ulong());
+    raw_id[i] = static_cast<char>(temp.to_ulong());
   }
+  return raw_id;
 }
 
 bool NodeId::CloserToTarget(const NodeId& id1, const NodeId& id2, const NodeId& target_id) {
@@ -121,9 +122,10 @@ bool NodeId::CloserToTarget(const NodeId& id1, const NodeId& id2, const NodeId&
   if (!id1.IsValid() || !id2.IsValid() || !target_id.IsValid())
     BOOST_THROW_EXCEPTION(MakeError(CommonErrors::invalid_node_id));
 #endif
-  for (uint16_t i = 0; i < kSize; ++i) {
-    unsigned char result1 = id1.raw_id_[i] ^ target_id.raw_id_[i];
-    unsigned char result2 = id2.raw_id_[i] ^ target_id.raw_id_[i];
+  for (size_t i = 0; i < kSize; i += 8) {
+    uint64_t target(detail::ReadBigEndianWord(&target_id.raw_id_[i]));
+    uint64_t result1(detail::ReadBigEndianWord(&id1.raw_id_[i]) ^ target);
+    uint64_t result2(detail::ReadBigEndianWord(&id2.raw_id_[i]) ^ target);
     if (result1 != result2)
       return result1 < result2;
   }
@@ -135,7 +137,7 @@ std::string NodeId::string() const {
   if (!IsValid())
     BOOST_THROW_EXCEPTION(MakeError(CommonErrors::invalid_node_id));
 #endif
-  return raw_id_;
+  return RawString();
 }
 
 std::string NodeId::ToStringEncoded(const EncodingType& encoding_type) const {
@@ -147,11 +149,11 @@ std::string NodeId::ToStringEncoded(const EncodingType& encoding_type) const {
     case EncodingType::kBinary:
       return EncodeToBinary();
     case EncodingType::kHex:
-      return HexEncode(raw_id_);
+      return HexEncode(RawString());
     case EncodingType::kBase64:
-      return Base64Encode(raw_id_);
+      return Base64Encode(RawString());
     default:
-      return raw_id_;
+      return RawString();
   }
 }
 
@@ -167,7 +169,7 @@ bool NodeId::IsValid() const {
 
 #else
 
-bool NodeId::IsValid() const { return !raw_id_.empty(); }
+bool NodeId::IsValid() const { return valid_; }
 
 #endif
 
@@ -177,16 +179,16 @@ int NodeId::CommonLeadingBits(const NodeId& other) const {
     BOOST_THROW_EXCEPTION(MakeError(CommonErrors::invalid_node_id));
 #endif
 
-  // Find first mismatching char between the two IDs
-  auto mismatch(std::mismatch(std::begin(raw_id_), std::end(raw_id_), std::begin(other.raw_id_)));
-
+  // Find the first mismatching word between the two IDs; its leading zeros once XORed are the
+  // common bits within that word.
+  for (size_t i(0); i != kSize; i += 8) {
+    uint64_t difference(detail::ReadBigEndianWord(&raw_id_[i]) ^
+                        detail::ReadBigEndianWord(&other.raw_id_[i]));
+    if (difference != 0)
+      return static_cast<int>(8 * i) + CountLeadingZeros(difference);
+  }
   // If there's no mismatch, the IDs are equal
-  if (mismatch.first == std::end(raw_id_))
-    return 8 * kSize;
-
-  int common_bits{detail::kCommonBits[static_cast<unsigned char>(
-      *mismatch.first)][static_cast<unsigned char>(*mismatch.second)]};
-  return static_cast<int>(8 * std::distance(std::begin(raw_id_), mismatch.first)) + common_bits;
+  return 8 * kSize;
 }
 
 NodeId& NodeId::operator^=(const NodeId& other) {
@@ -195,28 +197,29 @@ NodeId& NodeId::operator^=(const NodeId& other) {
     BOOST_THROW_EXCEPTION(MakeError(CommonErrors::invalid_node_id));
 #endif
 
-  for (uint16_t i(0); i != kSize; ++i)
-    raw_id_[i] ^= other.raw_id_[i];
-#ifndef NDEBUG
-  debug_id_ = HexSubstr(raw_id_);
-#endif
+  // Byte order doesn't matter here, so use native words, which compilers vectorise.
+  for (size_t i(0); i != kSize; i += 8) {
+    uint64_t word, other_word;
+    std::memcpy(&word, &raw_id_[i], 8);
+    std::memcpy(&other_word, &other.raw_id_[i], 8);
+    word ^= other_word;
+    std::memcpy(&raw_id_[i], &word, 8);
+  }
   return *this;
 }
 
 std::string DebugId(const NodeId& node_id) {
-#ifdef NDEBUG
-  return node_id.IsValid() ? HexSubstr(node_id.raw_id_) : "Invalid ID";
+#if defined(USE_DEPRECATED_NODE_ID_BEHAVIOUR) && !defined(NDEBUG)
+  return HexSubstr(node_id.RawString());
 #else
-  return node_id.debug_id_;
+  return node_id.IsValid() ? HexSubstr(node_id.RawString()) : "Invalid ID";
 #endif
 }
 
 void swap(NodeId& lhs, NodeId& rhs) MAIDSAFE_NOEXCEPT {
   using std::swap;
   swap(lhs.raw_id_, rhs.raw_id_);
-#ifndef NDEBUG
-  swap(lhs.debug_id_, rhs.debug_id_);
-#endif
+  swap(lhs.valid_, rhs.valid_);
 }
 
 }  // namespace maidsafe
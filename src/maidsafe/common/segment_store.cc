@@ -0,0 +1,533 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/common/segment_store.h"
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include "boost/crc.hpp"
+#include "boost/filesystem/operations.hpp"
+
+#include "maidsafe/common/error.h"
+#include "maidsafe/common/log.h"
+#include "maidsafe/common/utils.h"
+
+namespace fs = boost::filesystem;
+
+namespace maidsafe {
+
+namespace {
+
+const uint32_t kLiveRecord(0x4C495645);
+const uint32_t kDeletedRecord(0x44454144);
+const std::string kSegmentPrefix("segment_");
+
+struct RecordHeader {
+  uint32_t state;
+  uint32_t name_size;
+  uint64_t value_size;
+  uint32_t checksum;
+  uint32_t reserved;
+};
+
+const uint64_t kHeaderSize(sizeof(RecordHeader));
+
+uint64_t RecordSize(uint64_t name_size, uint64_t value_size) {
+  return kHeaderSize + name_size + value_size;
+}
+
+// The state isn't covered, since it's overwritten when the record is deleted.
+uint32_t RecordChecksum(const RecordHeader& header, const std::string& name,
+                        const std::string& value) {
+  boost::crc_32_type crc;
+  crc.process_bytes(&header.name_size, sizeof(header.name_size));
+  crc.process_bytes(&header.value_size, sizeof(header.value_size));
+  crc.process_bytes(name.data(), name.size());
+  crc.process_bytes(value.data(), value.size());
+  return crc.checksum();
+}
+
+struct ScannedRecord {
+  std::string name;
+  uint64_t offset, value_size;
+};
+
+struct ScannedSegment {
+  uint32_t number;
+  fs::path path;
+  uint64_t capacity, write_offset, dead_bytes;
+  std::vector<ScannedRecord> live_records;
+};
+
+// Reads the records from the start of the segment up to the first unused (still zeroed) space, a
+// record which would run past the end of the file, or one which doesn't match its checksum.
+void ScanSegment(ScannedSegment& segment) {
+  boost::system::error_code error_code;
+  segment.capacity = fs::file_size(segment.path, error_code);
+  if (error_code) {
+    LOG(kError) << "Failed to get size of " << segment.path << ": " << error_code.message();
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::filesystem_io_error));
+  }
+  std::ifstream stream(segment.path.c_str(), std::ios::in | std::ios::binary);
+  uint64_t offset(0);
+  RecordHeader header;
+  std::string name, value;
+  while (offset + kHeaderSize <= segment.capacity &&
+         stream.seekg(offset).read(reinterpret_cast<char*>(&header), kHeaderSize).good()) {
+    if ((header.state != kLiveRecord && header.state != kDeletedRecord) ||
+        header.name_size > segment.capacity || header.value_size > segment.capacity) {
+      break;
+    }
+    uint64_t record_size(RecordSize(header.name_size, header.value_size));
+    if (record_size > segment.capacity - offset)
+      break;
+    name.assign(header.name_size, 0);
+    value.assign(static_cast<size_t>(header.value_size), 0);
+    if ((!name.empty() && !stream.read(&name[0], name.size()).good()) ||
+        (!value.empty() && !stream.read(&value[0], value.size()).good()) ||
+        RecordChecksum(header, name, value) != header.checksum) {
+      LOG(kWarning) << "Record at offset " << offset << " of " << segment.path
+                    << " is incomplete; ignoring the rest of the segment.";
+      break;
+    }
+    if (header.state == kLiveRecord) {
+      segment.live_records.push_back(ScannedRecord{name, offset, header.value_size});
+    } else {
+      segment.dead_bytes += record_size;
+    }
+    offset += record_size;
+  }
+  segment.write_offset = offset;
+}
+
+}  // unnamed namespace
+
+const uint64_t SegmentStore::kDefaultSegmentSize(64 * 1024 * 1024);
+const uint64_t SegmentStore::kMinSegmentSize(64 * 1024);
+
+uint64_t SegmentStore::SegmentSizeFor(uint64_t max_bytes) {
+  return std::min(kDefaultSegmentSize, std::max(kMinSegmentSize, max_bytes / 8));
+}
+
+SegmentStore::Segment::Segment(uint32_t number_in, fs::path path_in, uint64_t capacity_in)
+    : number(number_in),
+      path(std::move(path_in)),
+      stream(),
+      capacity(capacity_in),
+      write_offset(0),
+      dead_bytes(0) {}
+
+SegmentStore::SegmentStore(fs::path root, uint64_t segment_size, bool recover)
+    : kRoot_(std::move(root)),
+      kSegmentSize_(segment_size),
+      segments_(),
+      index_(),
+      compaction_candidates_(),
+      live_value_bytes_(0),
+      running_(true),
+      mutex_(),
+      cond_var_(),
+      worker_() {
+  boost::system::error_code error_code;
+  if (!fs::is_directory(kRoot_, error_code)) {
+    LOG(kError) << kRoot_ << " is not a directory: " << error_code.message();
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::uninitialised));
+  }
+  std::vector<fs::path> existing_segments;
+  for (fs::directory_iterator itr(kRoot_, error_code), end; !error_code && itr != end; ++itr) {
+    if (itr->path().filename().string().compare(0, kSegmentPrefix.size(), kSegmentPrefix) == 0)
+      existing_segments.push_back(itr->path());
+  }
+  if (recover) {
+    Recover(existing_segments);
+  } else {
+    for (const auto& stale_segment : existing_segments) {
+      if (!fs::remove(stale_segment, error_code) || error_code)
+        LOG(kWarning) << "Failed to remove " << stale_segment << ": " << error_code.message();
+    }
+  }
+  worker_ = std::async(std::launch::async, &SegmentStore::CompactionWorker, this);
+}
+
+SegmentStore::~SegmentStore() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_ = false;
+  }
+  cond_var_.notify_all();
+  try {
+    worker_.get();
+  } catch (const std::exception& e) {
+    LOG(kError) << boost::diagnostic_information(e);
+  }
+}
+
+bool SegmentStore::Put(const std::string& name, const std::string& value) {
+  return PutBatch(std::vector<NamedValue>(1, NamedValue(name, std::cref(value))));
+}
+
+bool SegmentStore::PutBatch(const std::vector<NamedValue>& values) {
+  if (values.empty())
+    return true;
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<Location> locations;
+  if (!Append(values, locations))
+    return false;
+  for (size_t i(0); i != values.size(); ++i)
+    UpdateIndex(values[i].first, locations[i]);
+  return true;
+}
+
+NonEmptyString SegmentStore::Get(const std::string& name) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto itr(index_.find(name));
+  if (itr == index_.end()) {
+    LOG(kWarning) << HexSubstr(name) << " is not in the segment index.";
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::no_such_element));
+  }
+  Segment& segment(*segments_.at(itr->second.segment));
+  std::string value(static_cast<size_t>(itr->second.value_size), 0);
+  segment.stream.seekg(itr->second.offset + kHeaderSize + name.size());
+  segment.stream.read(&value[0], value.size());
+  if (!segment.stream.good()) {
+    segment.stream.clear();
+    LOG(kError) << "Failed to read " << HexSubstr(name) << " from " << segment.path;
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::filesystem_io_error));
+  }
+  return NonEmptyString(std::move(value));
+}
+
+uint64_t SegmentStore::Remove(const std::string& name, NonEmptyString* value) {
+  if (value)
+    *value = Get(name);
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto itr(index_.find(name));
+  if (itr == index_.end()) {
+    LOG(kWarning) << HexSubstr(name) << " is not in the segment index.";
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::no_such_element));
+  }
+  uint64_t value_size(itr->second.value_size);
+  MarkDeleted(itr->second, RecordSize(name.size(), value_size));
+  index_.erase(itr);
+  live_value_bytes_ -= value_size;
+  return value_size;
+}
+
+bool SegmentStore::Has(const std::string& name) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return index_.count(name) != 0;
+}
+
+void SegmentStore::Compact() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!compaction_candidates_.empty() && running_) {
+    uint32_t number(*compaction_candidates_.begin());
+    compaction_candidates_.erase(compaction_candidates_.begin());
+    CompactSegment(number, lock);
+  }
+}
+
+uint64_t SegmentStore::LiveValueBytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return live_value_bytes_;
+}
+
+size_t SegmentStore::SegmentCount() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return segments_.size();
+}
+
+std::vector<std::pair<std::string, uint64_t>> SegmentStore::Contents() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  typedef std::pair<const Location*, const std::string*> LiveEntry;
+  std::vector<LiveEntry> live;
+  live.reserve(index_.size());
+  for (const auto& entry : index_)
+    live.emplace_back(&entry.second, &entry.first);
+  std::sort(live.begin(), live.end(), [](const LiveEntry& lhs, const LiveEntry& rhs) {
+    return std::make_pair(lhs.first->segment, lhs.first->offset) <
+           std::make_pair(rhs.first->segment, rhs.first->offset);
+  });
+  std::vector<std::pair<std::string, uint64_t>> contents;
+  contents.reserve(live.size());
+  for (const auto& entry : live)
+    contents.emplace_back(*entry.second, entry.first->value_size);
+  return contents;
+}
+
+void SegmentStore::Recover(const std::vector<fs::path>& segment_paths) {
+  std::vector<ScannedSegment> scanned;
+  for (const auto& path : segment_paths) {
+    ScannedSegment segment{0, path, 0, 0, 0, std::vector<ScannedRecord>()};
+    try {
+      std::string suffix(path.filename().string().substr(kSegmentPrefix.size()));
+      segment.number = static_cast<uint32_t>(std::stoul(suffix));
+    } catch (const std::exception&) {
+      LOG(kWarning) << "Ignoring " << path << " which isn't a valid segment name.";
+      continue;
+    }
+    scanned.push_back(std::move(segment));
+  }
+
+  // Scan the segments in parallel, each worker taking every n'th segment.
+  size_t worker_count(std::max(1U, std::thread::hardware_concurrency()));
+  worker_count = std::min(worker_count, scanned.size());
+  std::vector<std::future<void>> workers;
+  for (size_t i(0); i != worker_count; ++i) {
+    workers.push_back(std::async(std::launch::async, [&scanned, i, worker_count] {
+      for (size_t j(i); j < scanned.size(); j += worker_count)
+        ScanSegment(scanned[j]);
+    }));
+  }
+  for (auto& worker : workers)
+    worker.get();
+
+  std::sort(scanned.begin(), scanned.end(), [](const ScannedSegment& lhs,
+                                               const ScannedSegment& rhs) {
+    return lhs.number < rhs.number;
+  });
+  for (const auto& scanned_segment : scanned) {
+    // Anything past the last valid record may be a partial write, so is cut off, and the segment
+    // is sealed by making that its capacity.
+    boost::system::error_code error_code;
+    fs::resize_file(scanned_segment.path, scanned_segment.write_offset, error_code);
+    if (error_code) {
+      LOG(kError) << "Failed to truncate " << scanned_segment.path << ": " << error_code.message();
+      BOOST_THROW_EXCEPTION(MakeError(CommonErrors::filesystem_io_error));
+    }
+    std::unique_ptr<Segment> segment(new Segment(scanned_segment.number, scanned_segment.path,
+                                                 scanned_segment.write_offset));
+    segment->write_offset = scanned_segment.write_offset;
+    segment->dead_bytes = scanned_segment.dead_bytes;
+    segment->stream.open(segment->path.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+    if (!segment->stream.good()) {
+      LOG(kError) << "Failed to open " << segment->path;
+      BOOST_THROW_EXCEPTION(MakeError(CommonErrors::filesystem_io_error));
+    }
+    segments_[segment->number] = std::move(segment);
+  }
+
+  // Later records supersede earlier ones with the same name (e.g. if a compaction was interrupted),
+  // in which case UpdateIndex marks the earlier one as deleted.
+  for (const auto& scanned_segment : scanned) {
+    for (const auto& record : scanned_segment.live_records)
+      UpdateIndex(record.name, Location{scanned_segment.number, record.offset, record.value_size});
+  }
+  // All of the recovered segments are sealed, so any of them may be worth compacting.
+  for (const auto& segment : segments_) {
+    if (segment.second->dead_bytes * 2 >= segment.second->write_offset)
+      compaction_candidates_.insert(segment.first);
+  }
+  LOG(kInfo) << "Recovered " << index_.size() << " values from " << segments_.size()
+             << " segments in " << kRoot_;
+}
+
+SegmentStore::Segment& SegmentStore::ActiveSegment(uint64_t required_space) {
+  if (!segments_.empty()) {
+    Segment& active(*segments_.rbegin()->second);
+    if (active.write_offset + required_space <= active.capacity)
+      return active;
+    // The active segment is about to be sealed, so it may now be worth compacting.
+    if (active.dead_bytes * 2 >= active.write_offset) {
+      compaction_candidates_.insert(active.number);
+      cond_var_.notify_one();
+    }
+  }
+
+  uint32_t number(segments_.empty() ? 1 : segments_.rbegin()->first + 1);
+  std::unique_ptr<Segment> segment(new Segment(
+      number, kRoot_ / (kSegmentPrefix + std::to_string(number)),
+      std::max(kSegmentSize_, required_space)));
+  {
+    std::ofstream create(segment->path.c_str(), std::ios::out | std::ios::trunc | std::ios::binary);
+    if (!create.good()) {
+      LOG(kError) << "Failed to create " << segment->path;
+      BOOST_THROW_EXCEPTION(MakeError(CommonErrors::filesystem_io_error));
+    }
+  }
+  // Preallocate the whole segment up front so that appends don't have to grow the file.
+  fs::resize_file(segment->path, segment->capacity);
+  segment->stream.open(segment->path.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+  if (!segment->stream.good()) {
+    LOG(kError) << "Failed to open " << segment->path;
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::filesystem_io_error));
+  }
+  return *(segments_[number] = std::move(segment));
+}
+
+bool SegmentStore::Append(const std::vector<NamedValue>& values,
+                          std::vector<Location>& locations) {
+  try {
+    uint64_t batch_size(0);
+    for (const auto& value : values)
+      batch_size += RecordSize(value.first.size(), value.second.get().size());
+    Segment& segment(ActiveSegment(batch_size));
+    segment.stream.seekp(segment.write_offset);
+    uint64_t offset(segment.write_offset);
+    locations.clear();
+    for (const auto& value : values) {
+      const std::string& name(value.first);
+      const std::string& data(value.second.get());
+      RecordHeader header{kLiveRecord, static_cast<uint32_t>(name.size()), data.size(), 0, 0};
+      header.checksum = RecordChecksum(header, name, data);
+      segment.stream.write(reinterpret_cast<const char*>(&header), kHeaderSize);
+      segment.stream.write(name.data(), name.size());
+      segment.stream.write(data.data(), data.size());
+      locations.push_back(Location{segment.number, offset, data.size()});
+      offset += RecordSize(name.size(), data.size());
+    }
+    segment.stream.flush();
+    if (!segment.stream.good()) {
+      segment.stream.clear();
+      LOG(kError) << "Failed to append " << values.size() << " values to " << segment.path;
+      return false;
+    }
+    segment.write_offset = offset;
+  } catch (const std::exception& e) {
+    LOG(kError) << "Failed to append " << values.size() << " values: "
+                << boost::diagnostic_information(e);
+    return false;
+  }
+  return true;
+}
+
+void SegmentStore::UpdateIndex(const std::string& name, const Location& location) {
+  auto itr(index_.find(name));
+  if (itr != index_.end()) {
+    live_value_bytes_ -= itr->second.value_size;
+    MarkDeleted(itr->second, RecordSize(name.size(), itr->second.value_size));
+    itr->second = location;
+  } else {
+    index_.emplace(name, location);
+  }
+  live_value_bytes_ += location.value_size;
+}
+
+void SegmentStore::MarkDeleted(const Location& location, uint64_t record_size) {
+  Segment& segment(*segments_.at(location.segment));
+  segment.stream.seekp(location.offset);
+  segment.stream.write(reinterpret_cast<const char*>(&kDeletedRecord), sizeof(kDeletedRecord));
+  segment.stream.flush();
+  if (!segment.stream.good()) {
+    segment.stream.clear();
+    LOG(kError) << "Failed to mark record as deleted in " << segment.path;
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::filesystem_io_error));
+  }
+  segment.dead_bytes += record_size;
+  bool is_active(segment.number == segments_.rbegin()->first);
+  if (is_active) {
+    // Dead records in the active segment can't be reclaimed until it's sealed, so seal it early
+    // once half of its capacity is dead rather than letting them build up until it's full.
+    if (segment.dead_bytes * 2 < segment.capacity)
+      return;
+    Seal(segment);
+  } else if (segment.dead_bytes * 2 < segment.write_offset) {
+    return;
+  }
+  compaction_candidates_.insert(segment.number);
+  cond_var_.notify_one();
+}
+
+void SegmentStore::Seal(Segment& segment) {
+  segment.capacity = segment.write_offset;
+  // Give back the unused preallocated space.
+  boost::system::error_code error_code;
+  fs::resize_file(segment.path, segment.capacity, error_code);
+  if (error_code)
+    LOG(kWarning) << "Failed to truncate " << segment.path << ": " << error_code.message();
+}
+
+void SegmentStore::CompactSegment(uint32_t number, std::unique_lock<std::mutex>& lock) {
+  uint64_t offset(0);
+  for (;;) {
+    auto segment_itr(segments_.find(number));
+    if (segment_itr == segments_.end())
+      return;
+    Segment& segment(*segment_itr->second);
+    if (offset >= segment.write_offset || !running_)
+      break;
+
+    RecordHeader header;
+    segment.stream.seekg(offset);
+    segment.stream.read(reinterpret_cast<char*>(&header), kHeaderSize);
+    std::string name(header.name_size, 0);
+    if (header.name_size != 0)
+      segment.stream.read(&name[0], name.size());
+    if (!segment.stream.good()) {
+      segment.stream.clear();
+      LOG(kError) << "Failed to read record header from " << segment.path;
+      return;
+    }
+    uint64_t record_size(RecordSize(header.name_size, header.value_size));
+
+    auto itr(index_.find(name));
+    if (header.state == kLiveRecord && itr != index_.end() && itr->second.segment == number &&
+        itr->second.offset == offset) {
+      std::string value(static_cast<size_t>(header.value_size), 0);
+      segment.stream.read(&value[0], value.size());
+      std::vector<Location> locations;
+      if (!segment.stream.good() ||
+          !Append(std::vector<NamedValue>(1, NamedValue(name, std::cref(value))), locations)) {
+        segment.stream.clear();
+        LOG(kError) << "Failed to move " << HexSubstr(name) << " out of " << segment.path;
+        return;
+      }
+      // Mark the old copy as deleted now rather than relying on the segment being removed, since
+      // otherwise a crash before then would let recovery bring the value back after a Remove.
+      Location old_location(itr->second);
+      itr->second = locations.front();
+      try {
+        MarkDeleted(old_location, record_size);
+      } catch (const std::exception&) {
+        return;
+      }
+    }
+    offset += record_size;
+    // Let other operations proceed between records.
+    lock.unlock();
+    lock.lock();
+  }
+  if (!running_)
+    return;
+
+  auto segment_itr(segments_.find(number));
+  if (segment_itr == segments_.end())
+    return;
+  fs::path path(segment_itr->second->path);
+  segments_.erase(segment_itr);
+  compaction_candidates_.erase(number);
+  boost::system::error_code error_code;
+  if (!fs::remove(path, error_code) || error_code)
+    LOG(kWarning) << "Failed to remove compacted segment " << path << ": " << error_code.message();
+}
+
+void SegmentStore::CompactionWorker() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    cond_var_.wait(lock, [this] { return !running_ || !compaction_candidates_.empty(); });
+    if (!running_)
+      return;
+    uint32_t number(*compaction_candidates_.begin());
+    compaction_candidates_.erase(compaction_candidates_.begin());
+    CompactSegment(number, lock);
+  }
+}
+
+}  // namespace maidsafe
@@ -0,0 +1,110 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/common/closest_nodes.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "maidsafe/common/test.h"
+#include "maidsafe/common/utils.h"
+
+namespace maidsafe {
+
+namespace test {
+
+namespace {
+
+std::vector<NodeId> SortedByDistance(std::vector<NodeId> ids, const NodeId& target, size_t k) {
+  k = std::min(k, ids.size());
+  std::partial_sort(ids.begin(), ids.begin() + k, ids.end(),
+                    [&target](const NodeId& lhs, const NodeId& rhs) {
+    return NodeId::CloserToTarget(lhs, rhs, target);
+  });
+  ids.resize(k);
+  return ids;
+}
+
+// IDs which share their first 'prefix_length' bytes, so that their distances to any target share
+// a prefix too.
+std::vector<NodeId> MakeIds(size_t count, size_t prefix_length) {
+  const std::string prefix(RandomString(prefix_length));
+  std::vector<NodeId> ids;
+  for (size_t i(0); i != count; ++i)
+    ids.emplace_back(prefix + RandomString(NodeId::kSize - prefix_length));
+  return ids;
+}
+
+}  // unnamed namespace
+
+TEST(ClosestNodesTest, BEH_MatchesSort) {
+  // Include prefixes of more than one 64-bit word to exercise comparing full IDs.
+  const size_t kPrefixLengths[] = {0, 7, 8, 20};
+  const size_t kCounts[] = {0, 1, 4, 499, 500, 600};
+  for (auto prefix_length : kPrefixLengths) {
+    auto ids(MakeIds(500, prefix_length));
+    for (int i(0); i != 10; ++i) {
+      NodeId target(RandomString(NodeId::kSize));
+      for (auto k : kCounts)
+        EXPECT_EQ(SortedByDistance(ids, target, k), ClosestNodes(ids, target, k));
+    }
+  }
+}
+
+TEST(ClosestNodesTest, BEH_Projection) {
+  struct Node {
+    NodeId id;
+    bool good;
+  };
+  auto ids(MakeIds(100, 0));
+  std::vector<Node> nodes;
+  for (const auto& id : ids)
+    nodes.push_back(Node{id, true});
+  NodeId target(RandomString(NodeId::kSize));
+  auto indices(ClosestNodes(nodes.begin(), nodes.end(), target, 8,
+                            [](const Node& node) -> const NodeId& { return node.id; }));
+  auto expected(SortedByDistance(ids, target, 8));
+  ASSERT_EQ(expected.size(), indices.size());
+  for (size_t i(0); i != indices.size(); ++i)
+    EXPECT_EQ(expected[i], nodes[indices[i]].id);
+}
+
+TEST(ClosestNodesTest, BEH_InvalidIds) {
+  auto ids(MakeIds(10, 0));
+  EXPECT_THROW(ClosestNodes(ids, NodeId(), 4), common_error);
+  ids.push_back(NodeId());
+  EXPECT_THROW(ClosestNodes(ids, NodeId(RandomString(NodeId::kSize)), 4), common_error);
+  EXPECT_TRUE(ClosestNodes(std::vector<NodeId>(), NodeId(RandomString(NodeId::kSize)), 4).empty());
+}
+
+TEST(ClosestNodesTest, FUNC_Parallel) {
+  auto ids(MakeIds(kMinClosestNodesPerThread * 5 + 3, 4));
+  for (int i(0); i != 5; ++i) {
+    NodeId target(RandomString(NodeId::kSize));
+    for (size_t k(1); k <= 1000; k *= 10) {
+      auto expected(ClosestNodes(ids, target, k));
+      EXPECT_EQ(expected, ClosestNodes(ids, target, k, 4));
+      EXPECT_EQ(expected, ClosestNodes(ids, target, k, 64));
+    }
+  }
+}
+
+}  // namespace test
+
+}  // namespace maidsafe
@@ -18,8 +18,16 @@
 
 #include "maidsafe/common/data_buffer.h"
 
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
 #include <utility>
+#include <vector>
 
+#include "maidsafe/common/asio_service.h"
 #include "maidsafe/common/error.h"
 #include "maidsafe/common/test.h"
 #include "maidsafe/common/utils.h"
@@ -82,6 +90,633 @@ TEST(DataBufferUnitTest, BEH_DiskOnlyInsertAndDeleteRange) {
   EXPECT_NO_THROW(data_buffer.Delete(predicate));
 }
 
+TEST(DataBufferUnitTest, BEH_SegmentFilesInsertAndDelete) {
+  DataBuffer<std::string> data_buffer(MemoryUsage(0), DiskUsage(100), nullptr,
+                                      DiskBackend::kSegmentFiles);
+  EXPECT_NO_THROW(data_buffer.Store("a", NonEmptyString("b")));
+  EXPECT_NO_THROW(data_buffer.Store("c", NonEmptyString("d")));
+  EXPECT_EQ(NonEmptyString("b"), data_buffer.Get("a"));
+  EXPECT_NO_THROW(data_buffer.Store("a", NonEmptyString("e")));
+  EXPECT_EQ(NonEmptyString("e"), data_buffer.Get("a"));
+  EXPECT_EQ(NonEmptyString("d"), data_buffer.Get("c"));
+  EXPECT_NO_THROW(data_buffer.Delete(std::string("a")));
+  EXPECT_THROW(data_buffer.Delete(std::string("a")), std::exception);
+  EXPECT_THROW(data_buffer.Get("a"), std::exception);
+}
+
+TEST(DataBufferUnitTest, BEH_SegmentFilesPopOnDiskFull) {
+  std::vector<std::string> popped;
+  DataBuffer<std::string> data_buffer(
+      MemoryUsage(0), DiskUsage(10), [&popped](const std::string& key, const NonEmptyString&) {
+        popped.push_back(key);
+      }, DiskBackend::kSegmentFiles);
+  for (int i(0); i != 20; ++i)
+    EXPECT_NO_THROW(data_buffer.Store(std::to_string(i), NonEmptyString("ab")));
+  ASSERT_EQ(15U, popped.size());
+  for (int i(0); i != 15; ++i) {
+    EXPECT_EQ(std::to_string(i), popped[i]);
+    EXPECT_THROW(data_buffer.Get(std::to_string(i)), std::exception);
+  }
+  for (int i(15); i != 20; ++i)
+    EXPECT_EQ(NonEmptyString("ab"), data_buffer.Get(std::to_string(i)));
+}
+
+TEST(DataBufferUnitTest, BEH_RecoverDiskIndex) {
+  maidsafe::test::TestPath test_path(maidsafe::test::CreateTestPath("MaidSafe_Test_DataBuffer"));
+  typedef std::pair<std::string, std::string> Key;
+  EXPECT_THROW(DataBuffer<Key>(MemoryUsage(0), DiskUsage(100), nullptr, *test_path / "pairs",
+                               false, DiskBackend::kFilePerValue, DiskRecovery::kRecover),
+               std::exception);
+
+  for (auto disk_backend : {DiskBackend::kFilePerValue, DiskBackend::kSegmentFiles}) {
+    fs::path root(*test_path / std::to_string(static_cast<int>(disk_backend)));
+    std::vector<std::string> keys;
+    {
+      DataBuffer<std::string> data_buffer(MemoryUsage(0), DiskUsage(500), nullptr, root, false,
+                                          disk_backend);
+      for (int i(0); i != 10; ++i) {
+        keys.push_back(std::string(1, 'a' + i));
+        EXPECT_NO_THROW(data_buffer.Store(keys.back(), NonEmptyString(std::string(50, 'a' + i))));
+      }
+    }
+    if (disk_backend == DiskBackend::kFilePerValue) {
+      // Without recovery, the existing values are ignored.
+      DataBuffer<std::string> data_buffer(MemoryUsage(0), DiskUsage(500), nullptr, root, false,
+                                          disk_backend);
+      EXPECT_THROW(data_buffer.Get(keys.front()), std::exception);
+    }
+    // A file-per-value write which never completed leaves a temporary file, which isn't recovered.
+    fs::path partial_file(root / (HexEncode("z") + ".partial"));
+    if (disk_backend == DiskBackend::kFilePerValue) {
+      ASSERT_TRUE(WriteFile(partial_file, std::string(50, 'z')));
+    }
+
+    std::vector<std::string> popped;
+    DataBuffer<std::string> data_buffer(
+        MemoryUsage(0), DiskUsage(500), [&popped](const std::string& key, const NonEmptyString&) {
+          popped.push_back(key);
+        }, root, true, disk_backend, DiskRecovery::kRecover);
+    for (int i(0); i != 10; ++i)
+      EXPECT_EQ(NonEmptyString(std::string(50, 'a' + i)), data_buffer.Get(keys[i]));
+    EXPECT_THROW(data_buffer.Get("z"), std::exception);
+    EXPECT_FALSE(fs::exists(partial_file));
+    EXPECT_NO_THROW(data_buffer.Delete(keys[1]));
+    EXPECT_THROW(data_buffer.Get(keys[1]), std::exception);
+
+    // The recovered values count against the disk limit, so this should pop one of them.
+    EXPECT_NO_THROW(data_buffer.Store("k", NonEmptyString(std::string(100, 'k'))));
+    ASSERT_EQ(1U, popped.size());
+    if (disk_backend == DiskBackend::kSegmentFiles) {
+      EXPECT_EQ(keys[0], popped.front());
+    }
+    EXPECT_EQ(NonEmptyString(std::string(100, 'k')), data_buffer.Get("k"));
+  }
+}
+
+TEST(DataBufferUnitTest, BEH_DeleteByPredicateThenRecover) {
+  maidsafe::test::TestPath test_path(maidsafe::test::CreateTestPath("MaidSafe_Test_DataBuffer"));
+  for (auto disk_backend : {DiskBackend::kFilePerValue, DiskBackend::kSegmentFiles}) {
+    fs::path root(*test_path / std::to_string(static_cast<int>(disk_backend)));
+    {
+      std::vector<std::string> popped;
+      DataBuffer<std::string> data_buffer(
+          MemoryUsage(0), DiskUsage(500), [&popped](const std::string& key, const NonEmptyString&) {
+            popped.push_back(key);
+          }, root, false, disk_backend);
+      for (int i(0); i != 10; ++i)
+        EXPECT_NO_THROW(data_buffer.Store(std::to_string(i), NonEmptyString(std::string(50, 'a'))));
+      std::function<bool(const std::string&)> is_even([](const std::string& key) {
+        return std::stoi(key) % 2 == 0;
+      });
+      EXPECT_NO_THROW(data_buffer.Delete(is_even));
+      // The deleted values' disk space has been released, so these fit without popping.
+      for (int i(10); i != 15; ++i)
+        EXPECT_NO_THROW(data_buffer.Store(std::to_string(i), NonEmptyString(std::string(50, 'b'))));
+      EXPECT_TRUE(popped.empty());
+    }
+    DataBuffer<std::string> data_buffer(MemoryUsage(0), DiskUsage(500), nullptr, root, true,
+                                        disk_backend, DiskRecovery::kRecover);
+    for (int i(0); i != 10; ++i) {
+      if (i % 2 == 0) {
+        EXPECT_THROW(data_buffer.Get(std::to_string(i)), std::exception);
+      } else {
+        EXPECT_EQ(NonEmptyString(std::string(50, 'a')), data_buffer.Get(std::to_string(i)));
+      }
+    }
+    for (int i(10); i != 15; ++i)
+      EXPECT_EQ(NonEmptyString(std::string(50, 'b')), data_buffer.Get(std::to_string(i)));
+  }
+}
+
+TEST(DataBufferUnitTest, BEH_DiskCompression) {
+  for (auto disk_backend : {DiskBackend::kFilePerValue, DiskBackend::kSegmentFiles}) {
+    std::vector<std::pair<std::string, NonEmptyString>> popped;
+    DataBuffer<std::string> data_buffer(
+        MemoryUsage(0), DiskUsage(2000), [&popped](const std::string& key,
+                                                   const NonEmptyString& value) {
+          popped.emplace_back(key, value);
+        }, disk_backend, DiskCompression::kGzip);
+    // Disk usage is measured in compressed bytes, so these all fit.
+    std::vector<NonEmptyString> values;
+    for (int i(0); i != 10; ++i) {
+      values.emplace_back(std::string(1000, 'a' + i));
+      EXPECT_NO_THROW(data_buffer.Store(std::to_string(i), values.back()));
+    }
+    EXPECT_TRUE(popped.empty());
+    // Neither do small values nor incompressible ones get any larger than one extra byte.
+    NonEmptyString small("small"), random(RandomString(1500));
+    EXPECT_NO_THROW(data_buffer.Store("small", small));
+    EXPECT_NO_THROW(data_buffer.Store("random", random));
+    EXPECT_TRUE(popped.empty());
+    for (int i(0); i != 10; ++i)
+      EXPECT_EQ(values[i], data_buffer.Get(std::to_string(i)));
+    EXPECT_EQ(small, data_buffer.Get("small"));
+    EXPECT_EQ(random, data_buffer.Get("random"));
+
+    // Popped values are handed back uncompressed.
+    EXPECT_NO_THROW(data_buffer.Store("random2", NonEmptyString(RandomString(1000))));
+    ASSERT_FALSE(popped.empty());
+    EXPECT_EQ("0", popped.front().first);
+    EXPECT_EQ(values.front(), popped.front().second);
+    EXPECT_THROW(data_buffer.Store("too large", NonEmptyString(std::string(2000, 'a'))),
+                 std::exception);
+  }
+
+  // Values compressed on their way from memory to disk.
+  maidsafe::test::TestPath test_path(maidsafe::test::CreateTestPath("MaidSafe_Test_DataBuffer"));
+  std::vector<NonEmptyString> values;
+  {
+    DataBuffer<std::string> data_buffer(MemoryUsage(1000), DiskUsage(2000), nullptr, *test_path,
+                                        false, DiskBackend::kFilePerValue, DiskRecovery::kNone,
+                                        DiskCompression::kGzip);
+    for (int i(0); i != 30; ++i) {
+      values.emplace_back(std::string(300, 'a' + i % 26) + RandomAlphaNumericString(10));
+      EXPECT_NO_THROW(data_buffer.Store(std::to_string(i), values.back()));
+    }
+    for (int i(0); i != 30; ++i)
+      EXPECT_EQ(values[i], data_buffer.Get(std::to_string(i)));
+  }
+  // Only the last few values can still have been held in memory alone.
+  DataBuffer<std::string> data_buffer(MemoryUsage(1000), DiskUsage(2000), nullptr, *test_path,
+                                      false, DiskBackend::kFilePerValue, DiskRecovery::kRecover,
+                                      DiskCompression::kGzip);
+  for (int i(0); i != 26; ++i)
+    EXPECT_EQ(values[i], data_buffer.Get(std::to_string(i)));
+}
+
+TEST(DataBufferUnitTest, BEH_CompressedValueAtMemoryLimit) {
+  // A compressed value can take a byte more on disk than in memory.
+  EXPECT_THROW(DataBuffer<std::string>(MemoryUsage(100), DiskUsage(100), nullptr,
+                                       DiskBackend::kFilePerValue, DiskCompression::kGzip),
+               std::exception);
+  EXPECT_NO_THROW(DataBuffer<std::string>(MemoryUsage(0), DiskUsage(0), nullptr,
+                                          DiskBackend::kFilePerValue, DiskCompression::kGzip));
+  DataBuffer<std::string> data_buffer(MemoryUsage(99), DiskUsage(100), nullptr,
+                                      DiskBackend::kFilePerValue, DiskCompression::kGzip);
+  EXPECT_THROW(data_buffer.SetMaxDiskUsage(DiskUsage(99)), std::exception);
+  EXPECT_THROW(data_buffer.SetMaxMemoryUsage(MemoryUsage(100)), std::exception);
+
+  // The largest value which fits in memory is copied to disk.
+  NonEmptyString largest(RandomString(99));
+  EXPECT_NO_THROW(data_buffer.Store("a", largest));
+  EXPECT_NO_THROW(data_buffer.Store("b", NonEmptyString("b")));
+  EXPECT_EQ(largest, data_buffer.Get("a"));
+
+  // A value too large for disk is rejected without stopping the buffer or replacing the old value.
+  EXPECT_THROW(data_buffer.Store("a", NonEmptyString(RandomString(100))), std::exception);
+  EXPECT_THROW(data_buffer.StoreBatch(std::vector<std::pair<std::string, NonEmptyString>>(
+                   1, std::make_pair(std::string("a"), NonEmptyString(RandomString(100))))),
+               std::exception);
+  EXPECT_EQ(largest, data_buffer.Get("a"));
+  EXPECT_NO_THROW(data_buffer.Store("c", NonEmptyString("c")));
+  EXPECT_EQ(NonEmptyString("c"), data_buffer.Get("c"));
+}
+
+TEST(DataBufferUnitTest, BEH_ManyElementsInsertAndDelete) {
+  const int kCount(1000);
+  DataBuffer<std::string> data_buffer(MemoryUsage(kCount), DiskUsage(2 * kCount), nullptr);
+  for (int i(0); i != kCount; ++i)
+    EXPECT_NO_THROW(data_buffer.Store(std::to_string(i), NonEmptyString(std::string(1, 'a'))));
+  for (int i(kCount - 1); i >= 0; i -= 2) {
+    EXPECT_EQ(NonEmptyString(std::string(1, 'a')), data_buffer.Get(std::to_string(i)));
+    EXPECT_NO_THROW(data_buffer.Delete(std::to_string(i)));
+    EXPECT_THROW(data_buffer.Get(std::to_string(i)), std::exception);
+  }
+  for (int i(0); i < kCount; i += 2)
+    EXPECT_EQ(NonEmptyString(std::string(1, 'a')), data_buffer.Get(std::to_string(i)));
+}
+
+TEST(DataBufferUnitTest, BEH_SharedValues) {
+  typedef DataBuffer<std::string>::SharedValue SharedValue;
+  DataBuffer<std::string> data_buffer(MemoryUsage(100), DiskUsage(200), nullptr);
+  EXPECT_THROW(data_buffer.Store("a", SharedValue()), std::exception);
+
+  // A value held in memory is handed out without being copied, and outlives its deletion.
+  SharedValue value(std::make_shared<const NonEmptyString>(RandomString(50)));
+  EXPECT_NO_THROW(data_buffer.Store("a", value));
+  SharedValue retrieved(data_buffer.GetShared("a"));
+  EXPECT_EQ(value.get(), retrieved.get());
+  EXPECT_NO_THROW(data_buffer.Delete(std::string("a")));
+  EXPECT_THROW(data_buffer.GetShared("a"), std::exception);
+  EXPECT_EQ(*value, *retrieved);
+
+  // A value too large for memory is read back from disk.
+  NonEmptyString large_value(RandomString(150));
+  NonEmptyString large_value_copy(large_value);
+  EXPECT_NO_THROW(data_buffer.Store("b", std::move(large_value)));
+  retrieved = data_buffer.GetShared("b");
+  ASSERT_TRUE(retrieved != nullptr);
+  EXPECT_EQ(large_value_copy, *retrieved);
+  EXPECT_EQ(large_value_copy, data_buffer.Get("b"));
+}
+
+TEST(DataBufferUnitTest, BEH_Batches) {
+  typedef DataBuffer<std::string>::SharedValue SharedValue;
+  const int kCount(100);
+  DataBuffer<std::string> data_buffer(MemoryUsage(kCount * 10), DiskUsage(kCount * 100), nullptr);
+  std::vector<std::pair<std::string, NonEmptyString>> elements;
+  std::vector<std::string> keys;
+  for (int i(0); i != kCount; ++i) {
+    keys.push_back(std::to_string(i));
+    elements.emplace_back(keys.back(), NonEmptyString(RandomString(i % 2 ? 10 : 40)));
+  }
+  // The last value for a repeated key wins.
+  elements.emplace_back(keys.front(), NonEmptyString("replaced"));
+  auto expected(elements);
+  expected.front().second = expected.back().second;
+  expected.pop_back();
+  // One value is too large for memory and must go straight to disk.
+  elements.emplace_back("large", NonEmptyString(RandomString(kCount * 10 + 1)));
+  expected.push_back(elements.back());
+  keys.push_back("large");
+
+  EXPECT_NO_THROW(data_buffer.StoreBatch(elements));
+  keys.push_back("missing");
+  std::vector<SharedValue> values(data_buffer.GetBatch(keys));
+  ASSERT_EQ(keys.size(), values.size());
+  for (size_t i(0); i != expected.size(); ++i) {
+    ASSERT_TRUE(values[i] != nullptr);
+    EXPECT_EQ(expected[i].second, *values[i]);
+  }
+  EXPECT_TRUE(values.back() == nullptr);
+
+  std::vector<std::string> odd_keys;
+  for (int i(1); i < kCount; i += 2)
+    odd_keys.push_back(keys[i]);
+  EXPECT_NO_THROW(data_buffer.DeleteBatch(odd_keys));
+  // Throws for the missing key, but deletes the others.
+  EXPECT_THROW(data_buffer.DeleteBatch(std::vector<std::string>{keys[0], "missing"}),
+               std::exception);
+  values = data_buffer.GetBatch(keys);
+  for (int i(0); i != kCount; ++i)
+    EXPECT_EQ(i == 0 || i % 2 == 1, values[i] == nullptr);
+  EXPECT_EQ(expected.back().second, *values[kCount]);
+
+  EXPECT_THROW(data_buffer.StoreBatch(std::vector<std::pair<std::string, SharedValue>>(
+                   1, std::make_pair(std::string("null"), SharedValue()))),
+               std::exception);
+}
+
+TEST(DataBufferUnitTest, BEH_SegmentFilesBatches) {
+  const int kCount(200);
+  DataBuffer<std::string> data_buffer(MemoryUsage(kCount * 5), DiskUsage(kCount * 100), nullptr,
+                                      DiskBackend::kSegmentFiles);
+  std::vector<std::pair<std::string, NonEmptyString>> elements;
+  std::vector<std::string> keys;
+  for (int i(0); i != kCount; ++i) {
+    keys.push_back(std::to_string(i));
+    elements.emplace_back(keys.back(), NonEmptyString(RandomString(20)));
+  }
+  EXPECT_NO_THROW(data_buffer.StoreBatch(elements));
+  auto values(data_buffer.GetBatch(keys));
+  for (int i(0); i != kCount; ++i) {
+    ASSERT_TRUE(values[i] != nullptr);
+    EXPECT_EQ(elements[i].second, *values[i]);
+  }
+  EXPECT_NO_THROW(data_buffer.DeleteBatch(keys));
+  for (const auto& value : data_buffer.GetBatch(keys))
+    EXPECT_TRUE(value == nullptr);
+}
+
+TEST(DataBufferUnitTest, BEH_TryStore) {
+  DataBuffer<std::string> data_buffer(MemoryUsage(100), DiskUsage(200), nullptr);
+  NonEmptyString value(RandomString(60));
+  // Each of these only has to wait for the previous value to be moved to disk.
+  for (const std::string key : {"a", "b", "c", "d"}) {
+    EXPECT_TRUE(data_buffer.TryStore(key, value, std::chrono::steady_clock::now() +
+                                                     std::chrono::seconds(10)));
+  }
+  // Disk now holds "a", "b" and "c" and is too full to take "d", so "d" can't leave memory and
+  // there's no space for "e" until something is deleted.
+  auto start(std::chrono::steady_clock::now());
+  EXPECT_FALSE(data_buffer.TryStore("e", value, start + std::chrono::milliseconds(100)));
+  EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(100));
+  EXPECT_THROW(data_buffer.Get("e"), std::exception);
+  // Replacing "d" succeeds though, since its own space counts as available.
+  NonEmptyString replacement(RandomString(60));
+  EXPECT_TRUE(data_buffer.TryStore("d", replacement, std::chrono::steady_clock::now()));
+  EXPECT_EQ(replacement, data_buffer.Get("d"));
+  // "a" is only on disk, so replacing it still needs memory space, and the failure leaves the
+  // existing value in place.
+  EXPECT_FALSE(data_buffer.TryStore("a", replacement, std::chrono::steady_clock::now()));
+  EXPECT_EQ(value, data_buffer.Get("a"));
+
+  // These are too large for memory, so go straight to disk.
+  EXPECT_FALSE(data_buffer.TryStore("e", NonEmptyString(RandomString(150)),
+                                    std::chrono::steady_clock::now()));
+  EXPECT_THROW(data_buffer.TryStore("e", NonEmptyString(RandomString(201)),
+                                    std::chrono::steady_clock::now()),
+               std::exception);
+
+  data_buffer.Delete(std::string("a"));
+  data_buffer.Delete(std::string("b"));
+  EXPECT_TRUE(data_buffer.TryStore("e", value, std::chrono::steady_clock::now() +
+                                                    std::chrono::seconds(10)));
+  EXPECT_EQ(value, data_buffer.Get("e"));
+}
+
+TEST(DataBufferUnitTest, BEH_Statistics) {
+  {
+    DataBuffer<std::string> data_buffer(MemoryUsage(0), DiskUsage(300), [](const std::string&,
+                                                                           const NonEmptyString&) {
+    });
+    for (const std::string key : {"a", "b", "c", "d", "e"})
+      EXPECT_NO_THROW(data_buffer.Store(key, NonEmptyString(RandomString(100))));
+    EXPECT_NO_THROW(data_buffer.Get("c"));
+    EXPECT_THROW(data_buffer.Get("a"), std::exception);
+    auto statistics(data_buffer.GetStatistics());
+    EXPECT_EQ(1U, statistics.hits.disk_hits);
+    EXPECT_EQ(1U, statistics.hits.misses);
+    EXPECT_EQ(0U, statistics.memory_bytes);
+    EXPECT_EQ(0U, statistics.memory_values);
+    EXPECT_EQ(300U, statistics.disk_bytes);
+    EXPECT_EQ(3U, statistics.disk_values);
+    EXPECT_EQ(0U, statistics.spill_queue_values);
+    EXPECT_EQ(2U, statistics.pops);
+    EXPECT_EQ(5U, statistics.disk_write_latency.count);
+    EXPECT_EQ(1U, statistics.disk_read_latency.count);
+    EXPECT_EQ(0, statistics.memory_wait_time.count());
+  }
+
+  // As in BEH_TryStore, "e" has to wait for memory space which never becomes available.
+  DataBuffer<std::string> data_buffer(MemoryUsage(100), DiskUsage(200), nullptr);
+  NonEmptyString value(RandomString(60));
+  for (const std::string key : {"a", "b", "c", "d"}) {
+    EXPECT_TRUE(data_buffer.TryStore(key, value, std::chrono::steady_clock::now() +
+                                                     std::chrono::seconds(10)));
+  }
+  EXPECT_FALSE(data_buffer.TryStore("e", value, std::chrono::steady_clock::now() +
+                                                    std::chrono::milliseconds(100)));
+  EXPECT_NO_THROW(data_buffer.Get("d"));
+  auto statistics(data_buffer.GetStatistics());
+  EXPECT_EQ(1U, statistics.hits.memory_hits);
+  EXPECT_EQ(60U, statistics.memory_bytes);
+  EXPECT_EQ(1U, statistics.memory_values);
+  EXPECT_EQ(180U, statistics.disk_bytes);
+  // "d" is stuck waiting for disk space, so has left the spill queue.
+  EXPECT_EQ(0U, statistics.spill_queue_values);
+  EXPECT_EQ(4U, statistics.disk_values);
+  EXPECT_GE(statistics.memory_wait_time, std::chrono::milliseconds(100));
+  EXPECT_EQ(0U, statistics.pops);
+}
+
+TEST(DataBufferUnitTest, FUNC_MultipleDiskWriters) {
+  EXPECT_THROW(DataBuffer<std::string>(MemoryUsage(0), DiskUsage(100), nullptr,
+                                       DiskBackend::kFilePerValue, DiskCompression::kNone, 0),
+               std::exception);
+  const int kThreadCount(8), kValuesPerThread(100), kValueSize(40);
+  for (auto disk_backend : {DiskBackend::kFilePerValue, DiskBackend::kSegmentFiles}) {
+    std::atomic<int> pop_count(0);
+    DataBuffer<std::string> data_buffer(
+        MemoryUsage(50 * kValueSize), DiskUsage(kThreadCount * kValuesPerThread * kValueSize),
+        [&](const std::string&, const NonEmptyString&) { ++pop_count; }, disk_backend,
+        DiskCompression::kNone, 4);
+    std::vector<std::future<std::vector<std::pair<std::string, NonEmptyString>>>> workers;
+    for (int thread(0); thread != kThreadCount; ++thread) {
+      workers.push_back(std::async(std::launch::async, [&, thread] {
+        std::vector<std::pair<std::string, NonEmptyString>> kept;
+        for (int i(0); i != kValuesPerThread; ++i) {
+          std::string key(std::to_string(thread) + "-" + std::to_string(i));
+          NonEmptyString value(RandomString(kValueSize));
+          data_buffer.Store(key, value);
+          EXPECT_EQ(value, data_buffer.Get(key));
+          if (i % 3 == 0) {
+            data_buffer.Delete(key);
+            EXPECT_THROW(data_buffer.Get(key), std::exception);
+            continue;
+          }
+          if (i % 5 == 0) {
+            value = NonEmptyString(RandomString(kValueSize));
+            data_buffer.Store(key, value);
+          }
+          kept.emplace_back(key, value);
+        }
+        return kept;
+      }));
+    }
+    std::vector<std::pair<std::string, NonEmptyString>> kept;
+    for (auto& worker : workers) {
+      auto thread_kept(worker.get());
+      kept.insert(kept.end(), thread_kept.begin(), thread_kept.end());
+    }
+    for (const auto& element : kept)
+      EXPECT_EQ(element.second, data_buffer.Get(element.first));
+
+    // Once the writers are idle, the disk should hold exactly the kept values.
+    auto statistics(data_buffer.GetStatistics());
+    for (int i(0); i != 1000 && statistics.disk_values != kept.size(); ++i) {
+      Sleep(std::chrono::milliseconds(10));
+      statistics = data_buffer.GetStatistics();
+    }
+    EXPECT_EQ(kept.size(), statistics.disk_values);
+    EXPECT_EQ(kept.size() * kValueSize, statistics.disk_bytes);
+    EXPECT_EQ(0, pop_count);
+  }
+
+  // With a small disk, the writers have to pop values stored by each other.
+  std::atomic<int> pop_count(0);
+  DataBuffer<std::string> data_buffer(
+      MemoryUsage(5 * kValueSize), DiskUsage(20 * kValueSize),
+      [&](const std::string&, const NonEmptyString&) { ++pop_count; },
+      DiskBackend::kFilePerValue, DiskCompression::kNone, 4);
+  std::vector<std::future<void>> workers;
+  for (int thread(0); thread != kThreadCount; ++thread) {
+    workers.push_back(std::async(std::launch::async, [&, thread] {
+      for (int i(0); i != kValuesPerThread; ++i) {
+        data_buffer.Store(std::to_string(thread) + "-" + std::to_string(i),
+                          NonEmptyString(RandomString(kValueSize)));
+      }
+    }));
+  }
+  for (auto& worker : workers)
+    EXPECT_NO_THROW(worker.get());
+  const uint64_t kTotal(kThreadCount * kValuesPerThread);
+  auto statistics(data_buffer.GetStatistics());
+  for (int i(0); i != 1000 && statistics.disk_values + statistics.pops != kTotal; ++i) {
+    Sleep(std::chrono::milliseconds(10));
+    statistics = data_buffer.GetStatistics();
+  }
+  EXPECT_LE(statistics.disk_bytes, 20U * kValueSize);
+  EXPECT_EQ(kTotal, statistics.disk_values + statistics.pops);
+  EXPECT_EQ(statistics.pops, static_cast<uint64_t>(pop_count));
+}
+
+TEST(DataBufferUnitTest, FUNC_OverwriteWhileStoringToDisk) {
+  // The first value for "k" takes a while to write.  The second is one byte too large to fit on
+  // disk alongside "a", and a third value can only fit in memory if the second is evicted.
+  const uint64_t kSize(8 * 1024 * 1024);
+  NonEmptyString first(RandomString(kSize)), third(RandomString(kSize / 2));
+  auto second(std::make_shared<const NonEmptyString>(RandomString(kSize + 1)));
+  int evicted(0);
+  for (int attempt(0); attempt != 20; ++attempt) {
+    DataBuffer<std::string> data_buffer(MemoryUsage(kSize + 100), DiskUsage(kSize + 100), nullptr,
+                                        DiskBackend::kFilePerValue, DiskCompression::kNone, 2);
+    data_buffer.Store("a", NonEmptyString(RandomString(100)));
+    auto statistics(data_buffer.GetStatistics());
+    for (int i(0); i != 1000 && statistics.disk_values != 1U; ++i) {
+      Sleep(std::chrono::milliseconds(1));
+      statistics = data_buffer.GetStatistics();
+    }
+    ASSERT_EQ(1U, statistics.disk_values);
+
+    // One writer is part way through writing the first value when it's replaced, and the other
+    // writer then takes the replacement and waits for disk space which never becomes available.
+    // The first writer finishing mustn't mark the replacement as stored.
+    // This spins rather than sleeps, since the write only takes a few milliseconds.  "a" is counted
+    // on disk before its write has been synced, so storing the replacement may have to wait briefly
+    // for "a" to become evictable from memory.
+    data_buffer.Store("k", first);
+    while (data_buffer.GetStatistics().spill_queue_values != 0)
+      std::this_thread::yield();
+    EXPECT_TRUE(data_buffer.TryStore("k", second,
+                                     std::chrono::steady_clock::now() + std::chrono::seconds(1)));
+    Sleep(std::chrono::milliseconds(50));
+    if (data_buffer.TryStore("x", third, std::chrono::steady_clock::now() +
+                                             std::chrono::milliseconds(10))) {
+      ++evicted;
+    }
+    EXPECT_EQ(*second, data_buffer.Get("k"));
+  }
+  EXPECT_EQ(0, evicted);
+}
+
+TEST(DataBufferUnitTest, BEH_AsyncStoreAndGet) {
+  typedef DataBuffer<std::string>::SharedValue SharedValue;
+  AsioService asio_service(2);
+  DataBuffer<std::string> data_buffer(MemoryUsage(100), DiskUsage(200), nullptr);
+  SharedValue value(std::make_shared<const NonEmptyString>(RandomString(60)));
+  auto stored(data_buffer.AsyncStore(asio_service, "a", value));
+  // There was space in memory, so this completes immediately.
+  EXPECT_TRUE(IsReady(stored));
+  EXPECT_NO_THROW(stored.get());
+  auto retrieved(data_buffer.AsyncGet(asio_service, "a"));
+  EXPECT_TRUE(IsReady(retrieved));
+  EXPECT_EQ(value, retrieved.get());
+
+  // Fill the disk and memory, so that storing "e" has to wait for "a" to be deleted.
+  for (const std::string key : {"b", "c", "d"})
+    data_buffer.Store(key, NonEmptyString(RandomString(60)));
+  stored = data_buffer.AsyncStore(asio_service, "e", value);
+  EXPECT_EQ(std::future_status::timeout, stored.wait_for(std::chrono::milliseconds(100)));
+  retrieved = data_buffer.AsyncGet(asio_service, "a");
+  EXPECT_EQ(*value, *retrieved.get());
+  data_buffer.Delete(std::string("a"));
+  EXPECT_NO_THROW(stored.get());
+  EXPECT_EQ(*value, *data_buffer.AsyncGet(asio_service, "e").get());
+
+  auto missing(data_buffer.AsyncGet(asio_service, "missing"));
+  EXPECT_THROW(missing.get(), std::exception);
+}
+
+TEST(DataBufferUnitTest, BEH_AsyncStoreTooLargeForMemory) {
+  typedef DataBuffer<std::string>::SharedValue SharedValue;
+  AsioService asio_service(2);
+  DataBuffer<std::string> data_buffer(MemoryUsage(100), DiskUsage(300), nullptr);
+  // Occupy both of the service's threads.
+  std::promise<void> release;
+  std::shared_future<void> released(release.get_future().share());
+  for (int i(0); i != 2; ++i)
+    asio_service.service().post([released] { released.wait(); });
+
+  // A value which fits in memory is still stored inline, but one which has to go to disk is only
+  // stored once a thread becomes free.
+  SharedValue small_value(std::make_shared<const NonEmptyString>(RandomString(60)));
+  SharedValue large_value(std::make_shared<const NonEmptyString>(RandomString(150)));
+  auto small_stored(data_buffer.AsyncStore(asio_service, "a", small_value));
+  auto large_stored(data_buffer.AsyncStore(asio_service, "b", large_value));
+  EXPECT_TRUE(IsReady(small_stored));
+  EXPECT_EQ(std::future_status::timeout, large_stored.wait_for(std::chrono::milliseconds(100)));
+  release.set_value();
+  EXPECT_NO_THROW(large_stored.get());
+  EXPECT_EQ(*small_value, data_buffer.Get("a"));
+  EXPECT_EQ(*large_value, data_buffer.Get("b"));
+}
+
+TEST(DataBufferUnitTest, BEH_ReadPromotionNone) {
+  DataBuffer<std::string> data_buffer(MemoryUsage(100), DiskUsage(1000), nullptr);
+  NonEmptyString value(RandomString(40));
+  // Only "b" and "c" fit in memory, so "a" is held on disk only.
+  data_buffer.Store("a", value);
+  data_buffer.Store("b", NonEmptyString(RandomString(40)));
+  data_buffer.Store("c", NonEmptyString(RandomString(40)));
+  data_buffer.Delete(std::string("c"));
+  for (int i(0); i != 3; ++i)
+    EXPECT_EQ(value, data_buffer.Get("a"));
+  EXPECT_THROW(data_buffer.Get("d"), std::exception);
+  DataBufferHitStatistics statistics(data_buffer.GetHitStatistics());
+  EXPECT_EQ(3U, statistics.disk_hits);
+  EXPECT_EQ(0U, statistics.memory_hits);
+  EXPECT_EQ(1U, statistics.misses);
+  EXPECT_EQ(0U, statistics.promotions);
+}
+
+TEST(DataBufferUnitTest, BEH_ReadPromotionLru) {
+  DataBuffer<std::string> data_buffer(MemoryUsage(100), DiskUsage(1000), nullptr);
+  data_buffer.SetReadPromotion(ReadPromotion::kLru);
+  NonEmptyString value(RandomString(40));
+  data_buffer.Store("a", value);
+  data_buffer.Store("b", NonEmptyString(RandomString(40)));
+  data_buffer.Store("c", NonEmptyString(RandomString(40)));
+  data_buffer.Delete(std::string("c"));
+  // The first Get reads "a" from disk and copies it into the free memory; later ones hit memory.
+  for (int i(0); i != 3; ++i)
+    EXPECT_EQ(value, data_buffer.Get("a"));
+  DataBufferHitStatistics statistics(data_buffer.GetHitStatistics());
+  EXPECT_EQ(1U, statistics.disk_hits);
+  EXPECT_EQ(2U, statistics.memory_hits);
+  EXPECT_EQ(1U, statistics.promotions);
+
+  // Deleting the promoted value removes both copies.
+  EXPECT_NO_THROW(data_buffer.Delete(std::string("a")));
+  EXPECT_THROW(data_buffer.Get("a"), std::exception);
+}
+
+TEST(DataBufferUnitTest, BEH_ReadPromotionTinyLfuResistsScan) {
+  DataBuffer<std::string> data_buffer(MemoryUsage(100), DiskUsage(1000), nullptr);
+  data_buffer.SetReadPromotion(ReadPromotion::kTinyLfu);
+  std::vector<std::string> cold_keys;
+  data_buffer.Store("hot", NonEmptyString(RandomString(40)));
+  for (int i(0); i != 10; ++i) {
+    cold_keys.push_back("cold" + std::to_string(i));
+    data_buffer.Store(cold_keys.back(), NonEmptyString(RandomString(40)));
+  }
+
+  // Memory is full, so "hot" can only be promoted once the disk worker has finished storing a
+  // value which can be evicted for it.
+  for (int i(0); i != 1000 && data_buffer.GetHitStatistics().promotions == 0; ++i) {
+    EXPECT_NO_THROW(data_buffer.Get("hot"));
+    Sleep(std::chrono::milliseconds(1));
+  }
+  ASSERT_EQ(1U, data_buffer.GetHitStatistics().promotions);
+
+  // A scan over the cold values must not evict "hot", since each has been requested less often.
+  for (size_t i(0); i != cold_keys.size() - 2; ++i)
+    EXPECT_NO_THROW(data_buffer.Get(cold_keys[i]));
+  DataBufferHitStatistics statistics(data_buffer.GetHitStatistics());
+  EXPECT_GE(statistics.rejected_promotions, cold_keys.size() - 3);
+  EXPECT_NO_THROW(data_buffer.Get("hot"));
+  EXPECT_EQ(statistics.memory_hits + 1, data_buffer.GetHitStatistics().memory_hits);
+}
 
 }  // namespace test
 
@@ -0,0 +1,89 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/common/latency_histogram.h"
+
+#include <chrono>
+#include <future>
+#include <vector>
+
+#include "maidsafe/common/test.h"
+
+namespace maidsafe {
+
+namespace test {
+
+TEST(LatencyHistogramTest, BEH_RecordAndPercentiles) {
+  LatencyHistogram histogram;
+  auto snapshot(histogram.GetSnapshot());
+  EXPECT_EQ(0U, snapshot.count);
+  EXPECT_EQ(0U, snapshot.Percentile(50));
+  EXPECT_EQ(0U, snapshot.MeanMicroseconds());
+
+  for (int i(0); i != 90; ++i)
+    histogram.Record(std::chrono::microseconds(3));
+  for (int i(0); i != 10; ++i)
+    histogram.Record(std::chrono::milliseconds(1));
+  histogram.Record(std::chrono::nanoseconds(10));
+  snapshot = histogram.GetSnapshot();
+  EXPECT_EQ(101U, snapshot.count);
+  EXPECT_EQ(90U * 3 + 10 * 1000, snapshot.total_microseconds);
+  EXPECT_EQ(1U, snapshot.buckets[0]);
+  EXPECT_EQ(90U, snapshot.buckets[2]);
+  EXPECT_EQ(10U, snapshot.buckets[10]);
+  EXPECT_EQ(1U, snapshot.Percentile(0));
+  EXPECT_EQ(4U, snapshot.Percentile(50));
+  EXPECT_EQ(1024U, snapshot.Percentile(99));
+  EXPECT_EQ(1024U, snapshot.Percentile(100));
+  EXPECT_EQ((90U * 3 + 10 * 1000) / 101, snapshot.MeanMicroseconds());
+
+  // Anything too long for the last bucket is counted in it.
+  histogram.Record(std::chrono::hours(24 * 365));
+  EXPECT_EQ(1U, histogram.GetSnapshot().buckets.back());
+
+  LatencyHistogram::Snapshot total;
+  total += snapshot;
+  total += snapshot;
+  EXPECT_EQ(202U, total.count);
+  EXPECT_EQ(180U, total.buckets[2]);
+  EXPECT_EQ(4U, total.Percentile(50));
+}
+
+TEST(LatencyHistogramTest, FUNC_ConcurrentRecord) {
+  const int kThreadCount(8), kSamplesPerThread(10000);
+  LatencyHistogram histogram;
+  std::vector<std::future<void>> workers;
+  for (int thread(0); thread != kThreadCount; ++thread) {
+    workers.push_back(std::async(std::launch::async, [&histogram] {
+      for (int i(0); i != kSamplesPerThread; ++i)
+        histogram.Record(std::chrono::microseconds(i % 100));
+    }));
+  }
+  for (auto& worker : workers)
+    worker.get();
+  auto snapshot(histogram.GetSnapshot());
+  EXPECT_EQ(static_cast<uint64_t>(kThreadCount * kSamplesPerThread), snapshot.count);
+  uint64_t bucket_total(0);
+  for (auto bucket : snapshot.buckets)
+    bucket_total += bucket;
+  EXPECT_EQ(snapshot.count, bucket_total);
+}
+
+}  // namespace test
+
+}  // namespace maidsafe
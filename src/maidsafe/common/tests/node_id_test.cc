@@ -22,6 +22,7 @@
 #include <bitset>
 #include <sstream>
 #include <string>
+#include <vector>
 
 #include "maidsafe/common/error.h"
 #include "maidsafe/common/log.h"
@@ -325,6 +326,33 @@ TEST_F(NodeIdTest, BEH_Operators) {
 #endif
 }
 
+TEST_F(NodeIdTest, BEH_ComparisonsMatchRawStrings) {
+  // IDs sharing a common prefix, so that they differ in varying words and bytes.
+  std::vector<std::string> raw_ids;
+  for (int i(0); i != 200; ++i) {
+    std::string raw_id(id1_.string());
+    size_t first_difference(RandomUint32() % NodeId::kSize);
+    for (size_t j(first_difference); j != NodeId::kSize; ++j)
+      raw_id[j] = static_cast<char>(RandomUint32());
+    raw_ids.push_back(raw_id);
+  }
+  for (const auto& lhs : raw_ids) {
+    for (const auto& rhs : raw_ids) {
+      EXPECT_EQ(lhs == rhs, NodeId{lhs} == NodeId{rhs});
+      EXPECT_EQ(lhs < rhs, NodeId{lhs} < NodeId{rhs});
+    }
+  }
+
+  // A valid all-zero ID is distinct from an invalid one.
+  const NodeId zero_id{std::string(NodeId::kSize, 0)};
+#ifdef USE_DEPRECATED_NODE_ID_BEHAVIOUR
+  EXPECT_EQ(invalid_id_, zero_id);
+#else
+  EXPECT_NE(invalid_id_, zero_id);
+  EXPECT_LT(invalid_id_, zero_id);
+#endif
+}
+
 TEST_F(NodeIdTest, BEH_CloserToTarget) {
   auto target = NodeId{RandomString(NodeId::kSize)};
   while (target == id1_ || target == id2_)
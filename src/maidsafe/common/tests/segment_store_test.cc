@@ -0,0 +1,244 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/common/segment_store.h"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "boost/filesystem/operations.hpp"
+
+#include "maidsafe/common/error.h"
+#include "maidsafe/common/test.h"
+#include "maidsafe/common/utils.h"
+
+namespace fs = boost::filesystem;
+
+namespace maidsafe {
+
+namespace test {
+
+TEST(SegmentStoreTest, BEH_PutGetRemove) {
+  TestPath test_path(CreateTestPath("MaidSafe_Test_SegmentStore"));
+  SegmentStore segment_store(*test_path, 1024);
+  EXPECT_FALSE(segment_store.Has("a"));
+  EXPECT_THROW(segment_store.Get("a"), common_error);
+  EXPECT_THROW(segment_store.Remove("a", nullptr), common_error);
+
+  EXPECT_TRUE(segment_store.Put("a", "value a"));
+  EXPECT_TRUE(segment_store.Put("b", "value b"));
+  EXPECT_TRUE(segment_store.Has("a"));
+  EXPECT_EQ(NonEmptyString("value a"), segment_store.Get("a"));
+  EXPECT_EQ(NonEmptyString("value b"), segment_store.Get("b"));
+  EXPECT_EQ(14U, segment_store.LiveValueBytes());
+
+  // Overwrite
+  EXPECT_TRUE(segment_store.Put("a", "new value a"));
+  EXPECT_EQ(NonEmptyString("new value a"), segment_store.Get("a"));
+  EXPECT_EQ(18U, segment_store.LiveValueBytes());
+
+  NonEmptyString removed;
+  EXPECT_EQ(11U, segment_store.Remove("a", &removed));
+  EXPECT_EQ(NonEmptyString("new value a"), removed);
+  EXPECT_FALSE(segment_store.Has("a"));
+  EXPECT_THROW(segment_store.Get("a"), common_error);
+  EXPECT_EQ(7U, segment_store.Remove("b", nullptr));
+  EXPECT_EQ(0U, segment_store.LiveValueBytes());
+}
+
+TEST(SegmentStoreTest, BEH_PutBatch) {
+  TestPath test_path(CreateTestPath("MaidSafe_Test_SegmentStore"));
+  SegmentStore segment_store(*test_path, 1024);
+  std::vector<std::string> values;
+  for (int i(0); i != 10; ++i)
+    values.push_back(RandomString(100));
+  std::vector<SegmentStore::NamedValue> batch;
+  for (int i(0); i != 10; ++i)
+    batch.emplace_back(std::to_string(i), std::cref(values[i]));
+  // A batch larger than the segment size gets a segment of its own.
+  EXPECT_TRUE(segment_store.PutBatch(batch));
+  EXPECT_EQ(1U, segment_store.SegmentCount());
+  EXPECT_EQ(1000U, segment_store.LiveValueBytes());
+  for (int i(0); i != 10; ++i)
+    EXPECT_EQ(NonEmptyString(values[i]), segment_store.Get(std::to_string(i)));
+  EXPECT_TRUE(segment_store.PutBatch(std::vector<SegmentStore::NamedValue>()));
+}
+
+TEST(SegmentStoreTest, BEH_RemovesStaleSegments) {
+  TestPath test_path(CreateTestPath("MaidSafe_Test_SegmentStore"));
+  {
+    SegmentStore segment_store(*test_path, 1024);
+    EXPECT_TRUE(segment_store.Put("a", "value a"));
+    EXPECT_TRUE(fs::exists(*test_path / "segment_1"));
+  }
+  EXPECT_TRUE(fs::exists(*test_path / "segment_1"));
+  EXPECT_TRUE(WriteFile(*test_path / "other", "other"));
+  SegmentStore segment_store(*test_path, 1024);
+  EXPECT_FALSE(fs::exists(*test_path / "segment_1"));
+  EXPECT_TRUE(fs::exists(*test_path / "other"));
+  EXPECT_FALSE(segment_store.Has("a"));
+  EXPECT_THROW(SegmentStore(*test_path / "other"), common_error);
+}
+
+TEST(SegmentStoreTest, BEH_RecoversSegments) {
+  TestPath test_path(CreateTestPath("MaidSafe_Test_SegmentStore"));
+  {
+    SegmentStore segment_store(*test_path, 1000);
+    for (int i(0); i != 20; ++i)
+      EXPECT_TRUE(segment_store.Put(std::to_string(i), std::string(100, 'a' + i)));
+    EXPECT_TRUE(segment_store.Put("0", "new value 0"));
+    EXPECT_EQ(100U, segment_store.Remove("1", nullptr));
+  }
+  SegmentStore segment_store(*test_path, 1000, true);
+  EXPECT_FALSE(segment_store.Has("1"));
+  EXPECT_EQ(NonEmptyString("new value 0"), segment_store.Get("0"));
+  for (int i(2); i != 20; ++i)
+    EXPECT_EQ(NonEmptyString(std::string(100, 'a' + i)), segment_store.Get(std::to_string(i)));
+  EXPECT_EQ(18 * 100U + 11U, segment_store.LiveValueBytes());
+
+  // Values are listed in the order they were stored.
+  auto contents(segment_store.Contents());
+  ASSERT_EQ(19U, contents.size());
+  EXPECT_EQ("2", contents.front().first);
+  EXPECT_EQ(100U, contents.front().second);
+  EXPECT_EQ("0", contents.back().first);
+  EXPECT_EQ(11U, contents.back().second);
+
+  // New values are appended after the recovered ones.
+  size_t segment_count(segment_store.SegmentCount());
+  EXPECT_TRUE(segment_store.Put("new", "new value"));
+  EXPECT_EQ(NonEmptyString("new value"), segment_store.Get("new"));
+  EXPECT_GE(segment_count + 1, segment_store.SegmentCount());
+  EXPECT_EQ(NonEmptyString("new value 0"), segment_store.Get("0"));
+}
+
+TEST(SegmentStoreTest, BEH_RecoveryIgnoresIncompleteRecords) {
+  TestPath test_path(CreateTestPath("MaidSafe_Test_SegmentStore"));
+  fs::path segment_path(*test_path / "segment_1");
+  {
+    SegmentStore segment_store(*test_path, 1000);
+    EXPECT_TRUE(segment_store.Put("a", std::string(100, 'a')));
+    EXPECT_TRUE(segment_store.Put("b", std::string(100, 'b')));
+  }
+  // Simulate a crash part way through writing "b" by zeroing the end of its value, which is the
+  // last thing in the segment before the preallocated (zeroed) space.
+  std::string contents(ReadFile(segment_path).string());
+  size_t end_of_b(contents.find_last_not_of('\0') + 1);
+  std::fill(contents.begin() + (end_of_b - 20), contents.begin() + end_of_b, '\0');
+  ASSERT_TRUE(WriteFile(segment_path, contents));
+
+  SegmentStore segment_store(*test_path, 1000, true);
+  EXPECT_EQ(NonEmptyString(std::string(100, 'a')), segment_store.Get("a"));
+  EXPECT_FALSE(segment_store.Has("b"));
+  EXPECT_EQ(100U, segment_store.LiveValueBytes());
+  // The segment has been cut off after "a" and sealed, so new values go to a new segment.
+  uint64_t recovered_size(fs::file_size(segment_path));
+  EXPECT_LT(recovered_size, end_of_b - 100);
+  EXPECT_TRUE(segment_store.Put("c", std::string(100, 'c')));
+  EXPECT_EQ(recovered_size, fs::file_size(segment_path));
+  EXPECT_EQ(2U, segment_store.SegmentCount());
+  EXPECT_EQ(NonEmptyString(std::string(100, 'c')), segment_store.Get("c"));
+}
+
+TEST(SegmentStoreTest, BEH_RolloverAndCompaction) {
+  TestPath test_path(CreateTestPath("MaidSafe_Test_SegmentStore"));
+  const size_t kValueSize(100), kCount(50);
+  SegmentStore segment_store(*test_path, 1000);
+  for (size_t i(0); i != kCount; ++i)
+    EXPECT_TRUE(segment_store.Put(std::to_string(i), std::string(kValueSize, 'a' + i % 26)));
+  size_t segment_count(segment_store.SegmentCount());
+  EXPECT_LT(5U, segment_count);
+
+  // Oversized values get a segment of their own
+  EXPECT_TRUE(segment_store.Put("large", std::string(5000, 'x')));
+  EXPECT_EQ(segment_count + 1, segment_store.SegmentCount());
+  EXPECT_EQ(NonEmptyString(std::string(5000, 'x')), segment_store.Get("large"));
+
+  // Remove most values, leaving every sealed segment mostly dead
+  for (size_t i(0); i != kCount; ++i) {
+    if (i % 5 != 0)
+      segment_store.Remove(std::to_string(i), nullptr);
+  }
+  segment_store.Compact();
+  EXPECT_GT(segment_count, segment_store.SegmentCount());
+  for (size_t i(0); i != kCount; i += 5)
+    EXPECT_EQ(NonEmptyString(std::string(kValueSize, 'a' + i % 26)),
+              segment_store.Get(std::to_string(i)));
+  EXPECT_EQ((kCount / 5) * kValueSize + 5000, segment_store.LiveValueBytes());
+}
+
+TEST(SegmentStoreTest, BEH_CompactedRecordsStayDeleted) {
+  TestPath test_path(CreateTestPath("MaidSafe_Test_SegmentStore"));
+  fs::path segment_path(*test_path / "segment_1"), held_path(*test_path / "held");
+  {
+    SegmentStore segment_store(*test_path, 1000);
+    EXPECT_TRUE(segment_store.Put("a", std::string(100, 'a')));
+    EXPECT_TRUE(segment_store.Put("b", std::string(100, 'b')));
+    segment_store.Remove("b", nullptr);
+    // Keep hold of the first segment's contents after compaction removes it, as though the store
+    // had crashed before the removal.
+    fs::create_hard_link(segment_path, held_path);
+    // Seals the first segment, which is half dead so gets compacted.
+    EXPECT_TRUE(segment_store.Put("large", std::string(1000, 'x')));
+    for (int i(0); i != 100 && fs::exists(segment_path); ++i) {
+      segment_store.Compact();
+      Sleep(std::chrono::milliseconds(10));
+    }
+    ASSERT_FALSE(fs::exists(segment_path));
+    EXPECT_EQ(NonEmptyString(std::string(100, 'a')), segment_store.Get("a"));
+    segment_store.Remove("a", nullptr);
+  }
+  fs::rename(held_path, segment_path);
+  SegmentStore segment_store(*test_path, 1000, true);
+  EXPECT_FALSE(segment_store.Has("a"));
+  EXPECT_FALSE(segment_store.Has("b"));
+  EXPECT_EQ(NonEmptyString(std::string(1000, 'x')), segment_store.Get("large"));
+  EXPECT_EQ(1000U, segment_store.LiveValueBytes());
+}
+
+TEST(SegmentStoreTest, BEH_SealsMostlyDeadActiveSegment) {
+  TestPath test_path(CreateTestPath("MaidSafe_Test_SegmentStore"));
+  fs::path segment_path(*test_path / "segment_1");
+  SegmentStore segment_store(*test_path, 1000);
+  EXPECT_TRUE(segment_store.Put("a", std::string(100, 'a')));
+  // Churn well short of filling the active segment, but leaving half of its capacity dead.  It
+  // should be sealed and compacted rather than left holding the dead records.
+  for (int i(0); i != 4; ++i) {
+    EXPECT_TRUE(segment_store.Put("b", std::string(100, 'b')));
+    segment_store.Remove("b", nullptr);
+  }
+  for (int i(0); i != 100 && fs::exists(segment_path); ++i) {
+    segment_store.Compact();
+    Sleep(std::chrono::milliseconds(10));
+  }
+  EXPECT_FALSE(fs::exists(segment_path));
+  EXPECT_EQ(1U, segment_store.SegmentCount());
+  EXPECT_EQ(NonEmptyString(std::string(100, 'a')), segment_store.Get("a"));
+  EXPECT_EQ(100U, segment_store.LiveValueBytes());
+
+  EXPECT_EQ(SegmentStore::kMinSegmentSize, SegmentStore::SegmentSizeFor(1024));
+  EXPECT_EQ(1024 * 1024U, SegmentStore::SegmentSizeFor(8 * 1024 * 1024));
+  EXPECT_EQ(SegmentStore::kDefaultSegmentSize, SegmentStore::SegmentSizeFor(1ULL << 40));
+}
+
+}  // namespace test
+
+}  // namespace maidsafe
@@ -0,0 +1,153 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/common/sharded_data_buffer.h"
+
+#include <atomic>
+#include <future>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "maidsafe/common/error.h"
+#include "maidsafe/common/test.h"
+#include "maidsafe/common/utils.h"
+
+namespace fs = boost::filesystem;
+
+namespace maidsafe {
+
+namespace data_stores {
+
+namespace test {
+
+TEST(ShardedDataBufferTest, BEH_Construct) {
+  EXPECT_THROW(ShardedDataBuffer<std::string>(MemoryUsage(0), DiskUsage(100), nullptr, 0),
+               std::exception);
+  EXPECT_THROW(ShardedDataBuffer<std::string>(MemoryUsage(8), DiskUsage(4), nullptr, 4),
+               std::exception);
+  ShardedDataBuffer<std::string> data_buffer(MemoryUsage(0), DiskUsage(100), nullptr, 4);
+  EXPECT_EQ(4U, data_buffer.shard_count());
+}
+
+TEST(ShardedDataBufferTest, BEH_StoreGetDelete) {
+  maidsafe::test::TestPath test_path(maidsafe::test::CreateTestPath("MaidSafe_Test_Sharded"));
+  fs::path root(*test_path / "sharded");
+  {
+    typedef std::pair<std::string, std::string> Key;
+    ShardedDataBuffer<Key> data_buffer(MemoryUsage(1000), DiskUsage(4000), nullptr, 4, root,
+                                       true);
+    for (uint32_t i(0); i != 4; ++i)
+      EXPECT_TRUE(fs::exists(root / ("shard_" + std::to_string(i))));
+
+    std::vector<std::pair<Key, NonEmptyString>> values;
+    for (int i(0); i != 100; ++i) {
+      values.emplace_back(std::make_pair(RandomAlphaNumericString(8), std::to_string(i % 2)),
+                          NonEmptyString(RandomString(20)));
+      EXPECT_NO_THROW(data_buffer.Store(values.back().first, values.back().second));
+    }
+    for (const auto& value : values)
+      EXPECT_EQ(value.second, data_buffer.Get(value.first));
+
+    EXPECT_NO_THROW(data_buffer.Delete(values.front().first));
+    EXPECT_THROW(data_buffer.Get(values.front().first), std::exception);
+
+    std::function<bool(const Key&)> predicate([](const Key& key) { return key.second == "1"; });
+    EXPECT_NO_THROW(data_buffer.Delete(predicate));
+    for (size_t i(1); i != values.size(); ++i) {
+      if (values[i].first.second == "1")
+        EXPECT_THROW(data_buffer.Get(values[i].first), std::exception);
+      else
+        EXPECT_EQ(values[i].second, data_buffer.Get(values[i].first));
+    }
+  }
+  EXPECT_FALSE(fs::exists(root));
+}
+
+TEST(ShardedDataBufferTest, BEH_Batches) {
+  ShardedDataBuffer<std::string> data_buffer(MemoryUsage(4000), DiskUsage(40000), nullptr, 4);
+  std::vector<std::pair<std::string, NonEmptyString>> elements;
+  std::vector<std::string> keys;
+  for (int i(0); i != 100; ++i) {
+    keys.push_back(RandomAlphaNumericString(8));
+    elements.emplace_back(keys.back(), NonEmptyString(RandomString(30)));
+  }
+  EXPECT_NO_THROW(data_buffer.StoreBatch(elements));
+  auto values(data_buffer.GetBatch(keys));
+  ASSERT_EQ(keys.size(), values.size());
+  for (size_t i(0); i != keys.size(); ++i) {
+    ASSERT_TRUE(values[i] != nullptr);
+    EXPECT_EQ(elements[i].second, *values[i]);
+  }
+  keys.push_back("missing");
+  EXPECT_THROW(data_buffer.DeleteBatch(keys), std::exception);
+  for (const auto& value : data_buffer.GetBatch(keys))
+    EXPECT_TRUE(value == nullptr);
+}
+
+TEST(ShardedDataBufferTest, BEH_SetMaxUsage) {
+  ShardedDataBuffer<std::string> data_buffer(MemoryUsage(0), DiskUsage(10), nullptr, 3);
+  EXPECT_THROW(data_buffer.SetMaxMemoryUsage(MemoryUsage(11)), std::exception);
+  EXPECT_NO_THROW(data_buffer.SetMaxMemoryUsage(MemoryUsage(10)));
+  EXPECT_THROW(data_buffer.SetMaxDiskUsage(DiskUsage(9)), std::exception);
+  EXPECT_NO_THROW(data_buffer.SetMaxDiskUsage(DiskUsage(3000)));
+  EXPECT_NO_THROW(data_buffer.SetMaxMemoryUsage(MemoryUsage(2999)));
+  EXPECT_NO_THROW(data_buffer.SetMaxMemoryUsage(MemoryUsage(3000)));
+  EXPECT_NO_THROW(data_buffer.SetMaxMemoryUsage(MemoryUsage(1000)));
+
+  // Each shard should now hold up to 1000 bytes on disk, so all of these fit in any one shard.
+  std::vector<std::string> keys;
+  for (int i(0); i != 15; ++i) {
+    keys.push_back(RandomAlphaNumericString(10));
+    EXPECT_NO_THROW(data_buffer.Store(keys.back(), NonEmptyString(RandomString(50))));
+  }
+  for (const auto& key : keys)
+    EXPECT_NO_THROW(data_buffer.Get(key));
+}
+
+TEST(ShardedDataBufferTest, FUNC_ConcurrentStoreAndGet) {
+  const int kThreadCount(8), kValuesPerThread(200);
+  std::atomic<int> pop_count(0);
+  ShardedDataBuffer<std::string> data_buffer(
+      MemoryUsage(kThreadCount * kValuesPerThread * 10),
+      DiskUsage(kThreadCount * kValuesPerThread * 100),
+      [&](const std::string&, const NonEmptyString&) { ++pop_count; }, 8);
+
+  std::vector<std::future<void>> workers;
+  for (int thread(0); thread != kThreadCount; ++thread) {
+    workers.push_back(std::async(std::launch::async, [&, thread] {
+      for (int i(0); i != kValuesPerThread; ++i) {
+        std::string key(std::to_string(thread) + "-" + std::to_string(i));
+        NonEmptyString value(key + RandomString(20));
+        data_buffer.Store(key, value);
+        EXPECT_EQ(value, data_buffer.Get(key));
+        if (i % 3 == 0)
+          data_buffer.Delete(key);
+      }
+    }));
+  }
+  for (auto& worker : workers)
+    EXPECT_NO_THROW(worker.get());
+  EXPECT_EQ(0, pop_count);
+}
+
+}  // namespace test
+
+}  // namespace data_stores
+
+}  // namespace maidsafe
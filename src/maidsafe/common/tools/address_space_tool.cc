@@ -29,6 +29,7 @@
 #include "cereal/cereal.hpp"
 #include "cereal/archives/json.hpp"
 
+#include "maidsafe/common/closest_nodes.h"
 #include "maidsafe/common/log.h"
 #include "maidsafe/common/utils.h"
 
@@ -40,6 +41,34 @@ namespace tools {
 
 const std::string kDefaultConfigFilename{"address_space_tool.conf"};
 
+namespace {
+
+std::vector<size_t> ClosestNodeIndices(const std::vector<Node>& nodes, const NodeId& target,
+                                       size_t count) {
+  return ClosestNodes(std::begin(nodes), std::end(nodes), target, count,
+                      [](const Node& node) -> const NodeId& { return node.id; });
+}
+
+// Reorders 'nodes' so that the 'count' closest to 'target' are first, closest first.  The order of
+// the remainder is unspecified.
+void MoveClosestToFront(std::vector<Node>& nodes, const NodeId& target, size_t count) {
+  auto closest(ClosestNodeIndices(nodes, target, count));
+  std::vector<bool> is_closest(nodes.size(), false);
+  std::vector<Node> reordered;
+  reordered.reserve(nodes.size());
+  for (auto index : closest) {
+    reordered.push_back(std::move(nodes[index]));
+    is_closest[index] = true;
+  }
+  for (size_t i(0); i != nodes.size(); ++i) {
+    if (!is_closest[i])
+      reordered.push_back(std::move(nodes[i]));
+  }
+  nodes.swap(reordered);
+}
+
+}  // unnamed namespace
+
 int Test::Accumulate(std::vector<Node>::const_iterator first,
                      std::vector<Node>::const_iterator last, const NodeId& target, int& highest,
                      int& lowest) const {
@@ -130,10 +159,7 @@ void Test::AddNode(bool good) {
   for (;;) {
     ++attempts;
     NodeId node_id(RandomString(NodeId::kSize));
-    std::partial_sort(std::begin(all_nodes_), std::begin(all_nodes_) + group_size,
-                      std::end(all_nodes_), [&node_id](const Node& lhs, const Node& rhs) {
-      return NodeId::CloserToTarget(lhs.id, rhs.id, node_id);
-    });
+    MoveClosestToFront(all_nodes_, node_id, group_size);
     UpdateRank(group_size);
     if (all_nodes_.size() > (config_.group_size * 4) && !RankAllowed(group_size))
       continue;
@@ -190,12 +216,10 @@ std::vector<NodeId> Test::GetUniformlyDistributedTargetPoints() const {
 }
 
 BadGroup Test::GetBadGroup(const NodeId& target_id) const {
-  std::vector<Node> bad_group{config_.group_size};
+  std::vector<Node> bad_group;
   // Get close group
-  std::partial_sort_copy(std::begin(all_nodes_), std::end(all_nodes_), std::begin(bad_group),
-                         std::end(bad_group), [&target_id](const Node& lhs, const Node& rhs) {
-    return NodeId::CloserToTarget(lhs.id, rhs.id, target_id);
-  });
+  for (auto index : ClosestNodeIndices(all_nodes_, target_id, config_.group_size))
+    bad_group.push_back(all_nodes_[index]);
   auto is_bad([](const Node& node) { return !node.good; });
   // Count bad nodes in close group and return the group if majority are bad
   if (static_cast<size_t>(std::count_if(std::begin(bad_group), std::end(bad_group), is_bad)) >=
@@ -0,0 +1,225 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+// Replays a trace of key requests against a PolicyCache using each eviction policy in turn, and
+// prints the hit ratio of each as one line of JSON.  Every request is a Get, followed by an Add of
+// the key if that missed.
+//
+// The trace is either read from a file holding one request per line (only the first
+// whitespace-separated token of each line is used as the key), or is generated: requests for
+// Zipf-distributed keys, interrupted periodically by a scan of keys which are each requested once.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "boost/program_options.hpp"
+
+#include "maidsafe/common/error.h"
+#include "maidsafe/common/log.h"
+#include "maidsafe/common/containers/policy_cache.h"
+
+namespace po = boost::program_options;
+
+namespace {
+
+struct SyntheticTrace {
+  SyntheticTrace()
+      : request_count(1000000),
+        key_count(100000),
+        scan_length(20000),
+        scan_interval(200000),
+        seed(0),
+        zipf_exponent(0.9) {}
+  uint64_t request_count, key_count, scan_length, scan_interval;
+  uint32_t seed;
+  double zipf_exponent;
+};
+
+struct ReplayResult {
+  ReplayResult() : requests(0), hits(0) {}
+  uint64_t requests, hits;
+};
+
+std::string ToString(maidsafe::EvictionPolicy policy) {
+  switch (policy) {
+    case maidsafe::EvictionPolicy::kLru:
+      return "lru";
+    case maidsafe::EvictionPolicy::kWTinyLfu:
+      return "wtinylfu";
+    case maidsafe::EvictionPolicy::kArc:
+      return "arc";
+    default:
+      return "unknown";
+  }
+}
+
+maidsafe::EvictionPolicy ParseEvictionPolicy(const std::string& name) {
+  if (name == "lru")
+    return maidsafe::EvictionPolicy::kLru;
+  if (name == "wtinylfu")
+    return maidsafe::EvictionPolicy::kWTinyLfu;
+  if (name == "arc")
+    return maidsafe::EvictionPolicy::kArc;
+  LOG(kError) << "Unknown eviction policy \"" << name << "\".";
+  BOOST_THROW_EXCEPTION(maidsafe::MakeError(maidsafe::CommonErrors::invalid_parameter));
+}
+
+std::vector<std::string> ReadTrace(const std::string& path) {
+  std::ifstream file(path);
+  if (!file) {
+    LOG(kError) << "Failed to open trace file " << path;
+    BOOST_THROW_EXCEPTION(maidsafe::MakeError(maidsafe::CommonErrors::filesystem_io_error));
+  }
+  std::vector<std::string> trace;
+  std::string line;
+  while (std::getline(file, line)) {
+    std::istringstream tokens(line);
+    std::string key;
+    if (tokens >> key)
+      trace.push_back(key);
+  }
+  return trace;
+}
+
+std::vector<std::string> GenerateTrace(const SyntheticTrace& parameters) {
+  if (parameters.key_count == 0 || parameters.scan_interval == 0) {
+    LOG(kError) << "Synthetic trace needs non-zero key count and scan interval.";
+    BOOST_THROW_EXCEPTION(maidsafe::MakeError(maidsafe::CommonErrors::invalid_parameter));
+  }
+  std::mt19937_64 generator(parameters.seed);
+  std::vector<double> cdf(static_cast<size_t>(parameters.key_count));
+  double total(0);
+  for (size_t i(0); i != cdf.size(); ++i) {
+    total += 1.0 / std::pow(static_cast<double>(i + 1), parameters.zipf_exponent);
+    cdf[i] = total;
+  }
+  std::uniform_real_distribution<double> distribution(0.0, total);
+
+  std::vector<std::string> trace;
+  trace.reserve(static_cast<size_t>(parameters.request_count));
+  uint64_t scan_key(0);
+  while (trace.size() < parameters.request_count) {
+    if (trace.size() % parameters.scan_interval == 0 && !trace.empty()) {
+      for (uint64_t i(0); i != parameters.scan_length && trace.size() < parameters.request_count;
+           ++i) {
+        trace.push_back("scan_" + std::to_string(scan_key++));
+      }
+    }
+    auto rank(std::lower_bound(cdf.begin(), cdf.end(), distribution(generator)) - cdf.begin());
+    rank = std::min(rank, static_cast<decltype(rank)>(cdf.size() - 1));
+    trace.push_back("key_" + std::to_string(rank));
+  }
+  return trace;
+}
+
+ReplayResult Replay(const std::vector<std::string>& trace, size_t capacity,
+                    maidsafe::EvictionPolicy policy) {
+  maidsafe::PolicyCache<std::string, bool> cache(capacity, policy);
+  ReplayResult result;
+  for (const auto& key : trace) {
+    ++result.requests;
+    if (cache.Get(key).valid())
+      ++result.hits;
+    else
+      cache.Add(key, true);
+  }
+  return result;
+}
+
+}  // unnamed namespace
+
+int main(int argc, char* argv[]) {
+  maidsafe::log::Logging::Instance().Initialise(argc, argv);
+  SyntheticTrace synthetic;
+  uint64_t capacity(10000);
+  po::options_description options("Cache trace replay options");
+  options.add_options()("help,h", "Show help message.")(
+      "trace", po::value<std::string>(),
+      "File holding one request per line.  If not given, a synthetic trace is generated.")(
+      "capacity", po::value<uint64_t>(&capacity)->default_value(capacity),
+      "Maximum number of entries held by the cache.")(
+      "policies", po::value<std::vector<std::string>>()->multitoken(),
+      "Any of lru, wtinylfu and arc.  Defaults to all of them.")(
+      "requests", po::value<uint64_t>(&synthetic.request_count)
+                      ->default_value(synthetic.request_count),
+      "Synthetic trace: number of requests.")(
+      "keys", po::value<uint64_t>(&synthetic.key_count)->default_value(synthetic.key_count),
+      "Synthetic trace: number of distinct non-scan keys.")(
+      "zipf", po::value<double>(&synthetic.zipf_exponent)
+                  ->default_value(synthetic.zipf_exponent),
+      "Synthetic trace: Zipf exponent of key popularity.")(
+      "scan_length", po::value<uint64_t>(&synthetic.scan_length)
+                         ->default_value(synthetic.scan_length),
+      "Synthetic trace: number of one-off keys in each scan.")(
+      "scan_interval", po::value<uint64_t>(&synthetic.scan_interval)
+                           ->default_value(synthetic.scan_interval),
+      "Synthetic trace: number of requests between the starts of scans.")(
+      "seed", po::value<uint32_t>(&synthetic.seed)->default_value(synthetic.seed),
+      "Synthetic trace: random seed.");
+
+  try {
+    po::variables_map variables_map;
+    po::store(po::command_line_parser(argc, argv).options(options).allow_unregistered().run(),
+              variables_map);
+    po::notify(variables_map);
+    if (variables_map.count("help")) {
+      std::cout << options << '\n';
+      return 0;
+    }
+
+    std::vector<maidsafe::EvictionPolicy> policies;
+    if (variables_map.count("policies")) {
+      for (const auto& name : variables_map["policies"].as<std::vector<std::string>>())
+        policies.push_back(ParseEvictionPolicy(name));
+    } else {
+      policies = {maidsafe::EvictionPolicy::kLru, maidsafe::EvictionPolicy::kWTinyLfu,
+                  maidsafe::EvictionPolicy::kArc};
+    }
+
+    std::string source("synthetic");
+    std::vector<std::string> trace;
+    if (variables_map.count("trace")) {
+      source = variables_map["trace"].as<std::string>();
+      trace = ReadTrace(source);
+    } else {
+      trace = GenerateTrace(synthetic);
+    }
+
+    for (auto policy : policies) {
+      auto result(Replay(trace, static_cast<size_t>(capacity), policy));
+      std::cout << "{\"trace\":\"" << source << "\",\"policy\":\"" << ToString(policy)
+                << "\",\"capacity\":" << capacity << ",\"requests\":" << result.requests
+                << ",\"hits\":" << result.hits << ",\"hit_ratio\":"
+                << (result.requests ? static_cast<double>(result.hits) /
+                                          static_cast<double>(result.requests)
+                                    : 0.0)
+                << "}" << std::endl;
+    }
+  } catch (const std::exception& e) {
+    std::cerr << "Error: " << e.what() << '\n';
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,153 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "boost/filesystem/path.hpp"
+#include "boost/program_options.hpp"
+
+#include "maidsafe/common/error.h"
+#include "maidsafe/common/log.h"
+#include "maidsafe/common/test.h"
+
+#include "maidsafe/common/tools/data_buffer_benchmark.h"
+
+namespace fs = boost::filesystem;
+namespace po = boost::program_options;
+
+namespace {
+
+maidsafe::benchmark::ValueSizeDistribution ParseValueSizeDistribution(const std::string& name) {
+  if (name == "fixed")
+    return maidsafe::benchmark::ValueSizeDistribution::kFixed;
+  if (name == "uniform")
+    return maidsafe::benchmark::ValueSizeDistribution::kUniform;
+  if (name == "log_uniform")
+    return maidsafe::benchmark::ValueSizeDistribution::kLogUniform;
+  LOG(kError) << "Unknown value size distribution \"" << name << "\".";
+  BOOST_THROW_EXCEPTION(maidsafe::MakeError(maidsafe::CommonErrors::invalid_parameter));
+}
+
+maidsafe::DiskBackend ParseDiskBackend(const std::string& name) {
+  if (name == "file")
+    return maidsafe::DiskBackend::kFilePerValue;
+  if (name == "segment")
+    return maidsafe::DiskBackend::kSegmentFiles;
+  LOG(kError) << "Unknown disk backend \"" << name << "\".";
+  BOOST_THROW_EXCEPTION(maidsafe::MakeError(maidsafe::CommonErrors::invalid_parameter));
+}
+
+maidsafe::DiskCompression ParseDiskCompression(const std::string& name) {
+  if (name == "none")
+    return maidsafe::DiskCompression::kNone;
+  if (name == "gzip")
+    return maidsafe::DiskCompression::kGzip;
+  LOG(kError) << "Unknown disk compression \"" << name << "\".";
+  BOOST_THROW_EXCEPTION(maidsafe::MakeError(maidsafe::CommonErrors::invalid_parameter));
+}
+
+maidsafe::ReadPromotion ParseReadPromotion(const std::string& name) {
+  if (name == "none")
+    return maidsafe::ReadPromotion::kNone;
+  if (name == "lru")
+    return maidsafe::ReadPromotion::kLru;
+  if (name == "tinylfu")
+    return maidsafe::ReadPromotion::kTinyLfu;
+  LOG(kError) << "Unknown read promotion \"" << name << "\".";
+  BOOST_THROW_EXCEPTION(maidsafe::MakeError(maidsafe::CommonErrors::invalid_parameter));
+}
+
+}  // unnamed namespace
+
+int main(int argc, char* argv[]) {
+  maidsafe::log::Logging::Instance().Initialise(argc, argv);
+  maidsafe::benchmark::DataBufferWorkload workload;
+  po::options_description options("DataBuffer benchmark options");
+  options.add_options()("help,h", "Show help message.")(
+      "name", po::value<std::string>(&workload.name)->default_value(workload.name),
+      "Label copied into the output.")(
+      "operations", po::value<uint64_t>(&workload.operation_count)
+                        ->default_value(workload.operation_count),
+      "Number of timed operations, split across all threads.")(
+      "keys", po::value<uint64_t>(&workload.key_count)->default_value(workload.key_count),
+      "Number of distinct keys.")(
+      "threads", po::value<uint32_t>(&workload.thread_count)->default_value(workload.thread_count),
+      "Number of threads making calls.")(
+      "seed", po::value<uint32_t>(&workload.seed)->default_value(workload.seed),
+      "Seed for key choice, value sizes and the read/write mix.")(
+      "read_ratio", po::value<double>(&workload.read_fraction)
+                        ->default_value(workload.read_fraction),
+      "Fraction of operations which are reads, in [0, 1].")(
+      "zipf", po::value<double>(&workload.zipf_exponent)->default_value(workload.zipf_exponent),
+      "Zipf exponent of key popularity; 0 gives uniform popularity.")(
+      "value_size_distribution", po::value<std::string>()->default_value("log_uniform"),
+      "One of fixed, uniform or log_uniform.")(
+      "min_value_size", po::value<uint32_t>(&workload.min_value_size)
+                            ->default_value(workload.min_value_size),
+      "Smallest value size in bytes.")(
+      "max_value_size", po::value<uint32_t>(&workload.max_value_size)
+                            ->default_value(workload.max_value_size),
+      "Largest value size in bytes.")(
+      "memory_ratio", po::value<double>(&workload.memory_budget_ratio)
+                          ->default_value(workload.memory_budget_ratio),
+      "Memory budget as a fraction of the total size of all values.")(
+      "disk_ratio", po::value<double>(&workload.disk_budget_ratio)
+                        ->default_value(workload.disk_budget_ratio),
+      "Disk budget as a fraction of the total size of all values.")(
+      "disk_backend", po::value<std::string>()->default_value("file"),
+      "One of file or segment.")(
+      "compression", po::value<std::string>()->default_value("none"), "One of none or gzip.")(
+      "read_promotion", po::value<std::string>()->default_value("none"),
+      "One of none, lru or tinylfu.")(
+      "disk_writers", po::value<uint32_t>(&workload.disk_writer_count)
+                          ->default_value(workload.disk_writer_count),
+      "Number of threads copying values from memory to disk.")(
+      "disk_buffer", po::value<std::string>(),
+      "Folder in which to create the disk buffer.  Defaults to a new temporary folder.");
+
+  try {
+    po::variables_map variables_map;
+    po::store(po::command_line_parser(argc, argv).options(options).allow_unregistered().run(),
+              variables_map);
+    po::notify(variables_map);
+    if (variables_map.count("help")) {
+      std::cout << options << '\n';
+      return 0;
+    }
+    workload.value_size_distribution =
+        ParseValueSizeDistribution(variables_map["value_size_distribution"].as<std::string>());
+    workload.disk_backend = ParseDiskBackend(variables_map["disk_backend"].as<std::string>());
+    workload.disk_compression =
+        ParseDiskCompression(variables_map["compression"].as<std::string>());
+    workload.read_promotion = ParseReadPromotion(variables_map["read_promotion"].as<std::string>());
+
+    maidsafe::test::TestPath root;
+    if (variables_map.count("disk_buffer"))
+      root = std::make_shared<fs::path>(variables_map["disk_buffer"].as<std::string>());
+    else
+      root = maidsafe::test::CreateTestPath("MaidSafe_DataBufferBenchmark");
+    auto result(maidsafe::benchmark::DataBufferBenchmark::RunWorkload(workload, *root));
+    std::cout << maidsafe::benchmark::DataBufferBenchmark::ToJson(workload, result) << std::endl;
+  } catch (const std::exception& e) {
+    std::cerr << "Error: " << e.what() << '\n';
+    return 1;
+  }
+  return 0;
+}
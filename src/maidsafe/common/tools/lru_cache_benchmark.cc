@@ -0,0 +1,258 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+// Measures the multi-threaded throughput of a ConcurrentLruCache against an LruCache guarded by a
+// single mutex (as callers of LruCache have to do) for the same randomly-generated workload.  Each
+// thread's sequence of operations is generated before timing starts.  Results are printed as one
+// line of JSON per cache type.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <future>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "boost/program_options.hpp"
+
+#include "maidsafe/common/error.h"
+#include "maidsafe/common/log.h"
+#include "maidsafe/common/containers/concurrent_lru_cache.h"
+#include "maidsafe/common/containers/lru_cache.h"
+
+namespace po = boost::program_options;
+
+namespace {
+
+struct Workload {
+  Workload()
+      : operation_count(4000000),
+        key_count(100000),
+        capacity(10000),
+        thread_count(4),
+        shard_count(maidsafe::ConcurrentLruCache<uint64_t, uint64_t>::kDefaultShardCount),
+        seed(0),
+        read_fraction(0.9),
+        zipf_exponent(0.9) {}
+  uint64_t operation_count, key_count, capacity;
+  uint32_t thread_count, shard_count, seed;
+  double read_fraction, zipf_exponent;
+};
+
+struct Operation {
+  uint64_t key;
+  bool is_read;
+};
+
+struct Result {
+  Result() : seconds(0), hits(0), reads(0) {}
+  double seconds;
+  uint64_t hits, reads;
+};
+
+class MutexLruCache {
+ public:
+  explicit MutexLruCache(size_t capacity) : mutex_(), cache_(capacity) {}
+  bool Get(uint64_t key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return cache_.Get(key).valid();
+  }
+  void Add(uint64_t key, uint64_t value) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    cache_.Add(key, value);
+  }
+
+ private:
+  std::mutex mutex_;
+  maidsafe::LruCache<uint64_t, uint64_t> cache_;
+};
+
+class ShardedLruCache {
+ public:
+  ShardedLruCache(size_t capacity, uint32_t shard_count) : cache_(capacity, shard_count) {}
+  bool Get(uint64_t key) { return cache_.Get(key).valid(); }
+  void Add(uint64_t key, uint64_t value) { cache_.Add(key, value); }
+
+ private:
+  maidsafe::ConcurrentLruCache<uint64_t, uint64_t> cache_;
+};
+
+// Returns one sequence of operations per thread.  Key popularity follows a Zipf distribution, with
+// the most popular ranks scattered across the key space.
+std::vector<std::vector<Operation>> GenerateOperations(const Workload& workload) {
+  if (workload.thread_count == 0 || workload.key_count == 0 || workload.read_fraction < 0.0 ||
+      workload.read_fraction > 1.0) {
+    LOG(kError) << "Invalid workload.";
+    BOOST_THROW_EXCEPTION(maidsafe::MakeError(maidsafe::CommonErrors::invalid_parameter));
+  }
+  std::mt19937_64 generator(workload.seed);
+  std::vector<double> cdf(static_cast<size_t>(workload.key_count));
+  double total(0);
+  for (size_t i(0); i != cdf.size(); ++i) {
+    total += 1.0 / std::pow(static_cast<double>(i + 1), workload.zipf_exponent);
+    cdf[i] = total;
+  }
+  std::vector<uint64_t> key_for_rank(cdf.size());
+  for (size_t i(0); i != key_for_rank.size(); ++i)
+    key_for_rank[i] = i;
+  std::shuffle(key_for_rank.begin(), key_for_rank.end(), generator);
+
+  std::uniform_real_distribution<double> distribution(0.0, total);
+  std::bernoulli_distribution is_read(workload.read_fraction);
+  std::vector<std::vector<Operation>> operations(workload.thread_count);
+  for (uint32_t thread(0); thread != workload.thread_count; ++thread) {
+    uint64_t count(workload.operation_count / workload.thread_count +
+                   (thread < workload.operation_count % workload.thread_count ? 1 : 0));
+    operations[thread].reserve(static_cast<size_t>(count));
+    for (uint64_t i(0); i != count; ++i) {
+      auto rank(std::lower_bound(cdf.begin(), cdf.end(), distribution(generator)) - cdf.begin());
+      rank = std::min(rank, static_cast<decltype(rank)>(cdf.size() - 1));
+      operations[thread].push_back(
+          Operation{key_for_rank[static_cast<size_t>(rank)], is_read(generator)});
+    }
+  }
+  return operations;
+}
+
+// Reads which miss are followed by an Add of the missing key, as a read-through cache would do.
+template <typename Cache>
+Result Run(Cache& cache, const Workload& workload,
+           const std::vector<std::vector<Operation>>& operations) {
+  for (uint64_t key(0); key != std::min(workload.key_count, workload.capacity); ++key)
+    cache.Add(key, key);
+
+  std::atomic<uint64_t> hits(0), reads(0);
+  std::atomic<uint32_t> ready(0);
+  std::vector<std::future<void>> workers;
+  auto start(std::chrono::steady_clock::now());
+  for (size_t thread(0); thread != operations.size(); ++thread) {
+    workers.push_back(std::async(std::launch::async, [&, thread] {
+      // Start all threads together so that they contend for the whole run.
+      ++ready;
+      while (ready != workload.thread_count)
+        std::this_thread::yield();
+      uint64_t thread_hits(0), thread_reads(0);
+      for (const auto& operation : operations[thread]) {
+        if (operation.is_read) {
+          ++thread_reads;
+          if (cache.Get(operation.key))
+            ++thread_hits;
+          else
+            cache.Add(operation.key, operation.key);
+        } else {
+          cache.Add(operation.key, operation.key);
+        }
+      }
+      hits += thread_hits;
+      reads += thread_reads;
+    }));
+  }
+  for (auto& worker : workers)
+    worker.get();
+  Result result;
+  result.seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  result.hits = hits;
+  result.reads = reads;
+  return result;
+}
+
+std::string ToJson(const std::string& cache_type, const Workload& workload,
+                   const Result& result) {
+  std::ostringstream json;
+  json << "{\"cache\":\"" << cache_type << "\",\"workload\":{\"operations\":"
+       << workload.operation_count << ",\"keys\":" << workload.key_count
+       << ",\"capacity\":" << workload.capacity << ",\"threads\":" << workload.thread_count
+       << ",\"shards\":" << workload.shard_count << ",\"seed\":" << workload.seed
+       << ",\"read_fraction\":" << workload.read_fraction
+       << ",\"zipf_exponent\":" << workload.zipf_exponent << "},\"seconds\":" << result.seconds
+       << ",\"operations_per_second\":"
+       << (result.seconds > 0 ? static_cast<double>(workload.operation_count) / result.seconds
+                              : 0.0)
+       << ",\"hit_ratio\":"
+       << (result.reads ? static_cast<double>(result.hits) / static_cast<double>(result.reads)
+                        : 0.0)
+       << "}";
+  return json.str();
+}
+
+}  // unnamed namespace
+
+int main(int argc, char* argv[]) {
+  maidsafe::log::Logging::Instance().Initialise(argc, argv);
+  Workload workload;
+  po::options_description options("LruCache benchmark options");
+  options.add_options()("help,h", "Show help message.")(
+      "operations", po::value<uint64_t>(&workload.operation_count)
+                        ->default_value(workload.operation_count),
+      "Number of timed operations, split across all threads.")(
+      "keys", po::value<uint64_t>(&workload.key_count)->default_value(workload.key_count),
+      "Number of distinct keys.")(
+      "capacity", po::value<uint64_t>(&workload.capacity)->default_value(workload.capacity),
+      "Maximum number of entries held by each cache.")(
+      "threads", po::value<uint32_t>(&workload.thread_count)->default_value(workload.thread_count),
+      "Number of threads making calls.")(
+      "shards", po::value<uint32_t>(&workload.shard_count)->default_value(workload.shard_count),
+      "Number of shards in the ConcurrentLruCache.")(
+      "seed", po::value<uint32_t>(&workload.seed)->default_value(workload.seed),
+      "Seed for key choice and the read/write mix.")(
+      "read_ratio", po::value<double>(&workload.read_fraction)
+                        ->default_value(workload.read_fraction),
+      "Fraction of operations which are reads, in [0, 1].")(
+      "zipf", po::value<double>(&workload.zipf_exponent)->default_value(workload.zipf_exponent),
+      "Zipf exponent of key popularity; 0 gives uniform popularity.")(
+      "cache", po::value<std::string>()->default_value("both"),
+      "One of mutex, concurrent or both.");
+
+  try {
+    po::variables_map variables_map;
+    po::store(po::command_line_parser(argc, argv).options(options).allow_unregistered().run(),
+              variables_map);
+    po::notify(variables_map);
+    if (variables_map.count("help")) {
+      std::cout << options << '\n';
+      return 0;
+    }
+    std::string cache_type(variables_map["cache"].as<std::string>());
+    if (cache_type != "mutex" && cache_type != "concurrent" && cache_type != "both") {
+      LOG(kError) << "Unknown cache type \"" << cache_type << "\".";
+      BOOST_THROW_EXCEPTION(maidsafe::MakeError(maidsafe::CommonErrors::invalid_parameter));
+    }
+
+    auto operations(GenerateOperations(workload));
+    if (cache_type != "concurrent") {
+      MutexLruCache cache(static_cast<size_t>(workload.capacity));
+      std::cout << ToJson("mutex", workload, Run(cache, workload, operations)) << std::endl;
+    }
+    if (cache_type != "mutex") {
+      ShardedLruCache cache(static_cast<size_t>(workload.capacity), workload.shard_count);
+      std::cout << ToJson("concurrent", workload, Run(cache, workload, operations)) << std::endl;
+    }
+  } catch (const std::exception& e) {
+    std::cerr << "Error: " << e.what() << '\n';
+    return 1;
+  }
+  return 0;
+}
@@ -27,6 +27,7 @@
 
 #include "boost/interprocess/ipc/message_queue.hpp"
 
+#include "maidsafe/common/closest_nodes.h"
 #include "maidsafe/common/utils.h"
 #include "maidsafe/common/log.h"
 #include "maidsafe/common/on_scope_exit.h"
@@ -294,29 +295,14 @@ std::vector<ViewableNode> GetCloseNodes(int state_id, const std::string& hex_enc
 
   if (itr == std::end(snapshot_itr->second)) {
     // Data / account request
-    for (const auto& node : snapshot_itr->second) {
-      bool needs_sorted(false);
-      if (children.size() < 4) {
-        children.emplace_back(node.id.ToStringEncoded(NodeId::EncodingType::kHex),
-                              (target_id ^ node.id).ToStringEncoded(NodeId::EncodingType::kHex),
-                              ChildType::kNotConnected);
-        if (children.size() == 4)
-          needs_sorted = true;
-      } else if (NodeId::CloserToTarget(node.id, NodeId(children[3].id, NodeId::EncodingType::kHex),
-                                        target_id)) {
-        children[3] =
-            ViewableNode(node.id.ToStringEncoded(NodeId::EncodingType::kHex),
-                         (target_id ^ node.id).ToStringEncoded(NodeId::EncodingType::kHex),
-                         ChildType::kNotConnected);
-        needs_sorted = true;
-      }
-      if (needs_sorted) {
-        std::sort(std::begin(children), std::end(children),
-                  [&target_id](const ViewableNode& lhs, const ViewableNode& rhs) {
-          return NodeId::CloserToTarget(NodeId(lhs.id, NodeId::EncodingType::kHex),
-                                        NodeId(rhs.id, NodeId::EncodingType::kHex), target_id);
-        });
-      }
+    std::vector<NodeId> ids;
+    ids.reserve(snapshot_itr->second.size());
+    for (const auto& node : snapshot_itr->second)
+      ids.push_back(node.id);
+    for (const auto& id : ClosestNodes(ids, target_id, 4)) {
+      children.emplace_back(id.ToStringEncoded(NodeId::EncodingType::kHex),
+                            (target_id ^ id).ToStringEncoded(NodeId::EncodingType::kHex),
+                            ChildType::kNotConnected);
     }
   } else {
     // Node request
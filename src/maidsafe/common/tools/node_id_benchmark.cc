@@ -0,0 +1,249 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+// Measures NodeId's XOR-distance operations (CloserToTarget, CommonLeadingBits and operator^=)
+// against byte-at-a-time reference implementations working on raw ID strings, as NodeId used to.
+// The reference CommonLeadingBits uses a 256x256 lookup table of common bits per pair of bytes.
+// Both are run over the same randomly-generated IDs and their results are checked for agreement.
+// Results are printed as one line of JSON per operation.
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "boost/program_options.hpp"
+
+#include "maidsafe/common/error.h"
+#include "maidsafe/common/log.h"
+#include "maidsafe/common/node_id.h"
+
+namespace po = boost::program_options;
+
+namespace {
+
+typedef std::array<std::array<int, 256>, 256> CommonBitsTable;
+
+struct Options {
+  Options() : id_count(1024), iterations(1000), seed(0) {}
+  uint32_t id_count, iterations, seed;
+};
+
+struct Timing {
+  Timing() : calls(0), byte_wise_seconds(0), word_wise_seconds(0) {}
+  uint64_t calls;
+  double byte_wise_seconds, word_wise_seconds;
+};
+
+CommonBitsTable MakeCommonBitsTable() {
+  CommonBitsTable table;
+  for (int lhs(0); lhs != 256; ++lhs) {
+    for (int rhs(0); rhs != 256; ++rhs) {
+      int common(0);
+      for (int mask(0x80); mask != 0 && (lhs & mask) == (rhs & mask); mask >>= 1)
+        ++common;
+      table[lhs][rhs] = common;
+    }
+  }
+  return table;
+}
+
+bool ByteWiseCloserToTarget(const std::string& id1, const std::string& id2,
+                            const std::string& target_id) {
+  for (size_t i = 0; i < maidsafe::NodeId::kSize; ++i) {
+    unsigned char result1 = id1[i] ^ target_id[i];
+    unsigned char result2 = id2[i] ^ target_id[i];
+    if (result1 != result2)
+      return result1 < result2;
+  }
+  return false;
+}
+
+int ByteWiseCommonLeadingBits(const CommonBitsTable& table, const std::string& lhs,
+                              const std::string& rhs) {
+  auto mismatch(std::mismatch(std::begin(lhs), std::end(lhs), std::begin(rhs)));
+  if (mismatch.first == std::end(lhs))
+    return 8 * maidsafe::NodeId::kSize;
+  int common_bits{table[static_cast<unsigned char>(*mismatch.first)]
+                       [static_cast<unsigned char>(*mismatch.second)]};
+  return static_cast<int>(8 * std::distance(std::begin(lhs), mismatch.first)) + common_bits;
+}
+
+void ByteWiseXor(std::string& lhs, const std::string& rhs) {
+  for (size_t i(0); i != maidsafe::NodeId::kSize; ++i)
+    lhs[i] ^= rhs[i];
+}
+
+double SecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void CheckAgreement(uint64_t byte_wise_result, uint64_t word_wise_result,
+                    const std::string& operation) {
+  if (byte_wise_result != word_wise_result) {
+    LOG(kError) << "Byte-wise and word-wise " << operation << " disagree.";
+    BOOST_THROW_EXCEPTION(maidsafe::MakeError(maidsafe::CommonErrors::unknown));
+  }
+}
+
+// Each call uses a pair of IDs which share a random-length prefix, so that CommonLeadingBits and
+// CloserToTarget don't always stop at the first byte.
+std::vector<std::string> GenerateRawIds(const Options& options) {
+  if (options.id_count < 3) {
+    LOG(kError) << "Need at least 3 IDs.";
+    BOOST_THROW_EXCEPTION(maidsafe::MakeError(maidsafe::CommonErrors::invalid_parameter));
+  }
+  std::mt19937_64 generator(options.seed);
+  std::uniform_int_distribution<int> byte(0, 255);
+  std::uniform_int_distribution<size_t> prefix_length(0, maidsafe::NodeId::kSize);
+  std::string base(maidsafe::NodeId::kSize, 0);
+  for (auto& elem : base)
+    elem = static_cast<char>(byte(generator));
+  std::vector<std::string> raw_ids;
+  for (uint32_t i(0); i != options.id_count; ++i) {
+    std::string raw_id(base);
+    for (size_t j(prefix_length(generator)); j < raw_id.size(); ++j)
+      raw_id[j] = static_cast<char>(byte(generator));
+    raw_ids.push_back(raw_id);
+  }
+  return raw_ids;
+}
+
+Timing TimeCloserToTarget(const Options& options, const std::vector<std::string>& raw_ids,
+                          const std::vector<maidsafe::NodeId>& ids) {
+  Timing timing;
+  uint64_t byte_wise_count(0), word_wise_count(0);
+  const size_t size(ids.size());
+  auto start(std::chrono::steady_clock::now());
+  for (uint32_t iteration(0); iteration != options.iterations; ++iteration) {
+    for (size_t i(0); i != size; ++i) {
+      byte_wise_count += ByteWiseCloserToTarget(raw_ids[i], raw_ids[(i + 1) % size],
+                                                raw_ids[(i + 2) % size]) ? 1 : 0;
+    }
+  }
+  timing.byte_wise_seconds = SecondsSince(start);
+  start = std::chrono::steady_clock::now();
+  for (uint32_t iteration(0); iteration != options.iterations; ++iteration) {
+    for (size_t i(0); i != size; ++i) {
+      word_wise_count += maidsafe::NodeId::CloserToTarget(ids[i], ids[(i + 1) % size],
+                                                          ids[(i + 2) % size]) ? 1 : 0;
+    }
+  }
+  timing.word_wise_seconds = SecondsSince(start);
+  timing.calls = static_cast<uint64_t>(options.iterations) * size;
+  CheckAgreement(byte_wise_count, word_wise_count, "CloserToTarget");
+  return timing;
+}
+
+Timing TimeCommonLeadingBits(const Options& options, const std::vector<std::string>& raw_ids,
+                             const std::vector<maidsafe::NodeId>& ids) {
+  static const CommonBitsTable kTable(MakeCommonBitsTable());
+  Timing timing;
+  uint64_t byte_wise_total(0), word_wise_total(0);
+  const size_t size(ids.size());
+  auto start(std::chrono::steady_clock::now());
+  for (uint32_t iteration(0); iteration != options.iterations; ++iteration) {
+    for (size_t i(0); i != size; ++i) {
+      byte_wise_total += static_cast<uint64_t>(
+          ByteWiseCommonLeadingBits(kTable, raw_ids[i], raw_ids[(i + 1) % size]));
+    }
+  }
+  timing.byte_wise_seconds = SecondsSince(start);
+  start = std::chrono::steady_clock::now();
+  for (uint32_t iteration(0); iteration != options.iterations; ++iteration) {
+    for (size_t i(0); i != size; ++i)
+      word_wise_total += static_cast<uint64_t>(ids[i].CommonLeadingBits(ids[(i + 1) % size]));
+  }
+  timing.word_wise_seconds = SecondsSince(start);
+  timing.calls = static_cast<uint64_t>(options.iterations) * size;
+  CheckAgreement(byte_wise_total, word_wise_total, "CommonLeadingBits");
+  return timing;
+}
+
+Timing TimeXor(const Options& options, const std::vector<std::string>& raw_ids,
+               const std::vector<maidsafe::NodeId>& ids) {
+  Timing timing;
+  std::string byte_wise_result(raw_ids.front());
+  maidsafe::NodeId word_wise_result(ids.front());
+  auto start(std::chrono::steady_clock::now());
+  for (uint32_t iteration(0); iteration != options.iterations; ++iteration) {
+    for (const auto& raw_id : raw_ids)
+      ByteWiseXor(byte_wise_result, raw_id);
+  }
+  timing.byte_wise_seconds = SecondsSince(start);
+  start = std::chrono::steady_clock::now();
+  for (uint32_t iteration(0); iteration != options.iterations; ++iteration) {
+    for (const auto& id : ids)
+      word_wise_result ^= id;
+  }
+  timing.word_wise_seconds = SecondsSince(start);
+  timing.calls = static_cast<uint64_t>(options.iterations) * ids.size();
+  CheckAgreement(byte_wise_result == word_wise_result.string() ? 1 : 0, 1, "operator^=");
+  return timing;
+}
+
+void PrintJson(const std::string& operation, const Timing& timing) {
+  double calls(static_cast<double>(timing.calls));
+  std::cout << "{\"operation\":\"" << operation << "\",\"calls\":" << timing.calls
+            << ",\"byte_wise_ns_per_call\":" << timing.byte_wise_seconds * 1e9 / calls
+            << ",\"word_wise_ns_per_call\":" << timing.word_wise_seconds * 1e9 / calls
+            << ",\"speedup\":"
+            << (timing.word_wise_seconds > 0 ? timing.byte_wise_seconds / timing.word_wise_seconds
+                                             : 0.0)
+            << "}" << std::endl;
+}
+
+}  // unnamed namespace
+
+int main(int argc, char* argv[]) {
+  maidsafe::log::Logging::Instance().Initialise(argc, argv);
+  Options options;
+  po::options_description description("NodeId benchmark options");
+  description.add_options()("help,h", "Show help message.")(
+      "ids", po::value<uint32_t>(&options.id_count)->default_value(options.id_count),
+      "Number of distinct IDs.")(
+      "iterations", po::value<uint32_t>(&options.iterations)->default_value(options.iterations),
+      "Number of passes over the IDs for each operation.")(
+      "seed", po::value<uint32_t>(&options.seed)->default_value(options.seed),
+      "Seed for generating the IDs.");
+
+  try {
+    po::variables_map variables_map;
+    po::store(po::command_line_parser(argc, argv).options(description).allow_unregistered().run(),
+              variables_map);
+    po::notify(variables_map);
+    if (variables_map.count("help")) {
+      std::cout << description << '\n';
+      return 0;
+    }
+
+    auto raw_ids(GenerateRawIds(options));
+    std::vector<maidsafe::NodeId> ids(raw_ids.begin(), raw_ids.end());
+    PrintJson("closer_to_target", TimeCloserToTarget(options, raw_ids, ids));
+    PrintJson("common_leading_bits", TimeCommonLeadingBits(options, raw_ids, ids));
+    PrintJson("xor", TimeXor(options, raw_ids, ids));
+  } catch (const std::exception& e) {
+    std::cerr << "Error: " << e.what() << '\n';
+    return 1;
+  }
+  return 0;
+}
@@ -26,6 +26,7 @@
 #include "maidsafe/common/menu_item.h"
 #include "maidsafe/common/utils.h"
 
+#include "maidsafe/common/tools/data_buffer_benchmark.h"
 #include "maidsafe/common/tools/sqlite3_wrapper_benchmark.h"
 
 int main(int argc, char* argv[]) {
@@ -54,9 +55,10 @@ int main(int argc, char* argv[]) {
     maidsafe::benchmark::Sqlite3WrapperBenchmark sqlite_wrapper_benchmark_test;
     sqlite_wrapper_benchmark_test.Run();
   });
-  qa_dev_bench_item->AddChildItem("Benchmark 2", [] {
-    TLOG(kGreen) << "Running benchmark 2.\n";
-    std::this_thread::sleep_for(std::chrono::seconds(2));
+  qa_dev_bench_item->AddChildItem("data_buffer benchmark", [] {
+    TLOG(kGreen) << "Running data_buffer benchmark test\n";
+    maidsafe::benchmark::DataBufferBenchmark data_buffer_benchmark_test;
+    data_buffer_benchmark_test.Run();
   });
 
   // Builders
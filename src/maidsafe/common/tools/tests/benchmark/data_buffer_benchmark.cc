@@ -0,0 +1,408 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/common/tools/data_buffer_benchmark.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <future>
+#include <random>
+#include <sstream>
+
+#include "boost/filesystem/operations.hpp"
+
+#include "maidsafe/common/error.h"
+#include "maidsafe/common/test.h"
+#include "maidsafe/common/utils.h"
+
+namespace maidsafe {
+
+namespace benchmark {
+
+namespace {
+
+const size_t kValueSize(64);
+
+double MeanMicroseconds(std::chrono::steady_clock::duration elapsed, size_t count) {
+  return static_cast<double>(
+             std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()) /
+         (1000.0 * static_cast<double>(count));
+}
+
+// Samples ranks in [0, n) with probability proportional to 1 / (rank + 1)^exponent.
+class ZipfDistribution {
+ public:
+  ZipfDistribution(uint64_t n, double exponent) : cdf_(static_cast<size_t>(n)) {
+    double total(0);
+    for (size_t i(0); i != cdf_.size(); ++i) {
+      total += 1.0 / std::pow(static_cast<double>(i + 1), exponent);
+      cdf_[i] = total;
+    }
+    for (auto& probability : cdf_)
+      probability /= total;
+  }
+
+  template <typename Generator>
+  size_t operator()(Generator& generator) const {
+    double sample(std::uniform_real_distribution<double>(0.0, 1.0)(generator));
+    auto itr(std::lower_bound(cdf_.begin(), cdf_.end(), sample));
+    return std::min(static_cast<size_t>(itr - cdf_.begin()), cdf_.size() - 1);
+  }
+
+ private:
+  std::vector<double> cdf_;
+};
+
+template <typename Generator>
+uint32_t ValueSize(const DataBufferWorkload& workload, Generator& generator) {
+  switch (workload.value_size_distribution) {
+    case ValueSizeDistribution::kUniform:
+      return std::uniform_int_distribution<uint32_t>(workload.min_value_size,
+                                                     workload.max_value_size)(generator);
+    case ValueSizeDistribution::kLogUniform: {
+      std::uniform_real_distribution<double> distribution(
+          std::log(static_cast<double>(workload.min_value_size)),
+          std::log(static_cast<double>(workload.max_value_size)));
+      auto size(static_cast<uint32_t>(std::exp(distribution(generator)) + 0.5));
+      return std::max(workload.min_value_size, std::min(workload.max_value_size, size));
+    }
+    default:
+      return workload.max_value_size;
+  }
+}
+
+void CheckWorkload(const DataBufferWorkload& workload) {
+  if (workload.key_count == 0 || workload.thread_count == 0 || workload.disk_writer_count == 0 ||
+      workload.min_value_size == 0 ||
+      workload.min_value_size > workload.max_value_size || workload.read_fraction < 0.0 ||
+      workload.read_fraction > 1.0 || workload.zipf_exponent < 0.0 ||
+      workload.memory_budget_ratio < 0.0 ||
+      workload.memory_budget_ratio > workload.disk_budget_ratio) {
+    LOG(kError) << "Invalid workload \"" << workload.name << "\".";
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::invalid_parameter));
+  }
+}
+
+LatencyHistogram::Snapshot Difference(const LatencyHistogram::Snapshot& after,
+                                      const LatencyHistogram::Snapshot& before) {
+  LatencyHistogram::Snapshot difference(after);
+  for (size_t i(0); i != difference.buckets.size(); ++i)
+    difference.buckets[i] -= before.buckets[i];
+  difference.count -= before.count;
+  difference.total_microseconds -= before.total_microseconds;
+  return difference;
+}
+
+// The tier sizes are taken from 'after', while the counters are the increase since 'before'.
+DataBufferStatistics Difference(const DataBufferStatistics& after,
+                                const DataBufferStatistics& before) {
+  DataBufferStatistics difference(after);
+  difference.hits.memory_hits -= before.hits.memory_hits;
+  difference.hits.disk_hits -= before.hits.disk_hits;
+  difference.hits.misses -= before.hits.misses;
+  difference.hits.promotions -= before.hits.promotions;
+  difference.hits.rejected_promotions -= before.hits.rejected_promotions;
+  difference.pops -= before.pops;
+  difference.memory_wait_time -= before.memory_wait_time;
+  difference.disk_wait_time -= before.disk_wait_time;
+  difference.disk_write_latency = Difference(after.disk_write_latency, before.disk_write_latency);
+  difference.disk_read_latency = Difference(after.disk_read_latency, before.disk_read_latency);
+  return difference;
+}
+
+std::string JsonString(const std::string& input) {
+  std::string output("\"");
+  for (char c : input) {
+    if (c == '"' || c == '\\')
+      output += '\\';
+    output += c;
+  }
+  return output + '"';
+}
+
+std::string LatencyJson(const LatencyHistogram::Snapshot& latency) {
+  std::ostringstream json;
+  json << "{\"count\":" << latency.count << ",\"mean_us\":" << latency.MeanMicroseconds()
+       << ",\"p50_us\":" << latency.Percentile(50) << ",\"p90_us\":" << latency.Percentile(90)
+       << ",\"p99_us\":" << latency.Percentile(99) << ",\"p999_us\":" << latency.Percentile(99.9)
+       << "}";
+  return json.str();
+}
+
+std::string ToString(ValueSizeDistribution distribution) {
+  switch (distribution) {
+    case ValueSizeDistribution::kUniform:
+      return "uniform";
+    case ValueSizeDistribution::kLogUniform:
+      return "log_uniform";
+    default:
+      return "fixed";
+  }
+}
+
+std::string ToString(DiskBackend disk_backend) {
+  return disk_backend == DiskBackend::kSegmentFiles ? "segment_files" : "file_per_value";
+}
+
+std::string ToString(DiskCompression disk_compression) {
+  return disk_compression == DiskCompression::kGzip ? "gzip" : "none";
+}
+
+std::string ToString(ReadPromotion read_promotion) {
+  switch (read_promotion) {
+    case ReadPromotion::kLru:
+      return "lru";
+    case ReadPromotion::kTinyLfu:
+      return "tiny_lfu";
+    default:
+      return "none";
+  }
+}
+
+}  // unnamed namespace
+
+DataBufferWorkload::DataBufferWorkload()
+    : name("default"),
+      operation_count(100000),
+      key_count(10000),
+      thread_count(4),
+      seed(0),
+      read_fraction(0.9),
+      zipf_exponent(0.99),
+      value_size_distribution(ValueSizeDistribution::kLogUniform),
+      min_value_size(64),
+      max_value_size(64 * 1024),
+      memory_budget_ratio(0.1),
+      disk_budget_ratio(0.5),
+      disk_backend(DiskBackend::kFilePerValue),
+      disk_compression(DiskCompression::kNone),
+      read_promotion(ReadPromotion::kNone),
+      disk_writer_count(1) {}
+
+DataBufferWorkloadResult::DataBufferWorkloadResult()
+    : elapsed_seconds(0),
+      reads(0),
+      writes(0),
+      read_misses(0),
+      total_value_bytes(0),
+      read_latency(),
+      write_latency(),
+      statistics() {}
+
+DataBufferBenchmark::DataBufferBenchmark() : data_buffer_path(), keys(), values() {}
+
+void DataBufferBenchmark::Run() {
+  maidsafe::test::TestPath test_path(maidsafe::test::CreateTestPath("MaidSafe_TestUtils"));
+  data_buffer_path = boost::filesystem::path(*test_path / "data_buffer_benchmark");
+  for (size_t element_count : {1000, 10000, 100000})
+    ElementCountScaling(element_count);
+
+  DataBufferWorkload workload;
+  TLOG(kGreen) << "\nRunning default mixed workload\n"
+               << ToJson(workload, RunWorkload(workload, *test_path)) << '\n';
+}
+
+DataBufferWorkloadResult DataBufferBenchmark::RunWorkload(const DataBufferWorkload& workload,
+                                                          const boost::filesystem::path& root) {
+  CheckWorkload(workload);
+  std::mt19937_64 generator(workload.seed);
+
+  // Each key gets a value of its own size, cut from one shared block of random data.
+  std::string random_data(RandomString(workload.max_value_size + 4096));
+  std::vector<std::string> keys;
+  std::vector<DataBuffer<std::string>::SharedValue> values;
+  keys.reserve(static_cast<size_t>(workload.key_count));
+  values.reserve(static_cast<size_t>(workload.key_count));
+  DataBufferWorkloadResult result;
+  uint32_t largest_value(0);
+  for (uint64_t i(0); i != workload.key_count; ++i) {
+    uint32_t size(ValueSize(workload, generator));
+    size_t offset(std::uniform_int_distribution<size_t>(0, 4096)(generator));
+    keys.push_back("key_" + std::to_string(i));
+    values.push_back(
+        std::make_shared<const NonEmptyString>(random_data.substr(offset, size)));
+    result.total_value_bytes += size;
+    largest_value = std::max(largest_value, size);
+  }
+  auto memory_budget(static_cast<uint64_t>(static_cast<double>(result.total_value_bytes) *
+                                           workload.memory_budget_ratio));
+  auto disk_budget(static_cast<uint64_t>(static_cast<double>(result.total_value_bytes) *
+                                         workload.disk_budget_ratio));
+  if (disk_budget < largest_value) {
+    LOG(kError) << "Disk budget of " << disk_budget << " bytes can't hold a value of "
+                << largest_value << " bytes.";
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::invalid_parameter));
+  }
+
+  // The most popular ranks are spread across the keys rather than being the first ones stored.
+  std::vector<size_t> key_for_rank(keys.size());
+  for (size_t i(0); i != key_for_rank.size(); ++i)
+    key_for_rank[i] = i;
+  std::shuffle(key_for_rank.begin(), key_for_rank.end(), generator);
+  ZipfDistribution zipf(workload.key_count, workload.zipf_exponent);
+
+  DataBuffer<std::string> data_buffer(
+      MemoryUsage(memory_budget), DiskUsage(disk_budget),
+      [](const std::string&, const NonEmptyString&) {},
+      root / boost::filesystem::unique_path("data_buffer_%%%%-%%%%-%%%%"), true,
+      workload.disk_backend, DiskRecovery::kNone, workload.disk_compression,
+      workload.disk_writer_count);
+  data_buffer.SetReadPromotion(workload.read_promotion);
+  for (size_t i(0); i != keys.size(); ++i)
+    data_buffer.Store(keys[i], values[i]);
+  auto statistics_before(data_buffer.GetStatistics());
+
+  LatencyHistogram read_latency, write_latency;
+  std::atomic<uint64_t> reads(0), writes(0), read_misses(0);
+  std::vector<std::future<void>> workers;
+  auto start(std::chrono::steady_clock::now());
+  for (uint32_t thread(0); thread != workload.thread_count; ++thread) {
+    uint64_t operation_count(workload.operation_count / workload.thread_count +
+                             (thread < workload.operation_count % workload.thread_count ? 1 : 0));
+    workers.push_back(std::async(std::launch::async, [&, thread, operation_count] {
+      std::mt19937_64 thread_generator(workload.seed + thread + 1);
+      std::uniform_real_distribution<double> operation(0.0, 1.0);
+      for (uint64_t i(0); i != operation_count; ++i) {
+        size_t index(key_for_rank[zipf(thread_generator)]);
+        auto operation_start(std::chrono::steady_clock::now());
+        if (operation(thread_generator) < workload.read_fraction) {
+          try {
+            data_buffer.GetShared(keys[index]);
+          } catch (const std::exception&) {
+            ++read_misses;
+          }
+          read_latency.Record(std::chrono::steady_clock::now() - operation_start);
+          ++reads;
+        } else {
+          data_buffer.Store(keys[index], values[index]);
+          write_latency.Record(std::chrono::steady_clock::now() - operation_start);
+          ++writes;
+        }
+      }
+    }));
+  }
+  for (auto& worker : workers)
+    worker.get();
+  result.elapsed_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                                         start).count();
+
+  result.reads = reads;
+  result.writes = writes;
+  result.read_misses = read_misses;
+  result.read_latency = read_latency.GetSnapshot();
+  result.write_latency = write_latency.GetSnapshot();
+  result.statistics = Difference(data_buffer.GetStatistics(), statistics_before);
+  return result;
+}
+
+std::string DataBufferBenchmark::ToJson(const DataBufferWorkload& workload,
+                                        const DataBufferWorkloadResult& result) {
+  const DataBufferStatistics& statistics(result.statistics);
+  std::ostringstream json;
+  json << "{\"name\":" << JsonString(workload.name)
+       << ",\"workload\":{\"operations\":" << workload.operation_count
+       << ",\"keys\":" << workload.key_count << ",\"threads\":" << workload.thread_count
+       << ",\"seed\":" << workload.seed << ",\"read_fraction\":" << workload.read_fraction
+       << ",\"zipf_exponent\":" << workload.zipf_exponent
+       << ",\"value_size_distribution\":" << JsonString(ToString(workload.value_size_distribution))
+       << ",\"min_value_size\":" << workload.min_value_size
+       << ",\"max_value_size\":" << workload.max_value_size
+       << ",\"memory_budget_ratio\":" << workload.memory_budget_ratio
+       << ",\"disk_budget_ratio\":" << workload.disk_budget_ratio
+       << ",\"disk_backend\":" << JsonString(ToString(workload.disk_backend))
+       << ",\"disk_compression\":" << JsonString(ToString(workload.disk_compression))
+       << ",\"read_promotion\":" << JsonString(ToString(workload.read_promotion))
+       << ",\"disk_writers\":" << workload.disk_writer_count << "}"
+       << ",\"total_value_bytes\":" << result.total_value_bytes
+       << ",\"elapsed_seconds\":" << result.elapsed_seconds << ",\"operations_per_second\":"
+       << (result.elapsed_seconds > 0
+               ? static_cast<double>(result.reads + result.writes) / result.elapsed_seconds
+               : 0.0)
+       << ",\"reads\":" << result.reads << ",\"read_misses\":" << result.read_misses
+       << ",\"writes\":" << result.writes
+       << ",\"read_latency\":" << LatencyJson(result.read_latency)
+       << ",\"write_latency\":" << LatencyJson(result.write_latency)
+       << ",\"data_buffer\":{\"memory_hits\":" << statistics.hits.memory_hits
+       << ",\"disk_hits\":" << statistics.hits.disk_hits
+       << ",\"misses\":" << statistics.hits.misses
+       << ",\"promotions\":" << statistics.hits.promotions
+       << ",\"rejected_promotions\":" << statistics.hits.rejected_promotions
+       << ",\"pops\":" << statistics.pops << ",\"memory_bytes\":" << statistics.memory_bytes
+       << ",\"disk_bytes\":" << statistics.disk_bytes
+       << ",\"memory_wait_us\":" << statistics.memory_wait_time.count()
+       << ",\"disk_wait_us\":" << statistics.disk_wait_time.count()
+       << ",\"disk_write_latency\":" << LatencyJson(statistics.disk_write_latency)
+       << ",\"disk_read_latency\":" << LatencyJson(statistics.disk_read_latency) << "}}";
+  return json.str();
+}
+
+void DataBufferBenchmark::ElementCountScaling(size_t element_count) {
+  TLOG(kGreen) << "\nStoring, getting and deleting " << element_count << " values of "
+               << kValueSize << " bytes held in memory\n";
+  keys.clear();
+  values.clear();
+  for (size_t i(0); i < element_count; ++i) {
+    keys.push_back(RandomString(64));
+    values.emplace_back(RandomString(kValueSize));
+  }
+  std::vector<size_t> get_order(element_count);
+  for (size_t i(0); i < element_count; ++i)
+    get_order[i] = i;
+  std::shuffle(get_order.begin(), get_order.end(), std::mt19937(RandomUint32()));
+
+  DataBuffer<std::string> data_buffer(MemoryUsage(element_count * kValueSize),
+                                      DiskUsage(2 * element_count * kValueSize), nullptr,
+                                      data_buffer_path / std::to_string(element_count), true);
+
+  auto start(std::chrono::steady_clock::now());
+  for (size_t i(0); i < element_count; ++i)
+    data_buffer.Store(keys[i], values[i]);
+  auto store_time(std::chrono::steady_clock::now() - start);
+
+  start = std::chrono::steady_clock::now();
+  for (size_t i : get_order) {
+    if (data_buffer.Get(keys[i]) != values[i])
+      TLOG(kRed) << "Wrong value retrieved for " << HexSubstr(keys[i]) << '\n';
+  }
+  auto get_time(std::chrono::steady_clock::now() - start);
+
+  start = std::chrono::steady_clock::now();
+  for (size_t i : get_order) {
+    if (*data_buffer.GetShared(keys[i]) != values[i])
+      TLOG(kRed) << "Wrong value retrieved for " << HexSubstr(keys[i]) << '\n';
+  }
+  auto get_shared_time(std::chrono::steady_clock::now() - start);
+
+  start = std::chrono::steady_clock::now();
+  for (size_t i : get_order)
+    data_buffer.Delete(keys[i]);
+  auto delete_time(std::chrono::steady_clock::now() - start);
+
+  TLOG(kGreen) << "mean Store latency: " << MeanMicroseconds(store_time, element_count)
+               << " us, mean Get latency: " << MeanMicroseconds(get_time, element_count)
+               << " us, mean GetShared latency: "
+               << MeanMicroseconds(get_shared_time, element_count)
+               << " us, mean Delete latency: " << MeanMicroseconds(delete_time, element_count)
+               << " us\n";
+}
+
+}  // namespace benchmark
+
+}  // namespace maidsafe
@@ -0,0 +1,198 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+// Measures XorTrie's queries against the same queries run over a flat vector of IDs (ClosestNodes
+// for the k closest, and a linear scan for the number within a given number of common leading
+// bits).  Both are run for the same randomly-generated targets and their results are checked for
+// agreement.  The time taken to add and then delete all the entries is also measured.  Results are
+// printed as one line of JSON per operation.
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "boost/program_options.hpp"
+
+#include "maidsafe/common/closest_nodes.h"
+#include "maidsafe/common/error.h"
+#include "maidsafe/common/log.h"
+#include "maidsafe/common/node_id.h"
+#include "maidsafe/common/containers/xor_trie.h"
+
+namespace po = boost::program_options;
+
+namespace {
+
+struct Options {
+  Options() : entry_count(10000000), query_count(100), k(16), seed(0) {}
+  uint32_t entry_count, query_count, k, seed;
+};
+
+struct Timing {
+  Timing() : calls(0), trie_seconds(0), flat_seconds(0) {}
+  uint64_t calls;
+  double trie_seconds, flat_seconds;
+};
+
+double SecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void CheckAgreement(bool agree, const std::string& operation) {
+  if (!agree) {
+    LOG(kError) << "XorTrie and flat " << operation << " disagree.";
+    BOOST_THROW_EXCEPTION(maidsafe::MakeError(maidsafe::CommonErrors::unknown));
+  }
+}
+
+std::vector<maidsafe::NodeId> GenerateIds(std::mt19937_64& generator, uint32_t count) {
+  std::vector<maidsafe::NodeId> ids;
+  ids.reserve(count);
+  std::string raw_id(maidsafe::NodeId::kSize, 0);
+  for (uint32_t i(0); i != count; ++i) {
+    for (size_t j(0); j < raw_id.size(); j += 8) {
+      uint64_t word(generator());
+      for (size_t k(0); k != 8; ++k, word >>= 8)
+        raw_id[j + k] = static_cast<char>(word & 0xff);
+    }
+    ids.emplace_back(raw_id);
+  }
+  return ids;
+}
+
+Timing TimeClosest(const Options& options, const maidsafe::XorTrie<uint32_t>& trie,
+                   const std::vector<maidsafe::NodeId>& ids,
+                   const std::vector<maidsafe::NodeId>& targets) {
+  Timing timing;
+  std::vector<std::vector<maidsafe::NodeId>> trie_results, flat_results;
+  auto start(std::chrono::steady_clock::now());
+  for (const auto& target : targets) {
+    std::vector<maidsafe::NodeId> closest;
+    for (const auto& entry : trie.Closest(target, options.k))
+      closest.push_back(entry->first);
+    trie_results.push_back(std::move(closest));
+  }
+  timing.trie_seconds = SecondsSince(start);
+  start = std::chrono::steady_clock::now();
+  for (const auto& target : targets)
+    flat_results.push_back(maidsafe::ClosestNodes(ids, target, options.k));
+  timing.flat_seconds = SecondsSince(start);
+  timing.calls = targets.size();
+  CheckAgreement(trie_results == flat_results, "k closest");
+  return timing;
+}
+
+// Uses a number of common leading bits for each target such that around a thousand entries match.
+Timing TimeCount(const maidsafe::XorTrie<uint32_t>& trie, const std::vector<maidsafe::NodeId>& ids,
+                 const std::vector<maidsafe::NodeId>& targets) {
+  int common_leading_bits(0);
+  while ((ids.size() >> (common_leading_bits + 1)) >= 1000)
+    ++common_leading_bits;
+  Timing timing;
+  uint64_t trie_total(0), flat_total(0);
+  auto start(std::chrono::steady_clock::now());
+  for (const auto& target : targets)
+    trie_total += trie.CountWithinCommonLeadingBits(target, common_leading_bits);
+  timing.trie_seconds = SecondsSince(start);
+  start = std::chrono::steady_clock::now();
+  for (const auto& target : targets) {
+    for (const auto& id : ids)
+      flat_total += id.CommonLeadingBits(target) >= common_leading_bits ? 1 : 0;
+  }
+  timing.flat_seconds = SecondsSince(start);
+  timing.calls = targets.size();
+  CheckAgreement(trie_total == flat_total, "count within common leading bits");
+  return timing;
+}
+
+void PrintJson(const std::string& operation, const Options& options, const Timing& timing) {
+  double calls(static_cast<double>(timing.calls));
+  std::cout << "{\"operation\":\"" << operation << "\",\"entries\":" << options.entry_count
+            << ",\"k\":" << options.k << ",\"calls\":" << timing.calls
+            << ",\"trie_ns_per_call\":" << timing.trie_seconds * 1e9 / calls;
+  if (timing.flat_seconds > 0) {
+    std::cout << ",\"flat_ns_per_call\":" << timing.flat_seconds * 1e9 / calls
+              << ",\"speedup\":"
+              << (timing.trie_seconds > 0 ? timing.flat_seconds / timing.trie_seconds : 0.0);
+  }
+  std::cout << "}" << std::endl;
+}
+
+}  // unnamed namespace
+
+int main(int argc, char* argv[]) {
+  maidsafe::log::Logging::Instance().Initialise(argc, argv);
+  Options options;
+  po::options_description description("XorTrie benchmark options");
+  description.add_options()("help,h", "Show help message.")(
+      "entries", po::value<uint32_t>(&options.entry_count)->default_value(options.entry_count),
+      "Number of entries.")(
+      "queries", po::value<uint32_t>(&options.query_count)->default_value(options.query_count),
+      "Number of random targets queried.")(
+      "k", po::value<uint32_t>(&options.k)->default_value(options.k),
+      "Number of closest entries per query.")(
+      "seed", po::value<uint32_t>(&options.seed)->default_value(options.seed),
+      "Seed for generating the IDs.");
+
+  try {
+    po::variables_map variables_map;
+    po::store(po::command_line_parser(argc, argv).options(description).allow_unregistered().run(),
+              variables_map);
+    po::notify(variables_map);
+    if (variables_map.count("help")) {
+      std::cout << description << '\n';
+      return 0;
+    }
+    if (options.entry_count == 0 || options.query_count == 0) {
+      LOG(kError) << "Need at least 1 entry and 1 query.";
+      BOOST_THROW_EXCEPTION(maidsafe::MakeError(maidsafe::CommonErrors::invalid_parameter));
+    }
+
+    std::mt19937_64 generator(options.seed);
+    auto ids(GenerateIds(generator, options.entry_count));
+    auto targets(GenerateIds(generator, options.query_count));
+
+    maidsafe::XorTrie<uint32_t> trie;
+    Timing add;
+    auto start(std::chrono::steady_clock::now());
+    for (uint32_t i(0); i != options.entry_count; ++i)
+      trie.Add(ids[i], i);
+    add.trie_seconds = SecondsSince(start);
+    add.calls = options.entry_count;
+    PrintJson("add", options, add);
+
+    PrintJson("closest", options, TimeClosest(options, trie, ids, targets));
+    PrintJson("count_within_common_leading_bits", options, TimeCount(trie, ids, targets));
+
+    Timing erase;
+    start = std::chrono::steady_clock::now();
+    for (const auto& id : ids)
+      trie.Delete(id);
+    erase.trie_seconds = SecondsSince(start);
+    erase.calls = options.entry_count;
+    CheckAgreement(trie.empty(), "delete");
+    PrintJson("delete", options, erase);
+  } catch (const std::exception& e) {
+    std::cerr << "Error: " << e.what() << '\n';
+    return 1;
+  }
+  return 0;
+}